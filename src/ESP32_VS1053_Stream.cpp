@@ -1,133 +1,329 @@
 #include "ESP32_VS1053_Stream.h"
 
-ESP32_VS1053_Stream::ESP32_VS1053_Stream() : _vs1053(nullptr), _http(nullptr), _vs1053Buffer{0}, _localbuffer{0}, _url{0},
-                                             _ringbuffer_handle(nullptr), _buffer_struct(nullptr), _buffer_storage(nullptr) {}
+ESP32_VS1053_Stream *ESP32_VS1053_Stream::_shared[VS1053_MAX_DECODERS] = {};
+size_t ESP32_VS1053_Stream::_sharedCount = 0;
+SemaphoreHandle_t ESP32_VS1053_Stream::_sharedMutex = nullptr;
+TaskHandle_t ESP32_VS1053_Stream::_sharedFeederTask = nullptr;
+volatile bool ESP32_VS1053_Stream::_sharedFeederRunning = false;
+std::atomic<size_t> ESP32_VS1053_Stream::_bufferBudget{0};
+std::atomic<size_t> ESP32_VS1053_Stream::_bufferAllocated{0};
+
+// high and low water marks are raised by one task and read by another
+template <typename T>
+static void _storeMax(std::atomic<T> &mark, const T value)
+{
+    T current = mark.load();
+    while (value > current && !mark.compare_exchange_weak(current, value))
+        ;
+}
+
+template <typename T>
+static void _storeMin(std::atomic<T> &mark, const T value)
+{
+    T current = mark.load();
+    while (value < current && !mark.compare_exchange_weak(current, value))
+        ;
+}
+
+ESP32_VS1053_Stream::ESP32_VS1053_Stream() : _vs1053(nullptr), _http(nullptr)
+{
+    _setUrl("");
+    resetStats();
+}
 
 ESP32_VS1053_Stream::~ESP32_VS1053_Stream()
 {
+    stopFeederTask();
+    stopBufferTask();
+    stopRecording();
     stopSong();
+    stopEventTask();
+    _deleteEventQueue();
+    clearQueue();
+    _dropIdleHttp();
+    clearStationCache();
+    _releaseWorkBuffer();
+    free(_finishedUrl);
+    free(_seekIndexUrl);
+    free(_seekIndexFailedUrl);
+    free(_lastUrlCopy);
+    free(_url);
     _deallocateRingbuffer();
     delete _vs1053;
+    if (_sourceMutex)
+        vSemaphoreDelete(_sourceMutex);
+    if (_decoderMutex)
+        vSemaphoreDelete(_decoderMutex);
 }
 
-void ESP32_VS1053_Stream::_allocateRingbuffer()
+bool ESP32_VS1053_Stream::_allocateRingbuffer(const size_t requested, const VS1053_BufferMemory memory)
 {
-    if (!psramFound() || !VS1053_PSRAM_BUFFER_ENABLED)
-        return;
+    if (_ringbuffer.allocated())
+    {
+        log_e("Ringbuffer already allocated");
+        return false;
+    }
 
-    if (_buffer_struct || _buffer_storage || _ringbuffer_handle)
+    if (!requested)
+        return true;
+
+    // instances share the budget first come first served
+    const size_t bytes = _bufferBudget ? min(requested, bufferBudgetLeft()) : requested;
+    if (!bytes)
     {
-        log_e("Ringbuffer pointers not NULL on allocate");
-        return;
+        log_e("Ringbuffer budget used up");
+        return false;
     }
 
-    _buffer_struct = (StaticRingbuffer_t *)heap_caps_malloc(sizeof(StaticRingbuffer_t), MALLOC_CAP_SPIRAM);
-    if (!_buffer_struct)
+    if (memory != VS1053_BufferMemory::INTERNAL_ONLY && psramFound())
     {
-        log_e("Could not allocate ringbuffer struct");
-        return;
+        if (_ringbuffer.allocate(bytes, MALLOC_CAP_SPIRAM))
+        {
+            log_d("Allocated %zu bytes ringbuffer in PSRAM", bytes);
+            _bufferAllocated += bytes;
+            return true;
+        }
+        log_w("Could not allocate %zu bytes ringbuffer in PSRAM", bytes);
     }
 
-    _buffer_storage = (uint8_t *)heap_caps_malloc(sizeof(uint8_t) * VS1053_PSRAM_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
-    if (!_buffer_storage)
+    if (memory == VS1053_BufferMemory::PSRAM_ONLY)
     {
         log_e("Could not allocate ringbuffer storage");
-        free(_buffer_struct);
-        _buffer_struct = nullptr;
-        return;
+        return false;
     }
 
-    _ringbuffer_handle = xRingbufferCreateStatic(VS1053_PSRAM_BUFFER_SIZE, RINGBUF_TYPE_BYTEBUF, _buffer_storage, _buffer_struct);
-    if (!_ringbuffer_handle)
-    {
-        log_e("Could not create ringbuffer handle");
-        free(_buffer_storage);
-        _buffer_storage = nullptr;
+    const size_t internalBytes = (memory == VS1053_BufferMemory::PREFER_PSRAM) ? min(bytes, (size_t)VS1053_INTERNAL_BUFFER_SIZE) : bytes;
+    if (!internalBytes)
+        return true;
 
-        free(_buffer_struct);
-        _buffer_struct = nullptr;
-        return;
+    if (!_ringbuffer.allocate(internalBytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT))
+    {
+        log_e("Could not allocate ringbuffer storage");
+        return false;
     }
-    else
-        log_d("Allocated %i bytes ringbuffer in PSRAM", VS1053_PSRAM_BUFFER_SIZE);
+    log_d("Allocated %zu bytes ringbuffer in internal RAM", internalBytes);
+    _bufferAllocated += internalBytes;
+    return true;
 }
 
 void ESP32_VS1053_Stream::_deallocateRingbuffer()
 {
-    if (_ringbuffer_handle)
-    {
-        vRingbufferDelete(_ringbuffer_handle);
-        _ringbuffer_handle = nullptr;
+    _bufferAllocated -= _ringbuffer.capacity();
+    _ringbuffer.release();
+}
 
-        free(_buffer_storage);
-        _buffer_storage = nullptr;
+void ESP32_VS1053_Stream::setBufferBudget(const size_t bytes)
+{
+    _bufferBudget = bytes;
+}
 
-        free(_buffer_struct);
-        _buffer_struct = nullptr;
-    }
+size_t ESP32_VS1053_Stream::bufferBudgetLeft()
+{
+    const size_t budget = _bufferBudget;
+    const size_t allocated = _bufferAllocated;
+    return budget > allocated ? budget - allocated : 0;
 }
 
-size_t ESP32_VS1053_Stream::_nextChunkSize(WiFiClient *stream)
+#if VS1053_CHUNKED_ENABLED
+size_t ESP32_VS1053_Stream::_dechunk(uint8_t *data, const size_t len)
 {
-    constexpr const auto size = 12;
-    char buffer[size];
-    int cnt = 0;
+    size_t in = 0;
+    size_t out = 0;
 
-    while (cnt < size - 1)
+    while (in < len && _chunkState != CHUNK_END && _chunkState != CHUNK_ERROR)
     {
-        int currentChar = stream->read();
-        if (currentChar == -1)
-            return 0; // Handle read error or end of stream
+        switch (_chunkState)
+        {
+        case CHUNK_SIZE:
+        {
+            const char c = data[in++];
+            if (isxdigit(c) && _bytesLeftInChunk <= (SIZE_MAX >> 4))
+                _bytesLeftInChunk = (_bytesLeftInChunk << 4) | (isdigit(c) ? c - '0' : (tolower(c) - 'a' + 10));
+            else if (c == ';')
+                _chunkState = CHUNK_EXTENSION;
+            else if (c == '\n')
+                _chunkState = _bytesLeftInChunk ? CHUNK_DATA : CHUNK_END;
+            else if (c != '\r' && c != ' ' && c != '\t')
+                _chunkState = CHUNK_ERROR;
+            break;
+        }
 
-        if (currentChar == '\r')
-            continue;
+        case CHUNK_EXTENSION:
+            if (data[in++] == '\n')
+                _chunkState = _bytesLeftInChunk ? CHUNK_DATA : CHUNK_END;
+            break;
+
+        case CHUNK_DATA:
+        {
+            const size_t size = min(len - in, _bytesLeftInChunk);
+            if (out != in)
+                memmove(data + out, data + in, size);
+            in += size;
+            out += size;
+            _bytesLeftInChunk -= size;
+            if (!_bytesLeftInChunk)
+                _chunkState = CHUNK_DATA_CR;
+            break;
+        }
 
-        if (currentChar == '\n')
+        case CHUNK_DATA_CR:
+            _chunkState = (data[in++] == '\r') ? CHUNK_DATA_LF : CHUNK_ERROR;
             break;
 
-        buffer[cnt++] = (char)currentChar;
+        case CHUNK_DATA_LF:
+            _chunkState = (data[in++] == '\n') ? CHUNK_SIZE : CHUNK_ERROR;
+            break;
+        }
     }
-    buffer[cnt] = '\0';
 
-    return strtol(buffer, nullptr, 16);
+    if (_chunkState == CHUNK_ERROR && _errorCallback)
+        _emitText(EVENT_ERROR, ERROR_STREAM_SYNC_LOST);
+
+    return out;
 }
+#endif
 
-bool ESP32_VS1053_Stream::_checkSync(WiFiClient *stream)
+size_t ESP32_VS1053_Stream::_stripMetadata(uint8_t *data, const size_t len)
 {
-    if ((char)stream->read() != '\r' || (char)stream->read() != '\n')
+#if VS1053_ICY_METADATA
+    if (!_metaDataStart)
+        return len;
+
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < len)
     {
-        if (_errorCallback)
-            _errorCallback(ERROR_STREAM_SYNC_LOST);
-        return false;
+        if (_metaRemaining)
+        {
+            const size_t size = min(len - in, _metaRemaining);
+            memcpy(_localbuffer + _metaFill, data + in, size);
+            in += size;
+            _metaFill += size;
+            _metaRemaining -= size;
+
+            if (!_metaRemaining)
+            {
+                // the audio of this read in front of the metadata is still to be recorded
+                if (_infoCallback || _metadataCallback || (_recording && _recordSplit))
+                    _handleMetadata(reinterpret_cast<char *>(_localbuffer), _metaFill, out);
+                _musicDataPosition = 0;
+            }
+            continue;
+        }
+
+        if (_musicDataPosition == _metaDataStart)
+        {
+            _metaRemaining = data[in++] * 16;
+            _metaFill = 0;
+            if (!_metaRemaining)
+                _musicDataPosition = 0;
+            continue;
+        }
+
+        const size_t size = min(len - in, size_t(_metaDataStart - _musicDataPosition));
+        if (out != in)
+            memmove(data + out, data + in, size);
+        in += size;
+        out += size;
+        _musicDataPosition += size;
     }
-    return true;
+    return out;
+#else
+    (void)data;
+    return len;
+#endif
+}
+
+void ESP32_VS1053_Stream::_resetFraming()
+{
+#if VS1053_CHUNKED_ENABLED
+    _bytesLeftInChunk = 0;
+    _chunkState = CHUNK_SIZE;
+#endif
+#if VS1053_ICY_METADATA
+    _metaRemaining = 0;
+#endif
 }
 
-void ESP32_VS1053_Stream::_handleMetadata(char *data, const size_t len)
+#if VS1053_ICY_METADATA
+void ESP32_VS1053_Stream::_handleMetadata(char *data, const size_t len, const size_t audioBefore)
 {
-    char *pch = strstr(data, "StreamTitle");
-    if (!pch)
+    // Key='value';Key='value'; padded with zeros, values are terminated in place
+    VS1053_MetadataField fields[VS1053_MAX_METADATA_FIELDS];
+    size_t count = 0;
+
+    char *pch = data;
+    char *const end = data + len;
+
+    while (pch < end && count < VS1053_MAX_METADATA_FIELDS)
+    {
+        while (pch < end && (*pch == '\0' || *pch == ';' || isspace(*pch)))
+            pch++;
+
+        char *separator = static_cast<char *>(memchr(pch, '=', end - pch));
+        if (!separator)
+            break;
+
+        char *value = separator + 1;
+        const bool quoted = value < end && *value == '\'';
+        if (quoted)
+            value++;
+
+        char *index = value;
+        if (quoted)
+            while (index < end && (index[0] != '\'' || (index + 1 < end && index[1] != ';' && index[1] != '\0')))
+                index++;
+        else
+            while (index < end && *index != ';' && *index != '\0')
+                index++;
+
+        fields[count++] = {pch, size_t(separator - pch), value, size_t(index - value)};
+        *separator = 0;
+        *index = 0; // the buffer has room for one byte past the metadata
+        pch = index + 1;
+    }
+
+    if (!count)
         return;
-    pch = strstr(pch, "'");
-    if (!pch)
+
+    if (_recording && _recordSplit)
+        for (size_t i = 0; i < count; i++)
+            if (!strcmp(fields[i].key, "StreamTitle"))
+                _recordTitle(fields[i].value, audioBefore);
+
+    if (_metadataCallback)
+        _emitMetadata(fields, count);
+
+    if (!_infoCallback)
         return;
-    char *index = ++pch;
-    while (index[0] != '\'' || index[1] != ';')
-        if (index++ == data + len)
-            return;
-    index[0] = 0;
-    _infoCallback(pch);
+
+    for (size_t i = 0; i < count; i++)
+        if (!strcmp(fields[i].key, "StreamTitle"))
+            _emitText(EVENT_INFO, fields[i].value);
 }
+#endif
 
 void ESP32_VS1053_Stream::_eofStream()
 {
-    if (_codec == CODEC_UNKNOWN && _errorCallback)
-        _errorCallback(ERROR_NO_DECODER_SYNC);
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    if (_handoverPending)
+    {
+        _handover();
+        return;
+    }
+
+    if (_codec == CODEC_UNKNOWN && !_sniffer.rejected() && _errorCallback)
+        _emitText(EVENT_ERROR, ERROR_NO_DECODER_SYNC);
 
     stopSong();
 
     if (_eofCallback)
-        _eofCallback(_url);
+        _emitText(EVENT_EOF, _url);
+
+    _startQueued();
 }
 
 bool ESP32_VS1053_Stream::_canRedirect()
@@ -143,6 +339,13 @@ bool ESP32_VS1053_Stream::_canRedirect()
 }
 
 bool ESP32_VS1053_Stream::startDecoder(const uint8_t CS, const uint8_t DCS, const uint8_t DREQ)
+{
+    return startDecoder(CS, DCS, DREQ, VS1053_PSRAM_BUFFER_ENABLED ? VS1053_PSRAM_BUFFER_SIZE : VS1053_INTERNAL_BUFFER_SIZE,
+                        VS1053_PSRAM_BUFFER_ENABLED ? VS1053_BufferMemory::PREFER_PSRAM : VS1053_BufferMemory::INTERNAL_ONLY);
+}
+
+bool ESP32_VS1053_Stream::startDecoder(const uint8_t CS, const uint8_t DCS, const uint8_t DREQ,
+                                       const size_t bufferSize, const VS1053_BufferMemory memory)
 {
     if (_vs1053)
         return false;
@@ -156,7 +359,11 @@ bool ESP32_VS1053_Stream::startDecoder(const uint8_t CS, const uint8_t DCS, cons
         log_d("Patching vs1053 firmware");
         _vs1053->loadUserCode(PATCHES_FLAC, PATCHES_FLAC_SIZE);
     }
-    _allocateRingbuffer();
+    _dreqPin = DREQ;
+    _dcsPin = DCS;
+    _sourceMutex = xSemaphoreCreateRecursiveMutex();
+    _decoderMutex = xSemaphoreCreateRecursiveMutex();
+    _allocateRingbuffer(bufferSize, memory);
     return true;
 }
 
@@ -168,7 +375,7 @@ bool ESP32_VS1053_Stream::_escapeUrl(const char *url, const size_t len)
     {
         if (url[in] == ' ')
         {
-            if (out + 3 >= sizeof(_localbuffer) - 1)
+            if (out + 3 >= VS1053_LOCALBUFFER_SIZE - 1)
                 return false;
 
             _localbuffer[out++] = '%';
@@ -177,7 +384,7 @@ bool ESP32_VS1053_Stream::_escapeUrl(const char *url, const size_t len)
         }
         else
         {
-            if (out + 1 >= sizeof(_localbuffer) - 1)
+            if (out + 1 >= VS1053_LOCALBUFFER_SIZE - 1)
                 return false;
 
             _localbuffer[out++] = url[in];
@@ -201,8 +408,42 @@ bool ESP32_VS1053_Stream::_isPlaylistContentType()
            strcasestr(ct, "audio/mpegurl");
 }
 
-const char *ESP32_VS1053_Stream::_parsePlaylist()
+bool ESP32_VS1053_Stream::_isRejectedContentType()
+{
+    // error and login pages, a missing content type is left to the sniffer
+    const String contentType = _http->header(CONTENT_TYPE);
+    const char *ct = contentType.c_str();
+
+    return strcasestr(ct, "text/html") ||
+           strcasestr(ct, "application/json") ||
+           strcasestr(ct, "application/xml") ||
+           strcasestr(ct, "text/xml") ||
+           strcasestr(ct, "image/");
+}
+
+const char *ESP32_VS1053_Stream::_playlistEntry(char *line)
+{
+    if (strncmp(line, "#EXT-X-", 7) == 0)
+    {
+        _isHLS = true;
+        return nullptr;
+    }
+
+    // Skip comments (M3U, EXTINF, etc.)
+    if (line[0] == '#' || line[0] == '\0')
+        return nullptr;
+
+    // Find URL
+    char *newUrl = strstr(line, "http");
+    if (newUrl)
+        strtok(newUrl, "\r\n;");
+    return newUrl;
+}
+
+const char *ESP32_VS1053_Stream::_parsePlaylist(bool &complete)
 {
+    complete = false;
+
     WiFiClient *stream = _http->getStreamPtr();
     if (!stream)
     {
@@ -212,6 +453,29 @@ const char *ESP32_VS1053_Stream::_parsePlaylist()
 
     char *line = reinterpret_cast<char *>(_localbuffer);
 
+    // a small playlist is read completely so the connection can be reused
+    const int32_t bodySize = _http->getSize();
+    if (bodySize >= 0 && bodySize < (int32_t)VS1053_LOCALBUFFER_SIZE)
+    {
+        const size_t received = stream->readBytes(line, bodySize);
+        line[received] = '\0';
+        complete = (received == (size_t)bodySize);
+
+        while (line)
+        {
+            char *next = strchr(line, '\n');
+            if (next)
+                *next++ = '\0';
+
+            const char *newUrl = _playlistEntry(line);
+            if (newUrl || _isHLS)
+                return newUrl;
+
+            line = next;
+        }
+        return nullptr;
+    }
+
     while (stream->connected() && stream->available())
     {
         size_t len = stream->readBytesUntil('\n', line, VS1053_MAX_URL_LENGTH - 1);
@@ -229,23 +493,9 @@ const char *ESP32_VS1053_Stream::_parsePlaylist()
                 ;
         }
 
-        if (strncmp(line, "#EXT-X-", 7) == 0)
-        {
-            _isHLS = true;
-            return nullptr;
-        }
-
-        // Skip comments (M3U, EXTINF, etc.)
-        if (line[0] == '#' || line[0] == '\0')
-            continue;
-
-        // Find URL
-        char *newUrl = strstr(line, "http");
-        if (newUrl)
-        {
-            strtok(newUrl, "\r\n;");
+        const char *newUrl = _playlistEntry(line);
+        if (newUrl || _isHLS)
             return newUrl;
-        }
     }
 
     return nullptr;
@@ -262,7 +512,7 @@ void ESP32_VS1053_Stream::_resolveRedirect(const char *location, const char *bas
     if (!strncasecmp(location, "http://", 7) ||
         !strncasecmp(location, "https://", 8))
     {
-        snprintf(result, sizeof(_url), "%s", location);
+        snprintf(result, VS1053_MAX_URL_LENGTH, "%s", location);
         return;
     }
 
@@ -271,7 +521,7 @@ void ESP32_VS1053_Stream::_resolveRedirect(const char *location, const char *bas
     {
         const char *scheme = !strncasecmp(base, "https://", 8) ? "https:" : "http:";
 
-        snprintf(result, sizeof(_url), "%s%s", scheme, location);
+        snprintf(result, VS1053_MAX_URL_LENGTH, "%s%s", scheme, location);
         return;
     }
 
@@ -279,7 +529,7 @@ void ESP32_VS1053_Stream::_resolveRedirect(const char *location, const char *bas
     const char *p = strstr(base, "://");
     if (!p)
     {
-        snprintf(result, sizeof(_url), "%s", location);
+        snprintf(result, VS1053_MAX_URL_LENGTH, "%s", location);
         return;
     }
 
@@ -290,9 +540,9 @@ void ESP32_VS1053_Stream::_resolveRedirect(const char *location, const char *bas
     if (!hostEnd)
     {
         if (location[0] == '/')
-            snprintf(result, sizeof(_url), "%s%s", base, location);
+            snprintf(result, VS1053_MAX_URL_LENGTH, "%s%s", base, location);
         else
-            snprintf(result, sizeof(_url), "%s/%s", base, location);
+            snprintf(result, VS1053_MAX_URL_LENGTH, "%s/%s", base, location);
 
         return;
     }
@@ -300,7 +550,7 @@ void ESP32_VS1053_Stream::_resolveRedirect(const char *location, const char *bas
     if (location[0] == '/')
     {
         // Root-relative
-        snprintf(result, sizeof(_url), "%.*s%s", int(hostEnd - base), base, location);
+        snprintf(result, VS1053_MAX_URL_LENGTH, "%.*s%s", int(hostEnd - base), base, location);
         return;
     }
 
@@ -309,7 +559,7 @@ void ESP32_VS1053_Stream::_resolveRedirect(const char *location, const char *bas
     if (!lastSlash)
         lastSlash = hostEnd;
 
-    snprintf(result, sizeof(_url), "%.*s/%s", int(lastSlash - base), base, location);
+    snprintf(result, VS1053_MAX_URL_LENGTH, "%.*s/%s", int(lastSlash - base), base, location);
 }
 
 bool ESP32_VS1053_Stream::connectToHost(const char *url)
@@ -331,160 +581,590 @@ bool ESP32_VS1053_Stream::connectToHost(const char *url, const char *username,
 bool ESP32_VS1053_Stream::connectToHost(const char *url, const char *username,
                                         const char *pwd, size_t offset)
 {
-    if (!_vs1053 || _http || _playingFile || !WiFi.isConnected())
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    if (!_vs1053 || _http || _hls || _playingFile || _reconnecting || !WiFi.isConnected())
     {
         log_e("system error");
         if (_errorCallback)
-            _errorCallback(ERROR_SYSTEM_ERROR);
+            _emitText(EVENT_ERROR, ERROR_SYSTEM_ERROR);
         return false;
     }
 
-    const size_t length = strlen(url);
-    if (strncasecmp(url, "http", 4) != 0 || length >= (sizeof(_url) - 1) || length < 8) // "http://"
+    if (!_openStation(url, username, pwd, offset))
     {
-        log_v("Invalid URL");
-        if (_errorCallback)
-            _errorCallback(ERROR_INVALID_URL);
-        _redirectCount = 0;
+        _releaseWorkBuffer();
         return false;
     }
 
-    _http = new HTTPClient;
-    if (!_http)
+    _setCredentials(username, pwd);
+    return true;
+}
+
+void ESP32_VS1053_Stream::_setCredentials(const char *username, const char *pwd)
+{
+    free(_username);
+    free(_pwd);
+    _username = (username && strlen(username)) ? strdup(username) : nullptr;
+    _pwd = (pwd && strlen(pwd)) ? strdup(pwd) : nullptr;
+}
+
+bool ESP32_VS1053_Stream::_openStation(const char *url, const char *username, const char *pwd, const size_t offset)
+{
+    bool opened = false;
+
+    const int8_t cached = _findStation(url);
+    if (cached != -1 && strcmp(_stations[cached].resolved, url))
     {
-        log_v("Could not create http client");
-        if (_errorCallback)
-            _errorCallback(ERROR_HTTP_ERROR);
-        _redirectCount = 0;
-        return false;
+        log_d("trying cached endpoint %s", _stations[cached].resolved);
+
+        // a stale endpoint is not an error, it falls back to a full resolution
+        _muteErrors = true;
+        opened = _openHost(_stations[cached].resolved, username, pwd, offset);
+        _muteErrors = false;
+
+        if (!opened)
+        {
+            log_w("cached endpoint failed, resolving %s", url);
+            _forgetStation(cached);
+        }
     }
 
-    const bool needsEscape = (strchr(url, ' ') != nullptr);
+    if (!opened && !_openHost(url, username, pwd, offset))
+        return false;
 
-    if (needsEscape && !_escapeUrl(url, length))
+    const int8_t index = _rememberStation(url);
+    if (index == -1)
+        return true;
+
+    StationCacheEntry &entry = _stations[index];
+    entry.lastUsed = ++_stationClock;
+
+    if (_preloading)
     {
-        log_v("Escaped URL exceeds buffer");
-        if (_errorCallback)
-            _errorCallback(ERROR_INVALID_URL);
-        stopSong();
-        return false;
+        _next.station = index;
+        _next.stationBitrate = entry.bitrate;
+        if (_next.codec == CODEC_UNKNOWN)
+            _next.codec = entry.codec;
+        return true;
     }
 
-    const bool isHttps = (length > 4 && tolower(url[4]) == 's');
+    _station = index;
+    _stationBitrate = entry.bitrate;
+    _jitterMs = entry.jitterMs;
+    return true;
+}
 
-    _http->setConnectTimeout(isHttps ? VS1053_CONNECT_TIMEOUT_MS_SSL
-                                     : VS1053_CONNECT_TIMEOUT_MS);
+int8_t ESP32_VS1053_Stream::_findStation(const char *url)
+{
+    for (int8_t i = 0; i < VS1053_STATION_CACHE_SIZE; i++)
+        if (_stations[i].url && !strcmp(_stations[i].url, url))
+            return i;
+    return -1;
+}
 
-    const char *finalUrl = needsEscape ? reinterpret_cast<const char *>(_localbuffer) : url;
-    if (!_http->begin(finalUrl))
+int8_t ESP32_VS1053_Stream::_rememberStation(const char *url)
+{
+    const char *resolved = _preloading ? _next.url : _url;
+    if (!resolved)
+        return -1;
+
+    int8_t index = _findStation(url);
+    if (index == -1)
     {
-        log_v("Could not connect to %s", url);
-        if (_errorCallback)
-            _errorCallback(ERROR_NO_CONNECTION);
-        stopSong();
-        return false;
+        // reuse an empty or the least recently used entry
+        index = 0;
+        for (int8_t i = 0; i < VS1053_STATION_CACHE_SIZE; i++)
+        {
+            if (!_stations[i].url)
+            {
+                index = i;
+                break;
+            }
+            if (_stations[i].lastUsed < _stations[index].lastUsed)
+                index = i;
+        }
+        _forgetStation(index);
     }
 
-    if (offset)
+    StationCacheEntry &entry = _stations[index];
+    char *copy = strdup(resolved);
+    if (!entry.url)
+        entry.url = strdup(url);
+
+    if (!entry.url || !copy)
     {
-        char *buffer = reinterpret_cast<char *>(_localbuffer);
-        snprintf(buffer, sizeof(_localbuffer), "bytes=%zu-", offset);
-        _http->addHeader("Range", buffer);
+        free(copy);
+        _forgetStation(index);
+        return -1;
     }
 
-    if (strlen(username) || strlen(pwd))
-        _http->setAuthorization(username, pwd);
+    free(entry.resolved);
+    entry.resolved = copy;
+    return index;
+}
 
-    _http->addHeader("Icy-MetaData", VS1053_ICY_METADATA ? "1" : "0");
-    _http->collectHeaders(_header, sizeof(_header) / sizeof(_header[0]));
-    _http->setFollowRedirects(HTTPC_DISABLE_FOLLOW_REDIRECTS);
+void ESP32_VS1053_Stream::_learnStation()
+{
+    if (_station == -1 || _codec == CODEC_UNKNOWN)
+        return;
 
-    const int HTTPresult = _http->GET();
+    StationCacheEntry &entry = _stations[_station];
+    entry.codec = _codec;
 
-    switch (HTTPresult)
-    {
-    case 206:
-        log_d("server can resume");
-        [[fallthrough]];
-    case 200:
+    const uint32_t kbps = _measuredBitrate ? _measuredBitrate : _bitrate ? _bitrate
+                                                                         : _icyBitrate;
+    if (kbps)
+        entry.bitrate = min(kbps, (uint32_t)UINT16_MAX);
+    entry.jitterMs = min((uint32_t)_jitterMs, (uint32_t)VS1053_STREAM_TIMEOUT_MS);
+}
+
+void ESP32_VS1053_Stream::_forgetStation(const int8_t index)
+{
+    if (index == _station)
+        _station = -1;
+
+    StationCacheEntry &entry = _stations[index];
+    free(entry.url);
+    free(entry.resolved);
+    entry = {};
+}
+
+void ESP32_VS1053_Stream::clearStationCache()
+{
+    Lock lock(_sourceMutex);
+
+    for (int8_t i = 0; i < VS1053_STATION_CACHE_SIZE; i++)
+        _forgetStation(i);
+    _stationClock = 0;
+}
+
+bool ESP32_VS1053_Stream::saveStationCache()
+{
+    Lock lock(_sourceMutex);
+
+    Preferences prefs;
+    if (!prefs.begin(VS1053_STATION_CACHE_NAMESPACE, false))
     {
-        if (_isPlaylistContentType())
-        {
-            snprintf(_url, sizeof(_url), "%s", url);
+        log_e("Could not open nvs namespace");
+        return false;
+    }
+    prefs.clear();
 
-            if (!_canRedirect())
-            {
-                if (_errorCallback)
-                    _errorCallback(ERROR_MAX_REDIRECT);
+    bool success = true;
+    char key[8];
+    for (int8_t i = 0; i < VS1053_STATION_CACHE_SIZE; i++)
+    {
+        const StationCacheEntry &entry = _stations[i];
+        if (!entry.url)
+            continue;
 
-                stopSong();
-                _redirectCount = 0;
-                return false;
-            }
+        const uint8_t meta[9] = {entry.codec,
+                                 uint8_t(entry.bitrate), uint8_t(entry.bitrate >> 8),
+                                 uint8_t(entry.jitterMs), uint8_t(entry.jitterMs >> 8),
+                                 uint8_t(entry.lastUsed), uint8_t(entry.lastUsed >> 8),
+                                 uint8_t(entry.lastUsed >> 16), uint8_t(entry.lastUsed >> 24)};
+
+        snprintf(key, sizeof(key), "m%i", i);
+        success &= prefs.putBytes(key, meta, sizeof(meta)) == sizeof(meta);
+        snprintf(key, sizeof(key), "u%i", i);
+        success &= prefs.putString(key, entry.url) == strlen(entry.url);
+        snprintf(key, sizeof(key), "r%i", i);
+        success &= prefs.putString(key, entry.resolved) == strlen(entry.resolved);
+    }
+    prefs.end();
 
-            const char *newUrl = _parsePlaylist();
-            if (_isHLS)
-            {
-                if (_errorCallback)
-                    _errorCallback(ERROR_HLS_UNSUPPORTED);
+    if (!success)
+        log_e("Could not save the station cache");
+    return success;
+}
 
-                _isHLS = false;
-                stopSong();
-                _redirectCount = 0;
-                return false;
-            }
+bool ESP32_VS1053_Stream::loadStationCache()
+{
+    Lock lock(_sourceMutex);
 
-            if (newUrl)
-            {
-                log_d("playlist redirection to: %s", newUrl);
-                stopSong();
-                return connectToHost(newUrl, username, pwd, offset);
-            }
+    Preferences prefs;
+    if (!prefs.begin(VS1053_STATION_CACHE_NAMESPACE, true))
+        return false;
 
-            // no url found
-            if (_errorCallback)
-                _errorCallback(ERROR_PLAYLIST_EMPTY);
+    clearStationCache();
 
-            stopSong();
-            _redirectCount = 0;
-            return false;
-        }
+    // the work buffer is only there while playing
+    char *buffer = static_cast<char *>(malloc(VS1053_MAX_URL_LENGTH));
+    if (!buffer)
+    {
+        prefs.end();
+        return false;
+    }
 
-        if (_stationCallback && !_http->header(ICY_NAME).equals(""))
-            _stationCallback(_http->header(ICY_NAME).c_str());
+    char key[8];
+    for (int8_t i = 0; i < VS1053_STATION_CACHE_SIZE; i++)
+    {
+        uint8_t meta[9];
+        snprintf(key, sizeof(key), "m%i", i);
+        if (!prefs.isKey(key) || prefs.getBytes(key, meta, sizeof(meta)) != sizeof(meta))
+            continue;
 
-        _remainingBytes = _http->getSize(); // -1 when Server sends no Content-Length header (chunked streams)
+        StationCacheEntry &entry = _stations[i];
+        snprintf(key, sizeof(key), "u%i", i);
+        if (prefs.getString(key, buffer, VS1053_MAX_URL_LENGTH))
+            entry.url = strdup(buffer);
+        snprintf(key, sizeof(key), "r%i", i);
+        if (prefs.getString(key, buffer, VS1053_MAX_URL_LENGTH))
+            entry.resolved = strdup(buffer);
 
-        const bool suspiciousLength = _remainingBytes >= 0x7FFFFFF0;
-        if (suspiciousLength)
+        if (!entry.url || !entry.resolved)
         {
-            log_w("suspicious content-length %ld", _remainingBytes);
-            _remainingBytes = -1;
+            _forgetStation(i);
+            continue;
         }
 
-        _chunkedResponse = _http->header(ENCODING).equalsIgnoreCase("chunked") ? true : false;
-        log_d("%s stream", _chunkedResponse ? "chunked" : "http");
-        _offset = (_remainingBytes == -1) ? 0 : offset;
-        _metaDataStart = _http->header(ICY_METAINT).toInt();
-        _musicDataPosition = _metaDataStart ? 0 : -1;
-        if (strcmp(_url, url))
-            snprintf(_url, sizeof(_url), "%s", url);
-        _streamStallStartMS = 0;
-        log_i("redirected %i times to %s", _redirectCount, url);
-        _redirectCount = 0;
-        return true;
+        entry.codec = meta[0];
+        entry.bitrate = meta[1] | meta[2] << 8;
+        entry.jitterMs = meta[3] | meta[4] << 8;
+        entry.lastUsed = meta[5] | meta[6] << 8 | meta[7] << 16 | (uint32_t)meta[8] << 24;
+        _stationClock = max(_stationClock, entry.lastUsed);
+    }
+    free(buffer);
+    prefs.end();
+    return true;
+}
+
+void ESP32_VS1053_Stream::_closeHttp(const char *reuseUrl)
+{
+    _releaseHttp(_http, reuseUrl);
+}
+
+void ESP32_VS1053_Stream::_releaseHttp(HTTPClient *&http, const char *reuseUrl)
+{
+    if (!http)
+        return;
+
+    http->end(); // leaves the socket open when the server agreed to keep-alive
+
+    char key[VS1053_HOST_KEY_LENGTH];
+    if (reuseUrl && http->connected() && _hostKey(reuseUrl, key, sizeof(key)))
+    {
+        _dropIdleHttp();
+        _idleHttp = http;
+        snprintf(_idleKey, sizeof(_idleKey), "%s", key);
+        _idleSinceMS = millis();
+        log_d("keeping connection to %s", key);
+    }
+    else
+        delete http;
+
+    http = nullptr;
+}
+
+void ESP32_VS1053_Stream::_closeSource()
+{
+    if (_playingFile)
+    {
+        _file.close();
+        _playingFile = false;
+        return;
+    }
+
+#if VS1053_HLS_ENABLED
+    if (_hls)
+    {
+        _hlsStop();
+        return;
+    }
+#endif
+
+    // only a completely received body leaves the connection ready for a next request
+    const bool complete = _http && !_chunkedResponse && !_sourceRemaining;
+    _closeHttp(complete ? _url : nullptr);
+    _reconnecting = false;
+    free(_sourceTag);
+    _sourceTag = nullptr;
+}
+
+void ESP32_VS1053_Stream::_dropIdleHttp()
+{
+    if (!_idleHttp)
+        return;
+
+    log_d("closing idle connection to %s", _idleKey);
+    delete _idleHttp;
+    _idleHttp = nullptr;
+    _idleKey[0] = 0;
+}
+
+HTTPClient *ESP32_VS1053_Stream::_takeHttp(const char *url, bool &reused)
+{
+    char key[VS1053_HOST_KEY_LENGTH];
+    reused = _idleHttp && millis() - _idleSinceMS < VS1053_KEEPALIVE_TIMEOUT_MS &&
+             _hostKey(url, key, sizeof(key)) && !strcmp(key, _idleKey) && _idleHttp->connected();
+
+    if (reused)
+    {
+        log_d("reusing connection to %s", key);
+        HTTPClient *http = _idleHttp;
+        _idleHttp = nullptr;
+        _idleKey[0] = 0;
+        return http;
+    }
+
+    // HTTPClient reuses an open socket whatever the host, so never hand out one for another host
+    _dropIdleHttp();
+
+    HTTPClient *http = new HTTPClient;
+    if (http)
+        http->setReuse(true);
+    return http;
+}
+
+bool ESP32_VS1053_Stream::_hostKey(const char *url, char *key, const size_t len)
+{
+    const char *host = strstr(url, "://");
+    if (!host)
+        return false;
+
+    const bool isHttps = !strncasecmp(url, "https://", 8);
+    host += 3;
+
+    size_t hostLen = strcspn(host, "/?#");
+    const char *at = static_cast<const char *>(memchr(host, '@', hostLen));
+    if (at)
+    {
+        hostLen -= at + 1 - host;
+        host = at + 1;
+    }
+
+    if (!hostLen)
+        return false;
+
+    const bool hasPort = memchr(host, ':', hostLen) != nullptr;
+    const int written = snprintf(key, len, "%s://%.*s%s", isHttps ? "https" : "http", int(hostLen), host,
+                                 hasPort ? "" : isHttps ? ":443" : ":80");
+    if (written < 0 || (size_t)written >= len)
+        return false;
+
+    for (char *p = key; *p; p++)
+        *p = tolower(*p);
+    return true;
+}
+
+bool ESP32_VS1053_Stream::_openHost(const char *url, const char *username,
+                                    const char *pwd, const size_t offset)
+{
+    if (!_acquireWorkBuffer())
+        return false;
+
+    const size_t length = strlen(url);
+    if (strncasecmp(url, "http", 4) != 0 || length >= (VS1053_MAX_URL_LENGTH - 1) || length < 8) // "http://"
+    {
+        log_v("Invalid URL");
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_INVALID_URL);
+        _redirectCount = 0;
+        return false;
+    }
+
+    bool reused = false;
+    _http = _takeHttp(url, reused);
+    if (!_http)
+    {
+        log_v("Could not create http client");
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_HTTP_ERROR);
+        _redirectCount = 0;
+        return false;
+    }
+
+    const bool needsEscape = (strchr(url, ' ') != nullptr);
+
+    if (needsEscape && !_escapeUrl(url, length))
+    {
+        log_v("Escaped URL exceeds buffer");
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_INVALID_URL);
+        _closeHttp();
+        return false;
+    }
+
+    const bool isHttps = (length > 4 && tolower(url[4]) == 's');
+
+    _http->setConnectTimeout(isHttps ? VS1053_CONNECT_TIMEOUT_MS_SSL
+                                     : VS1053_CONNECT_TIMEOUT_MS);
+    _http->useHTTP10(!VS1053_CHUNKED_ENABLED); // http/1.0 responses are never chunked
+
+    const char *finalUrl = needsEscape ? reinterpret_cast<const char *>(_localbuffer) : url;
+    if (!_http->begin(finalUrl))
+    {
+        log_v("Could not connect to %s", url);
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_NO_CONNECTION);
+        _closeHttp();
+        return false;
+    }
+
+    if (offset)
+    {
+        char *buffer = reinterpret_cast<char *>(_localbuffer);
+        snprintf(buffer, VS1053_LOCALBUFFER_SIZE, "bytes=%zu-", offset);
+        _http->addHeader("Range", buffer);
+
+        // the server sends the whole file instead of the rest when it changed since the drop
+        if (_reconnecting && _sourceTag)
+            _http->addHeader("If-Range", _sourceTag);
+    }
+
+    if (strlen(username) || strlen(pwd))
+        _http->setAuthorization(username, pwd);
+
+    _http->addHeader("Icy-MetaData", VS1053_ICY_METADATA ? "1" : "0");
+    _http->collectHeaders(_header, sizeof(_header) / sizeof(_header[0]));
+    _http->setFollowRedirects(HTTPC_DISABLE_FOLLOW_REDIRECTS);
+
+    int HTTPresult = _http->GET();
+    if (HTTPresult < 0 && reused)
+    {
+        log_d("kept connection was closed by the server, reconnecting");
+        HTTPresult = _http->GET();
+    }
+
+    switch (HTTPresult)
+    {
+    case 206:
+        log_d("server can resume");
+        [[fallthrough]];
+    case 200:
+    {
+        if (_isPlaylistContentType())
+        {
+            if (!_preloading && !_reconnecting)
+                _setUrl(url);
+
+            if (!_canRedirect())
+            {
+                if (_errorCallback)
+                    _emitText(EVENT_ERROR, ERROR_MAX_REDIRECT);
+
+                _closeHttp();
+                _redirectCount = 0;
+                return false;
+            }
+
+            // the url can point into _localbuffer which is overwritten by the playlist parser
+            char *playlistUrl = strdup(url);
+            if (!playlistUrl)
+            {
+                if (_errorCallback)
+                    _emitText(EVENT_ERROR, ERROR_SYSTEM_ERROR);
+                _closeHttp();
+                _redirectCount = 0;
+                return false;
+            }
+
+            bool complete = false;
+            const char *newUrl = _parsePlaylist(complete);
+            if (_isHLS)
+            {
+                _isHLS = false;
+#if VS1053_HLS_ENABLED
+                return _hlsStart(playlistUrl, complete);
+#else
+                log_w("hls support is compiled out");
+                if (_errorCallback)
+                    _emitText(EVENT_ERROR, ERROR_HLS_UNSUPPORTED);
+                _closeHttp();
+                free(playlistUrl);
+                _redirectCount = 0;
+                return false;
+#endif
+            }
+
+            _closeHttp(newUrl && complete ? playlistUrl : nullptr);
+            free(playlistUrl);
+
+            if (newUrl)
+            {
+                // newUrl is in _localbuffer, which the next request uses again
+                log_d("playlist redirection to: %s", newUrl);
+                char *entry = strdup(newUrl);
+                const bool opened = entry && _openHost(entry, username, pwd, offset);
+                free(entry);
+                return opened;
+            }
+
+            // no url found
+            if (_errorCallback)
+                _emitText(EVENT_ERROR, ERROR_PLAYLIST_EMPTY);
+
+            _redirectCount = 0;
+            return false;
+        }
+
+        if (!_reconnecting && _isRejectedContentType())
+        {
+            log_w("not an audio response: %s", _http->header(CONTENT_TYPE).c_str());
+            if (_errorCallback)
+                _emitText(EVENT_ERROR, ERROR_NOT_PLAYABLE);
+            _closeHttp();
+            _redirectCount = 0;
+            return false;
+        }
+
+        if (_stationCallback && !_preloading && !_reconnecting && !_http->header(ICY_NAME).equals(""))
+            _emitText(EVENT_STATION, _http->header(ICY_NAME).c_str());
+
+        int32_t contentLength = _http->getSize(); // -1 when Server sends no Content-Length header (chunked streams)
+
+        const bool suspiciousLength = contentLength >= 0x7FFFFFF0;
+        if (suspiciousLength)
+        {
+            log_w("suspicious content-length %ld", (long)contentLength);
+            contentLength = -1;
+        }
+
+#if VS1053_CHUNKED_ENABLED
+        _chunkedResponse = _http->header(ENCODING).equalsIgnoreCase("chunked");
+#endif
+        log_d("%s stream", _chunkedResponse ? "chunked" : "http");
+#if VS1053_ICY_METADATA
+        _metaDataStart = _http->header(ICY_METAINT).toInt();
+        _musicDataPosition = _metaDataStart ? 0 : -1;
+#endif
+        _icyBitrate = _http->header(ICY_BR).toInt();
+        _resetFraming();
+        _sourceRemaining = contentLength;
+
+        if (!_reconnecting)
+        {
+            // weak tags are not allowed in If-Range
+            const String etag = _http->header(ETAG);
+            const String modified = _http->header(LAST_MODIFIED);
+            free(_sourceTag);
+            _sourceTag = (etag.length() && !etag.startsWith("W/")) ? strdup(etag.c_str())
+                         : modified.length()                      ? strdup(modified.c_str())
+                                                                  : nullptr;
+        }
+
+        const size_t trackOffset = (contentLength == -1) ? 0 : offset;
+        const size_t trackSize = (contentLength == -1) ? 0 : trackOffset + contentLength;
+        _setTrack(url, contentLength, trackOffset, trackSize, trackSize, _codecFromContentType());
+        _streamStallStartMS = 0;
+        log_i("redirected %i times to %s", _redirectCount, url);
+        _redirectCount = 0;
+        return true;
     }
 
     case 301:
         [[fallthrough]];
     case 302:
     {
-        snprintf(_url, sizeof(_url), "%s", url);
+        if (!_preloading && !_reconnecting)
+            _setUrl(url);
         if (!_canRedirect())
         {
             if (_errorCallback)
-                _errorCallback(ERROR_MAX_REDIRECT);
-            stopSong();
+                _emitText(EVENT_ERROR, ERROR_MAX_REDIRECT);
+            _closeHttp();
             _redirectCount = 0;
             return false;
         }
@@ -493,540 +1173,2751 @@ bool ESP32_VS1053_Stream::connectToHost(const char *url, const char *username,
         {
             log_v("Error redirecting from %s", url);
             if (_errorCallback)
-                _errorCallback(ERROR_REDIRECTING);
-            stopSong();
+                _emitText(EVENT_ERROR, ERROR_REDIRECTING);
+            _closeHttp();
+            _redirectCount = 0;
+            return false;
+        }
+
+        // url can point into _localbuffer, which the body and the new location overwrite
+        char *base = strdup(url);
+        if (!base)
+        {
+            if (_errorCallback)
+                _emitText(EVENT_ERROR, ERROR_SYSTEM_ERROR);
+            _closeHttp();
+            _redirectCount = 0;
+            return false;
+        }
+
+        // drain the (short) body so the connection can be reused
+        const int32_t bodySize = _http->getSize();
+        WiFiClient *stream = _http->getStreamPtr();
+        const bool complete = stream && bodySize >= 0 && bodySize <= (int32_t)VS1053_LOCALBUFFER_SIZE &&
+                              stream->readBytes(_localbuffer, bodySize) == (size_t)bodySize;
+
+        char *location = reinterpret_cast<char *>(_localbuffer);
+        _resolveRedirect(_http->header(LOCATION).c_str(), base, location);
+        char *target = strdup(location);
+
+        // kept under the host that answered, not the one it redirects to
+        _closeHttp(complete ? base : nullptr);
+        free(base);
+
+        if (!target)
+        {
+            if (_errorCallback)
+                _emitText(EVENT_ERROR, ERROR_SYSTEM_ERROR);
             _redirectCount = 0;
             return false;
         }
 
+        log_i("%i redirection to: %s", HTTPresult, target);
+        const bool opened = _openHost(target, username, pwd, 0);
+        free(target);
+        return opened;
+    }
+
+    default:
+        _reportHttpError(HTTPresult);
+        _closeHttp();
+        _redirectCount = 0;
+        return false;
+    }
+}
+
+#if VS1053_HLS_ENABLED
+bool ESP32_VS1053_Stream::_hlsStart(char *playlistUrl, const bool complete)
+{
+    _closeHttp(complete ? playlistUrl : nullptr);
+
+    // segments are fetched while the previous one plays, which needs a ringbuffer
+    if (!_ringbuffer.allocated())
+    {
+        log_e("hls needs a ringbuffer");
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_HLS_UNSUPPORTED);
+        free(playlistUrl);
+        _redirectCount = 0;
+        return false;
+    }
+
+    _setTrack(playlistUrl, -1, 0, 0, 0, CODEC_UNKNOWN);
+    _hlsStop();
+    _hlsPlaylistUrl = playlistUrl;
+    _hls = true;
+
+    const bool draining = _draining;
+    const uint8_t sourceState = _sourceState;
+
+    bool started = _hlsLoadPlaylist();
+    if (started && !_hlsAdvance())
+    {
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_PLAYLIST_EMPTY);
+        started = false;
+    }
+
+    if (!started)
+    {
+        _hlsStop();
+        _draining = draining;
+        _sourceState = sourceState;
+        _redirectCount = 0;
+        return false;
+    }
+
+    log_i("hls stream %s", _hlsPlaylistUrl);
+    _redirectCount = 0;
+    return true;
+}
+
+void ESP32_VS1053_Stream::_hlsStop()
+{
+    _hlsCloseSegment();
+
+    while (_hlsSegmentCount)
+    {
+        free(_hlsSegments[_hlsSegmentHead]);
+        _hlsSegments[_hlsSegmentHead] = nullptr;
+        _hlsSegmentHead = (_hlsSegmentHead + 1) % VS1053_HLS_MAX_SEGMENTS;
+        _hlsSegmentCount--;
+    }
+    _hlsSegmentHead = 0;
+
+    free(_hlsPlaylistUrl);
+    _hlsPlaylistUrl = nullptr;
+    free(_hlsSegmentUrl);
+    _hlsSegmentUrl = nullptr;
+
+    _hlsNextSequence = 0;
+    _hlsTargetDuration = 0;
+    _hlsRefreshMS = 0;
+    _hlsFailures = 0;
+    _hlsEndList = false;
+    _hlsMore = false;
+    _hls = false;
+}
+
+int ESP32_VS1053_Stream::_hlsRequest(char *&url)
+{
+    for (uint8_t redirects = 0;; redirects++)
+    {
+        bool reused = false;
+        _http = _takeHttp(url, reused);
+        if (!_http)
+            return HTTPC_ERROR_TOO_LESS_RAM;
+
+        const bool isHttps = !strncasecmp(url, "https://", 8);
+        _http->setConnectTimeout(isHttps ? VS1053_CONNECT_TIMEOUT_MS_SSL
+                                         : VS1053_CONNECT_TIMEOUT_MS);
+        _http->useHTTP10(!VS1053_CHUNKED_ENABLED);
+
+        if (!_http->begin(url))
+        {
+            _closeHttp();
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+
+        _http->collectHeaders(_header, sizeof(_header) / sizeof(_header[0]));
+        _http->setFollowRedirects(HTTPC_DISABLE_FOLLOW_REDIRECTS);
+
+        int result = _http->GET();
+        if (result < 0 && reused)
+        {
+            log_d("kept connection was closed by the server, reconnecting");
+            result = _http->GET();
+        }
+
+        if (result == 200 || result == 206)
+            return result;
+
+        if ((result != 301 && result != 302) || redirects == VS1053_MAX_REDIRECT_COUNT || !_http->hasHeader(LOCATION))
+        {
+            _closeHttp();
+            return result;
+        }
+
         char *location = reinterpret_cast<char *>(_localbuffer);
+        _resolveRedirect(_http->header(LOCATION).c_str(), url, location);
+        _closeHttp();
+
+        char *copy = strdup(location);
+        if (!copy)
+            return HTTPC_ERROR_TOO_LESS_RAM;
+
+        log_d("%i redirection to: %s", result, copy);
+        free(url);
+        url = copy;
+    }
+}
+
+bool ESP32_VS1053_Stream::_hlsLoadPlaylist(const bool variant)
+{
+    const int result = _hlsRequest(_hlsPlaylistUrl);
+    if (result != 200 && result != 206)
+    {
+        log_w("could not load playlist %s", _hlsPlaylistUrl);
+        _reportHttpError(result);
+        return false;
+    }
+
+    String body = _http->getString();
+    _closeHttp(_hlsPlaylistUrl);
+    _hlsRefreshMS = millis();
+
+    char *text = body.begin();
+    if (!text || strncmp(text, "#EXTM3U", 7))
+    {
+        log_e("not a hls playlist");
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_HLS_PLAYLIST);
+        return false;
+    }
+
+    if (strstr(text, "#EXT-X-STREAM-INF:"))
+    {
+        // a master playlist that points to a master playlist is not followed
+        if (variant || !_hlsSelectVariant(text))
+        {
+            if (_errorCallback)
+                _emitText(EVENT_ERROR, ERROR_HLS_PLAYLIST);
+            return false;
+        }
+        return _hlsLoadPlaylist(true);
+    }
+
+    // encrypted and fragmented mp4 segments can not be played
+    const char *key = strstr(text, "#EXT-X-KEY:");
+    if ((key && !strstr(key, "METHOD=NONE")) || strstr(text, "#EXT-X-MAP:"))
+    {
+        log_e("encrypted or fmp4 hls streams are not supported");
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_HLS_UNSUPPORTED);
+        return false;
+    }
+
+    const char *tag = strstr(text, "#EXT-X-TARGETDURATION:");
+    _hlsTargetDuration = tag ? max(atoi(tag + 22), 1) : 10;
+    tag = strstr(text, "#EXT-X-MEDIA-SEQUENCE:");
+    const uint32_t mediaSequence = tag ? strtoul(tag + 22, nullptr, 10) : 0;
+    _hlsEndList = strstr(text, "#EXT-X-ENDLIST") != nullptr;
+
+    size_t segments = 0;
+    for (const char *p = strstr(text, "#EXTINF:"); p; p = strstr(p + 8, "#EXTINF:"))
+        segments++;
+
+    if (!_hlsNextSequence)
+    {
+        // start a live stream close to the live edge, a stream on demand at the start
+        const size_t skip = (!_hlsEndList && segments > VS1053_HLS_LIVE_START_SEGMENTS) ? segments - VS1053_HLS_LIVE_START_SEGMENTS : 0;
+        _hlsNextSequence = mediaSequence + skip;
+    }
+    else if (_hlsNextSequence < mediaSequence)
+    {
+        log_w("fell behind the live window, skipping %lu segments", (unsigned long)(mediaSequence - _hlsNextSequence));
+        _hlsNextSequence = mediaSequence;
+    }
+
+    _hlsMore = false;
+    uint32_t sequence = mediaSequence;
+    char *line = text;
+    while (line)
+    {
+        char *next = strchr(line, '\n');
+        if (next)
+            *next++ = '\0';
+        line[strcspn(line, "\r")] = '\0';
+
+        if (line[0] == '#' || line[0] == '\0' || sequence++ < _hlsNextSequence)
+        {
+            line = next;
+            continue;
+        }
+
+        if (_hlsSegmentCount == VS1053_HLS_MAX_SEGMENTS)
+        {
+            _hlsMore = true;
+            break;
+        }
+
+        char *resolved = reinterpret_cast<char *>(_localbuffer);
+        _resolveRedirect(line, _hlsPlaylistUrl, resolved);
+
+        char *segment = strdup(resolved);
+        if (!segment)
+            break;
+
+        _hlsSegments[(_hlsSegmentHead + _hlsSegmentCount) % VS1053_HLS_MAX_SEGMENTS] = segment;
+        _hlsSegmentCount++;
+        _hlsNextSequence = sequence;
+        line = next;
+    }
+
+    log_d("playlist has %zu segments, %zu queued, next sequence %lu", segments, _hlsSegmentCount, (unsigned long)_hlsNextSequence);
+    return true;
+}
+
+bool ESP32_VS1053_Stream::_hlsSelectVariant(char *text)
+{
+    const char *best = nullptr;
+    uint32_t bestBandwidth = 0;
+    bool bestAudioOnly = false;
+
+    char *line = text;
+    const char *info = nullptr;
+    while (line)
+    {
+        char *next = strchr(line, '\n');
+        if (next)
+            *next++ = '\0';
+        line[strcspn(line, "\r")] = '\0';
+
+        if (!strncmp(line, "#EXT-X-STREAM-INF:", 18))
+            info = line;
+        else if (info && line[0] != '#' && line[0] != '\0')
+        {
+            // not AVERAGE-BANDWIDTH
+            const char *attribute = strstr(info, ":BANDWIDTH=");
+            if (!attribute)
+                attribute = strstr(info, ",BANDWIDTH=");
+            const uint32_t bandwidth = attribute ? strtoul(attribute + 11, nullptr, 10) : 0;
+            const char *codecs = strstr(info, "CODECS=");
+            const bool audioOnly = codecs && !strstr(codecs, "avc1") && !strstr(codecs, "hvc1") && !strstr(codecs, "hev1");
+            info = nullptr;
+
+            // prefer audio only variants, then the highest bandwidth that fits or else the lowest
+            const bool fits = bandwidth <= VS1053_HLS_MAX_BANDWIDTH;
+            const bool bestFits = bestBandwidth <= VS1053_HLS_MAX_BANDWIDTH;
+            bool better = !best;
+            if (!better && audioOnly != bestAudioOnly)
+                better = audioOnly;
+            else if (!better)
+                better = (fits && bestFits) ? bandwidth > bestBandwidth : bandwidth < bestBandwidth;
+
+            if (better)
+            {
+                best = line;
+                bestBandwidth = bandwidth;
+                bestAudioOnly = audioOnly;
+            }
+        }
+        line = next;
+    }
+
+    if (!best)
+        return false;
+
+    char *resolved = reinterpret_cast<char *>(_localbuffer);
+    _resolveRedirect(best, _hlsPlaylistUrl, resolved);
+
+    char *copy = strdup(resolved);
+    if (!copy)
+        return false;
+
+    log_i("hls variant %lu bits/s %s", (unsigned long)bestBandwidth, copy);
+    free(_hlsPlaylistUrl);
+    _hlsPlaylistUrl = copy;
+    return true;
+}
+
+bool ESP32_VS1053_Stream::_hlsAdvance()
+{
+    if (!_hlsSegmentCount && (!_hlsEndList || _hlsMore))
+    {
+        // a live playlist gets new segments about once per target duration
+        if (!_hlsMore && millis() - _hlsRefreshMS < _hlsTargetDuration * 500UL)
+            return false;
+
+        if (!_hlsLoadPlaylist())
+        {
+            if (++_hlsFailures >= VS1053_HLS_MAX_PLAYLIST_FAILURES)
+            {
+                log_e("giving up on %s", _hlsPlaylistUrl);
+                _sourceState = SOURCE_FAILED;
+            }
+            return false;
+        }
+        _hlsFailures = 0;
+    }
+
+    while (_hlsSegmentCount)
+    {
+        free(_hlsSegmentUrl);
+        _hlsSegmentUrl = _hlsSegments[_hlsSegmentHead];
+        _hlsSegments[_hlsSegmentHead] = nullptr;
+        _hlsSegmentHead = (_hlsSegmentHead + 1) % VS1053_HLS_MAX_SEGMENTS;
+        _hlsSegmentCount--;
+
+        if (_hlsOpenSegment())
+            return true;
+
+        log_w("skipping segment %s", _hlsSegmentUrl);
+    }
+
+    if (_hlsEndList && !_hlsMore)
+    {
+        log_d("end of hls playlist");
+        _hlsStop();
+        _draining = true;
+        _sourceState = SOURCE_DONE;
+    }
+    return false;
+}
+
+bool ESP32_VS1053_Stream::_hlsOpenSegment()
+{
+    const int result = _hlsRequest(_hlsSegmentUrl);
+    if (result != 200 && result != 206)
+    {
+        log_w("segment request failed: %i", result);
+        return false;
+    }
+
+    const int32_t contentLength = _http->getSize();
+#if VS1053_CHUNKED_ENABLED
+    _chunkedResponse = _http->header(ENCODING).equalsIgnoreCase("chunked");
+#endif
+    _sourceRemaining = contentLength >= 0 ? contentLength : -1;
+#if VS1053_ICY_METADATA
+    _metaDataStart = 0;
+    _musicDataPosition = -1;
+#endif
+    _resetFraming();
+    _hlsFormat = HLS_FORMAT_UNKNOWN;
+    _hlsSkip = 0;
+    _tsDemux.reset();
+
+    log_d("segment %s", _hlsSegmentUrl);
+    return true;
+}
+
+void ESP32_VS1053_Stream::_hlsCloseSegment()
+{
+    if (!_http)
+        return;
+
+    const bool complete = !_chunkedResponse && !_sourceRemaining;
+    _closeHttp(complete ? _hlsSegmentUrl : nullptr);
+}
+
+size_t ESP32_VS1053_Stream::_hlsToRingBuffer()
+{
+    // the next segment is requested as soon as the previous one is received
+    if (!_http && !_hlsAdvance())
+        return 0;
+
+    WiFiClient *stream = _http->getStreamPtr();
+    if (!stream)
+    {
+        log_v("Stream connection lost");
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_CONNECTION_LOST);
+        _sourceState = SOURCE_FAILED;
+        return 0;
+    }
+
+#if VS1053_CHUNKED_ENABLED
+    const bool received = !_sourceRemaining || _chunkState == CHUNK_END || _chunkState == CHUNK_ERROR ||
+                          (!stream->available() && !_http->connected());
+#else
+    const bool received = !_sourceRemaining || (!stream->available() && !_http->connected());
+#endif
+    if (received)
+    {
+        _hlsCloseSegment();
+        return 0;
+    }
+
+    // a completed transport stream packet yields up to a packet of audio
+    if (!stream->available() || _ringbuffer.free() < VS1053_TsDemux::PACKET_SIZE)
+        return 0;
+
+    [[maybe_unused]] const auto startTimeMS = millis();
+
+    constexpr size_t MAX_MOVE = 1024;
+
+    size_t space = 0;
+    uint8_t *dest = _acquireSource(space);
+    if (!dest)
+        return 0;
+
+    // finish a transport stream packet that was cut off by the previous read first
+    const size_t missing = _tsDemux.missing();
+    uint8_t *target = missing ? _tsDemux.carry() : dest;
+    size_t toRead = missing ? missing : min(space, MAX_MOVE);
+    if (_sourceRemaining > 0)
+        toRead = min(toRead, (size_t)_sourceRemaining);
+
+    const int result = stream->read(target, toRead);
+    if (result <= 0)
+        return 0;
+
+    _stats.bytesReceived += result;
+    if (_sourceRemaining > 0)
+        _sourceRemaining -= result;
+
+#if VS1053_CHUNKED_ENABLED
+    size_t len = _chunkedResponse ? _dechunk(target, result) : result;
+#else
+    size_t len = result;
+#endif
+
+    if (missing)
+    {
+        len = _tsDemux.complete(len);
+        const uint8_t *payload = _tsDemux.payload();
+        _record(payload, len);
+        if (_sourceToSpill)
+            return _spillWrite(payload, len) ? len : 0;
+
+        size_t written = 0;
+        while (written < len && (dest = _ringbuffer.acquireWrite(space)))
+        {
+            const size_t bytes = min(space, len - written);
+            memcpy(dest, payload + written, bytes);
+            _ringbuffer.commitWrite(bytes);
+            written += bytes;
+        }
+        return written;
+    }
+
+    if (_hlsFormat == HLS_FORMAT_UNKNOWN && len)
+    {
+        _hlsFormat = (dest[0] == 0x47) ? HLS_FORMAT_TS : HLS_FORMAT_PACKED;
+
+        // packed audio starts with an id3 timestamp tag, the decoder would try to play it
+        if (_hlsFormat == HLS_FORMAT_PACKED && len >= 10 && !memcmp(dest, "ID3", 3))
+            _hlsSkip = 10 + ((dest[6] & 0x7F) << 21 | (dest[7] & 0x7F) << 14 | (dest[8] & 0x7F) << 7 | (dest[9] & 0x7F));
+    }
+
+    if (_hlsSkip)
+    {
+        const size_t skip = min(_hlsSkip, len);
+        memmove(dest, dest + skip, len - skip);
+        len -= skip;
+        _hlsSkip -= skip;
+    }
+
+    if (_hlsFormat == HLS_FORMAT_TS)
+        len = _tsDemux.demux(dest, len);
+
+    _commitSource(dest, len);
+    log_d("%lu ms moving %zu bytes hls->ringbuffer", millis() - startTimeMS, len);
+    return len;
+}
+#endif
+
+void ESP32_VS1053_Stream::_reportHttpError(const int result)
+{
+    if (!_errorCallback)
+        return;
+
+    char *buff = reinterpret_cast<char *>(_localbuffer);
+    if (result < 0)
+        snprintf(buff, VS1053_LOCALBUFFER_SIZE, "Http error: %s", HTTPClient::errorToString(result).c_str());
+    else
+        snprintf(buff, VS1053_LOCALBUFFER_SIZE, "Server error: %i", result);
+
+    _emitText(EVENT_ERROR, buff);
+}
+
+size_t ESP32_VS1053_Stream::_playFromRingBuffer()
+{
+    if (_paused)
+        return 0;
+
+    if (_sourceState == SOURCE_FAILED && !_handoverPending)
+    {
+        _remainingBytes = 0;
+        return 0;
+    }
+
+    if ((_http || _hls) && !_dataSeen)
+        _setupStream();
+
+    if (!_ringbuffer_filled)
+    {
+        const size_t filled = _prebufferBytes();
+        const size_t required = min(size() ? size() : filled, filled);
+        const size_t used = _ringbuffer.used();
+
+        if (used < required && _sourceState == SOURCE_ACTIVE)
+        {
+            if (used != _prebufferLevel || !_prebufferProgressMS)
+            {
+                _prebufferLevel = used;
+                _prebufferProgressMS = millis() ?: 1;
+            }
+            else if (_reconnecting)
+                _prebufferProgressMS = millis() ?: 1; // waiting for the connection to come back is progress
+            else if (millis() - _prebufferProgressMS > VS1053_STREAM_TIMEOUT_MS)
+            {
+                log_v("Stream timeout %lu ms", (unsigned long)VS1053_STREAM_TIMEOUT_MS);
+                if (_errorCallback)
+                    _emitText(EVENT_ERROR, ERROR_STREAM_TIMEOUT);
+                _remainingBytes = 0;
+            }
+            return 0;
+        }
+
+        log_d("buffered %zu bytes, jitter %lu ms", used, (unsigned long)_jitterMs);
+        _ringbuffer_filled = true;
+        if (_underrunStartMS)
+        {
+            _stats.underrunMs += millis() - _underrunStartMS;
+            _underrunStartMS = 0;
+        }
+        _prebufferProgressMS = 0;
+        _rateWindowStartMS = 0;
+        _bitrateTimer = millis();
+    }
+
+    _updateBitRate();
+
+    [[maybe_unused]] const auto startTimeMS = millis();
+    size_t bytesToDecoder = 0;
+
+    const size_t MAX_MOVE = size() ? 2048 : 512; // everything without a size is radio so low bitrate
+
+    while (_remainingBytes && bytesToDecoder < MAX_MOVE && _vs1053->data_request())
+    {
+        if (_handoverPending && _ringbuffer.totalRead() == _handoverAt)
+        {
+            _handover();
+            continue;
+        }
+
+        size_t size = 0;
+        uint8_t *data = _ringbuffer.acquireRead(size);
+        if (!data)
+        {
+            if (_sourceState == SOURCE_ACTIVE)
+            {
+                log_w("ringbuffer underrun, rebuffering");
+                _ringbuffer_filled = false;
+                _stats.underruns++;
+                _underrunStartMS = millis() ?: 1;
+                return bytesToDecoder;
+            }
+
+            if (_bufferStallStartMS && (millis() - _bufferStallStartMS) > VS1053_PSRAM_BUFFER_TIMEOUT_MS)
+            {
+                log_v("ringbuffer empty for %i ms, bailing out", VS1053_PSRAM_BUFFER_TIMEOUT_MS);
+                if (_errorCallback && _codec != CODEC_UNKNOWN)
+                    _emitText(EVENT_ERROR, ERROR_RINGBUFFER_EMPTY);
+                _bufferStallStartMS = 0;
+                _remainingBytes = 0;
+                return bytesToDecoder;
+            }
+
+            if (!_bufferStallStartMS)
+            {
+                _bufferStallStartMS = millis() ?: 1;
+                log_w("no ringbuffer data available");
+            }
+            return bytesToDecoder;
+        }
+
+        if (_bufferStallStartMS)
+        {
+            log_v("ringbuffer was empty for %lu ms", millis() - _bufferStallStartMS);
+            _bufferStallStartMS = 0;
+        }
+
+        if (_remainingBytes > 0)
+            size = min(size, (size_t)_remainingBytes);
+        if (_handoverPending)
+            size = min(size, _handoverAt - _ringbuffer.totalRead());
+        size = min(size, MAX_MOVE - bytesToDecoder);
+
+        size = _sdiWrite(data, size);
+        _ringbuffer.commitRead(size);
+        bytesToDecoder += size;
+        _bytesPlayed += size;
+        _remainingBytes -= (_remainingBytes > 0) ? size : 0;
+
+        if (!_remainingBytes && _handoverPending)
+            _handover();
+    }
+    log_d("%lu ms moving %zu bytes ringbuffer->decoder", millis() - startTimeMS, bytesToDecoder);
+
+    // the buffer drains to empty at the end of every item, that is not a low water mark
+    if (_sourceState == SOURCE_ACTIVE && _ringbuffer_filled)
+        _storeMin(_stats.bufferLowWater, _ringbuffer.used());
+
+    _updateMeasuredBitrate(bytesToDecoder);
+    return bytesToDecoder;
+}
+
+size_t ESP32_VS1053_Stream::_sdiWrite(const uint8_t *data, const size_t len)
+{
+    // one transaction for as many bursts as the decoder accepts, instead of one per playChunk() call
+    size_t written = 0;
+    SPI.beginTransaction(_sdiSettings);
+    digitalWrite(_dcsPin, LOW);
+    while (written < len && digitalRead(_dreqPin))
+    {
+        const size_t burst = min(VS1053_PLAYBUFFER_SIZE, len - written);
+        SPI.writeBytes(data + written, burst);
+        written += burst;
+    }
+    digitalWrite(_dcsPin, HIGH);
+    SPI.endTransaction();
+    _stats.bytesDecoded += written;
+    return written;
+}
+
+uint32_t ESP32_VS1053_Stream::_streamKbps()
+{
+    const uint32_t kbps = _measuredBitrate  ? _measuredBitrate
+                          : _bitrate        ? _bitrate
+                          : _icyBitrate     ? _icyBitrate
+                          : _stationBitrate ? _stationBitrate
+                                            : VS1053_DEFAULT_BITRATE_KBPS;
+    _lastKbps = kbps;
+    return kbps;
+}
+
+size_t ESP32_VS1053_Stream::_prebufferBytes()
+{
+    const size_t bytes = (uint64_t)_streamKbps() * (_prebufferMs + _jitterMs) / 8; // kbps * ms / 8 = bytes
+    const size_t maximum = _ringbuffer.capacity() / 4 * 3;                // leave room to keep receiving
+
+    return min(max(bytes, (size_t)2048), maximum);
+}
+
+void ESP32_VS1053_Stream::_updateMeasuredBitrate(const size_t bytes)
+{
+    constexpr unsigned long WINDOW_MS = 2000;
+
+    if (!_rateWindowStartMS)
+    {
+        _rateWindowStartMS = millis();
+        _rateWindowBytes = 0;
+        return;
+    }
+
+    _rateWindowBytes += bytes;
+
+    const unsigned long elapsed = millis() - _rateWindowStartMS;
+    if (elapsed < WINDOW_MS)
+        return;
+
+    // only meaningful when the decoder was not starved, an underrun resets the window
+    _measuredBitrate = (uint64_t)_rateWindowBytes * 8 / elapsed;
+    _rateWindowStartMS = millis();
+    _rateWindowBytes = 0;
+}
+
+void ESP32_VS1053_Stream::_updateJitter()
+{
+    const unsigned long now = millis();
+
+    if (_lastArrivalMS)
+    {
+        if (now - _lastArrivalMS > VS1053_STREAM_STALL_MS)
+            _stats.streamStalls++;
+
+        const uint32_t gap = min(now - _lastArrivalMS, (unsigned long)VS1053_STREAM_TIMEOUT_MS);
+        const uint32_t jitter = _jitterMs;
+        _jitterMs = (gap > jitter) ? gap : jitter - (jitter - gap) / 16;
+    }
+    _lastArrivalMS = now;
+}
+
+void ESP32_VS1053_Stream::setPrebufferTime(const uint32_t ms)
+{
+    _prebufferMs = ms;
+}
+
+size_t ESP32_VS1053_Stream::_streamToRingBuffer(WiFiClient *stream)
+{
+    [[maybe_unused]] const auto startTimeMS = millis();
+
+    const size_t MAX_MOVE = (_sourceRemaining != -1) ? 2048 : 512; // everything without a size is radio so low bitrate
+
+    size_t space = 0;
+    uint8_t *dest = _acquireSource(space);
+    if (!dest)
+        return 0;
+
+    // read the raw response straight into the ringbuffer and strip metadata in place
+    const size_t toRead = min(MAX_MOVE, _sourceRemaining > 0 ? min(space, (size_t)_sourceRemaining) : space);
+    const int result = stream->read(dest, toRead);
+    if (result <= 0)
+        return 0;
+
+    _stats.bytesReceived += result;
+    size_t bytesToRingBuffer = _stripMetadata(dest, result);
+    if (_sniffer.active())
+        bytesToRingBuffer = _sniff(dest, bytesToRingBuffer);
+    _commitSource(dest, bytesToRingBuffer);
+    log_d("%lu ms moving %zu bytes stream->ringbuffer", millis() - startTimeMS, bytesToRingBuffer);
+
+    if (_sourceRemaining > 0)
+    {
+        _sourceRemaining -= result;
+        if (!_sourceRemaining)
+            _sourceState = SOURCE_DONE;
+    }
+
+    return bytesToRingBuffer;
+}
+
+void ESP32_VS1053_Stream::_setupStream()
+{
+    if (!_offset)
+        _vs1053->stopSong();
+    _bitrateTimer = millis();
+    _dataSeen = true;
+}
+
+void ESP32_VS1053_Stream::_handleStream(WiFiClient *stream)
+{
+    if (!_dataSeen)
+        _setupStream();
+
+    _updateBitRate();
+
+    [[maybe_unused]] const auto startTimeMS = millis();
+    size_t bytesFromStream = 0;
+
+    const size_t MAX_MOVE = size() ? 2048 : 512; // everything without a size is radio so low bitrate
+
+    while (_sourceRemaining && !_sniffer.rejected() && bytesFromStream < MAX_MOVE && stream->available() &&
+           _vs1053->data_request())
+    {
+        const size_t toRead = _sourceRemaining > 0 ? min(VS1053_PLAYBUFFER_SIZE, (size_t)_sourceRemaining)
+                                                   : VS1053_PLAYBUFFER_SIZE;
+        const int result = stream->read(_vs1053Buffer, toRead);
+        if (result <= 0)
+            break;
+
+        _stats.bytesReceived += result;
+        size_t inBuffer = _stripMetadata(_vs1053Buffer, result);
+        if (_sniffer.active())
+            inBuffer = _sniff(_vs1053Buffer, inBuffer);
+        _record(_vs1053Buffer, inBuffer);
+        if (inBuffer)
+            _sdiWrite(_vs1053Buffer, inBuffer); // a data request guarantees room for VS1053_PLAYBUFFER_SIZE bytes
+        _bytesPlayed += inBuffer;
+        _remainingBytes -= _remainingBytes > 0 ? min((int32_t)inBuffer, _remainingBytes) : 0;
+        _sourceRemaining -= _sourceRemaining > 0 ? result : 0;
+        bytesFromStream += result;
+    }
+    log_d("%lu ms moving %zu bytes stream->decoder", millis() - startTimeMS, bytesFromStream);
+
+    if (!_sourceRemaining || _sniffer.rejected())
+        _remainingBytes = 0;
+}
+
+#if VS1053_CHUNKED_ENABLED
+size_t ESP32_VS1053_Stream::_chunkedStreamToRingBuffer(WiFiClient *stream)
+{
+    [[maybe_unused]] const auto startTimeMS = millis();
+
+    constexpr size_t MAX_MOVE = 512; // chunked responses have no size so they are radio
+
+    size_t space = 0;
+    uint8_t *dest = _acquireSource(space);
+    if (!dest)
+        return 0;
+
+    // read the raw response straight into the ringbuffer and strip chunk framing and metadata in place
+    const int result = stream->read(dest, min(space, MAX_MOVE));
+    if (result <= 0)
+        return 0;
+
+    _stats.bytesReceived += result;
+    size_t bytesToRingBuffer = _stripMetadata(dest, _dechunk(dest, result));
+    if (_sniffer.active())
+        bytesToRingBuffer = _sniff(dest, bytesToRingBuffer);
+    _commitSource(dest, bytesToRingBuffer);
+    log_d("%lu ms moving %zu bytes chunked->ringbuffer", millis() - startTimeMS, bytesToRingBuffer);
+
+    // broken framing is a broken connection, not the end of the stream
+    if (_chunkState == CHUNK_END)
+        _sourceState = SOURCE_DONE;
+    else if (_chunkState == CHUNK_ERROR && !_connectionDropped())
+        _sourceState = SOURCE_FAILED;
+
+    return bytesToRingBuffer;
+}
+
+void ESP32_VS1053_Stream::_handleChunkedStream(WiFiClient *stream)
+{
+    if (!_dataSeen)
+        _setupStream();
+
+    _updateBitRate();
+
+    [[maybe_unused]] const auto startTimeMS = millis();
+    size_t bytesFromStream = 0;
+
+    constexpr size_t MAX_MOVE = 512; // chunked responses have no size so they are radio
+
+    // a chunk of raw response never yields more than the decoder accepts after a data request
+    while (_chunkState != CHUNK_END && _chunkState != CHUNK_ERROR && !_sniffer.rejected() &&
+           bytesFromStream < MAX_MOVE && stream->available() && _vs1053->data_request())
+    {
+        const int result = stream->read(_vs1053Buffer, VS1053_PLAYBUFFER_SIZE);
+        if (result <= 0)
+            break;
+
+        _stats.bytesReceived += result;
+        size_t inBuffer = _stripMetadata(_vs1053Buffer, _dechunk(_vs1053Buffer, result));
+        if (_sniffer.active())
+            inBuffer = _sniff(_vs1053Buffer, inBuffer);
+        _record(_vs1053Buffer, inBuffer);
+        if (inBuffer)
+            _sdiWrite(_vs1053Buffer, inBuffer);
+        _bytesPlayed += inBuffer;
+        bytesFromStream += result;
+    }
+    log_d("%lu ms moving %zu bytes chunked->decoder", millis() - startTimeMS, bytesFromStream);
+
+    // without a ringbuffer there is no reconnect, broken framing ends the stream like a lost connection
+    if (_chunkState == CHUNK_END || _chunkState == CHUNK_ERROR || _sniffer.rejected())
+        _remainingBytes = 0;
+}
+#endif
+
+void ESP32_VS1053_Stream::_feedDecoder(WiFiClient *stream)
+{
+#if VS1053_CHUNKED_ENABLED
+    if (_chunkedResponse)
+        _handleChunkedStream(stream);
+    else
+#endif
+        _handleStream(stream);
+
+    if (!_remainingBytes)
+        _eofStream();
+}
+
+size_t ESP32_VS1053_Stream::_fillRingBuffer()
+{
+    if (!_ringbuffer.allocated())
+        return 0;
+
+    _storeMax(_stats.bufferHighWater, _ringbuffer.used());
+
+    if (_sourceState == SOURCE_DONE && !_handoverPending && _queueCount)
+        _preloadNext();
+
+    if (_sourceState != SOURCE_ACTIVE)
+        return 0;
+
+    if (!_ringbuffer.free())
+    {
+        _lastArrivalMS = 0; // a full buffer is not a network gap
+        return 0;
+    }
+
+    // time-shifted audio plays before anything that arrives now
+    if (_spillReadPos != _spillWritePos)
+    {
+        const size_t restored = _spillToRingBuffer();
+        if (restored)
+            return restored;
+    }
+
+    if (_playingFile)
+        return _fileToRingBuffer();
+
+#if VS1053_HLS_ENABLED
+    if (_hls)
+    {
+        const size_t moved = _hlsToRingBuffer();
+        if (moved)
+            _updateJitter();
+        return moved;
+    }
+#endif
+
+    if (_reconnecting)
+        return _reconnect();
+
+    if (!_http)
+        return 0;
+
+    if (!_http->connected())
+    {
+        if (!_connectionDropped())
+            _sourceState = SOURCE_DONE;
+        return 0;
+    }
+
+    WiFiClient *stream = _http->getStreamPtr();
+    if (!stream)
+    {
+        if (_connectionDropped())
+            return 0;
+
+        log_v("Stream connection lost");
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_CONNECTION_LOST);
+        _sourceState = SOURCE_FAILED;
+        return 0;
+    }
+
+    if (!stream->available())
+    {
+        // a connection that stays open without sending anything is as good as dropped
+        if (_lastArrivalMS && millis() - _lastArrivalMS > VS1053_RECONNECT_TIMEOUT_MS)
+            _connectionDropped();
+        return 0;
+    }
+
+#if VS1053_CHUNKED_ENABLED
+    const size_t moved = _chunkedResponse ? _chunkedStreamToRingBuffer(stream) : _streamToRingBuffer(stream);
+#else
+    const size_t moved = _streamToRingBuffer(stream);
+#endif
+    if (moved)
+        _updateJitter();
+    return moved;
+}
+
+bool ESP32_VS1053_Stream::_connectionDropped()
+{
+    // a download is resumed from the first missing byte, an icy stream is joined again
+    const bool resumable = _sourceRemaining > 0;
+    const bool live = _sourceRemaining == -1 && (_metaDataStart || _icyBitrate);
+    if (!VS1053_RECONNECT_ATTEMPTS || !(resumable || live))
+        return false;
+
+    log_w("connection dropped, reconnecting");
+    _closeHttp();
+    _reconnecting = true;
+    _reconnectAttempt = 0;
+    _reconnectMS = millis();
+    _lastArrivalMS = 0;
+    return true;
+}
+
+size_t ESP32_VS1053_Stream::_reconnect()
+{
+    if (millis() - _reconnectMS < _reconnectAttempt * VS1053_RECONNECT_DELAY_MS)
+        return 0;
+
+    // the source is the preloaded next item when a handover is pending, queued items have no credentials
+    char *url = nullptr;
+    char *username = nullptr;
+    char *pwd = nullptr;
+    size_t size = 0;
+    {
+        Lock lock(_decoderMutex);
+        const char *source = _handoverPending ? _next.url : _url;
+        url = source ? strdup(source) : nullptr;
+        size = _handoverPending ? _next.size : _trackSize;
+        username = strdup((!_handoverPending && _username) ? _username : "");
+        pwd = strdup((!_handoverPending && _pwd) ? _pwd : "");
+    }
+    const int32_t missing = _sourceRemaining;
+    const size_t offset = missing > 0 ? size - missing : 0;
+
+    bool opened = false;
+    bool rejected = false;
+    if (url && username && pwd && WiFi.isConnected())
+    {
+        // failed attempts are not errors, giving up is
+        _muteErrors = true;
+        opened = _openHost(url, username, pwd, offset);
+        _muteErrors = false;
+
+        // anything but the missing part means the file changed or the server ignored the range
+        rejected = opened && missing > 0 && _sourceRemaining != missing;
+        if (rejected)
+        {
+            log_w("resume at %zu rejected", offset);
+            _closeHttp();
+            _sourceRemaining = missing;
+            opened = false;
+        }
+    }
+    free(url);
+    free(username);
+    free(pwd);
+
+    if (opened)
+    {
+        log_i("reconnected after %i attempts", _reconnectAttempt + 1);
+        _reconnecting = false;
+        _stats.reconnects++;
+        return 0;
+    }
+
+    if (rejected || ++_reconnectAttempt >= VS1053_RECONNECT_ATTEMPTS)
+    {
+        log_w("could not reconnect");
+        _reconnecting = false;
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_CONNECTION_LOST);
+        _sourceState = SOURCE_FAILED;
+        return 0;
+    }
+
+    _reconnectMS = millis();
+    return 0;
+}
+
+void ESP32_VS1053_Stream::_bufferTaskLoop(void *arg)
+{
+    ESP32_VS1053_Stream *self = static_cast<ESP32_VS1053_Stream *>(arg);
+
+    while (!self->_bufferTaskStop)
+    {
+        size_t moved = 0;
+        {
+            Lock lock(self->_sourceMutex);
+            moved = self->_fillRingBuffer();
+        }
+
+        if (!moved)
+            vTaskDelay(1);
+    }
+
+    self->_bufferTaskRunning = false;
+    vTaskDelete(nullptr);
+}
+
+bool ESP32_VS1053_Stream::startBufferTask(const BaseType_t core, const UBaseType_t priority, const uint32_t stackSize)
+{
+    if (!_ringbuffer.allocated() || _bufferTaskRunning)
+        return false;
+
+    _bufferTaskStop = false;
+    _bufferTaskRunning = true;
+
+    if (xTaskCreatePinnedToCore(_bufferTaskLoop, "vs1053_buffer", stackSize, this, priority, &_bufferTask, core) != pdPASS)
+    {
+        log_e("Could not start buffer task");
+        _bufferTaskRunning = false;
+        _bufferTask = nullptr;
+        return false;
+    }
+    log_d("Buffer task started on core %i", core);
+    return true;
+}
+
+void ESP32_VS1053_Stream::stopBufferTask()
+{
+    if (!_bufferTaskRunning)
+        return;
+
+    _bufferTaskStop = true;
+    while (_bufferTaskRunning)
+        delay(1);
+
+    _bufferTask = nullptr;
+}
+
+void IRAM_ATTR ESP32_VS1053_Stream::_dreqISR(void *arg)
+{
+    ESP32_VS1053_Stream *self = static_cast<ESP32_VS1053_Stream *>(arg);
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    vTaskNotifyGiveFromISR(self->_feederTask, &higherPriorityTaskWoken);
+    if (higherPriorityTaskWoken)
+        portYIELD_FROM_ISR();
+}
+
+void ESP32_VS1053_Stream::_feederTaskLoop(void *arg)
+{
+    ESP32_VS1053_Stream *self = static_cast<ESP32_VS1053_Stream *>(arg);
+
+    while (!self->_feederTaskStop)
+    {
+        // woken by a rising DREQ edge, the timeout keeps prebuffering and bitrate polling going
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(VS1053_FEEDER_TASK_TIMEOUT_MS));
+
+        Lock lock(self->_decoderMutex);
+        while (!self->_feederTaskStop && self->_ringbuffer.allocated() && self->isRunning() &&
+               self->_remainingBytes && self->_playFromRingBuffer())
+            ;
+    }
+
+    self->_feederTaskRunning = false;
+    vTaskDelete(nullptr);
+}
+
+bool ESP32_VS1053_Stream::startFeederTask(const BaseType_t core, const UBaseType_t priority, const uint32_t stackSize)
+{
+    if (!_ringbuffer.allocated() || _feederTaskRunning)
+        return false;
+
+    _feederTaskStop = false;
+    _feederTaskRunning = true;
+
+    if (xTaskCreatePinnedToCore(_feederTaskLoop, "vs1053_feeder", stackSize, this, priority, &_feederTask, core) != pdPASS)
+    {
+        log_e("Could not start feeder task");
+        _feederTaskRunning = false;
+        _feederTask = nullptr;
+        return false;
+    }
+
+    attachInterruptArg(_dreqPin, _dreqISR, this, RISING);
+    log_d("Feeder task started on core %i", core);
+    return true;
+}
+
+void ESP32_VS1053_Stream::stopFeederTask()
+{
+    if (_sharedFeeder)
+    {
+        _leaveSharedFeeder();
+        return;
+    }
+
+    if (!_feederTaskRunning)
+        return;
+
+    detachInterrupt(_dreqPin);
+
+    _feederTaskStop = true;
+    xTaskNotifyGive(_feederTask);
+    while (_feederTaskRunning)
+        delay(1);
+
+    _feederTask = nullptr;
+}
+
+bool ESP32_VS1053_Stream::startSharedFeederTask(const BaseType_t core, const UBaseType_t priority, const uint32_t stackSize)
+{
+    if (!_ringbuffer.allocated() || _feederTaskRunning)
+        return false;
+
+    if (!_sharedMutex)
+        _sharedMutex = xSemaphoreCreateRecursiveMutex();
+    if (!_sharedMutex)
+        return false;
+
+    Lock lock(_sharedMutex);
+
+    if (_sharedCount == VS1053_MAX_DECODERS)
+    {
+        log_e("Shared feeder task is full");
+        return false;
+    }
+
+    // the first decoder starts the task, later ones join it
+    if (!_sharedFeederRunning)
+    {
+        _sharedFeederRunning = true;
+        if (xTaskCreatePinnedToCore(_sharedFeederTaskLoop, "vs1053_shared", stackSize, nullptr, priority,
+                                    &_sharedFeederTask, core) != pdPASS)
+        {
+            log_e("Could not start shared feeder task");
+            _sharedFeederRunning = false;
+            _sharedFeederTask = nullptr;
+            return false;
+        }
+        log_d("Shared feeder task started on core %i", core);
+    }
+
+    _shared[_sharedCount++] = this;
+    _sharedFeeder = true;
+    _feederTask = _sharedFeederTask;
+    _feederTaskRunning = true;
+    attachInterruptArg(_dreqPin, _dreqISR, this, RISING);
+    return true;
+}
+
+void ESP32_VS1053_Stream::_leaveSharedFeeder()
+{
+    detachInterrupt(_dreqPin);
+
+    bool last = false;
+    {
+        // the task holds the lock for a whole round so it is not feeding this decoder after this
+        Lock lock(_sharedMutex);
+        for (size_t i = 0; i < _sharedCount; i++)
+            if (_shared[i] == this)
+            {
+                _shared[i] = _shared[--_sharedCount];
+                break;
+            }
+        last = !_sharedCount;
+    }
+
+    _sharedFeeder = false;
+    _feederTask = nullptr;
+    _feederTaskRunning = false;
+
+    // the task ends on its next wake up unless another decoder joined in the meantime
+    while (last)
+    {
+        {
+            Lock lock(_sharedMutex);
+            if (!_sharedFeederRunning || _sharedCount)
+                break;
+        }
+        delay(1);
+    }
+}
+
+void ESP32_VS1053_Stream::_sharedFeederTaskLoop(void * /*arg*/)
+{
+    while (true)
+    {
+        // woken by the DREQ edge of any decoder
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(VS1053_FEEDER_TASK_TIMEOUT_MS));
+
+        Lock lock(_sharedMutex);
+        if (!_sharedCount)
+        {
+            // ends under the lock so a decoder that joins now starts a new task
+            _sharedFeederTask = nullptr;
+            _sharedFeederRunning = false;
+            break;
+        }
+
+        // the decoder with the least buffered audio goes first, every hungry decoder gets a burst per round
+        ESP32_VS1053_Stream *order[VS1053_MAX_DECODERS];
+        uint32_t bufferedMs[VS1053_MAX_DECODERS];
+        for (size_t i = 0; i < _sharedCount; i++)
+        {
+            ESP32_VS1053_Stream *stream = _shared[i];
+            // the bitrate fields belong to the other instance's locks, its last estimate is kept in an atomic
+            const uint32_t ms = (uint64_t)stream->_ringbuffer.used() * 8 / stream->_lastKbps;
+            size_t j = i;
+            for (; j > 0 && bufferedMs[j - 1] > ms; j--)
+            {
+                order[j] = order[j - 1];
+                bufferedMs[j] = bufferedMs[j - 1];
+            }
+            order[j] = stream;
+            bufferedMs[j] = ms;
+        }
+
+        bool fed = true;
+        while (fed)
+        {
+            fed = false;
+            for (size_t i = 0; i < _sharedCount; i++)
+            {
+                ESP32_VS1053_Stream *stream = order[i];
+                if (!digitalRead(stream->_dreqPin))
+                    continue;
+
+                Lock decoderLock(stream->_decoderMutex);
+                if (stream->isRunning() && stream->_remainingBytes && stream->_playFromRingBuffer())
+                    fed = true;
+            }
+        }
+    }
+
+    vTaskDelete(nullptr);
+}
+
+bool ESP32_VS1053_Stream::startRecording(fs::FS &fs, const char *filename, const bool splitOnTitle)
+{
+    Lock lock(_sourceMutex);
+
+    if (_recording || _recordTaskRunning || !filename)
+        return false;
+
+    const uint32_t caps = psramFound() ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    if (!_recordBuffer.allocate(VS1053_RECORD_BUFFER_SIZE, caps))
+    {
+        log_e("Could not allocate recording buffer");
+        return false;
+    }
+
+    _recordFs = &fs;
+    _recordName = strdup(filename);
+    _recordPart = 0;
+    if (!_recordName || !_openRecordFile())
+    {
+        stopRecording();
+        return false;
+    }
+
+    _recordSplit = splitOnTitle;
+    _recordTitleHash = 0;
+    _recordSplitQueued = false;
+    _recordTaskStop = false;
+    _recordTaskRunning = true;
+
+    if (xTaskCreatePinnedToCore(_recordTaskLoop, "vs1053_record", VS1053_RECORD_TASK_STACK, this,
+                                VS1053_RECORD_TASK_PRIORITY, &_recordTask, VS1053_RECORD_TASK_CORE) != pdPASS)
+    {
+        log_e("Could not start record task");
+        _recordTaskRunning = false;
+        _recordTask = nullptr;
+        stopRecording();
+        return false;
+    }
+
+    _recording = true;
+    return true;
+}
+
+void ESP32_VS1053_Stream::stopRecording()
+{
+    {
+        Lock lock(_sourceMutex);
+        _recording = false;
+    }
+
+    // the task writes out what is left in the buffer before it ends
+    if (_recordTaskRunning)
+    {
+        _recordTaskStop = true;
+        while (_recordTaskRunning)
+            delay(1);
+        _recordTask = nullptr;
+    }
+
+    _recordFile.close();
+    free(_recordName);
+    _recordName = nullptr;
+    _recordFs = nullptr;
+    _recordBuffer.release();
+}
+
+bool ESP32_VS1053_Stream::isRecording()
+{
+    return _recording;
+}
+
+void ESP32_VS1053_Stream::_record(const uint8_t *data, const size_t len)
+{
+    if (!_recording || !len)
+        return;
+
+    size_t written = 0;
+    size_t space = 0;
+    uint8_t *dest = nullptr;
+    while (written < len && (dest = _recordBuffer.acquireWrite(space)))
+    {
+        const size_t bytes = min(space, len - written);
+        memcpy(dest, data + written, bytes);
+        _recordBuffer.commitWrite(bytes);
+        written += bytes;
+    }
+
+    // never wait for the card, a gap in the recording is better than one in playback
+    if (written < len)
+        log_w("recording buffer full, dropped %zu bytes", len - written);
+}
+
+void ESP32_VS1053_Stream::_recordTitle(const char *title, const size_t audioBefore)
+{
+    // fnv-1a, only a change of title matters
+    uint32_t hash = 2166136261u;
+    for (const char *p = title; *p; p++)
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+
+    // the new file starts behind the audio that came before the metadata, the whole read is recorded later
+    if (_recordTitleHash && hash != _recordTitleHash && !_recordSplitQueued)
+    {
+        _recordSplitAt = _recordBuffer.totalWritten() + audioBefore;
+        _recordSplitQueued = true;
+    }
+    _recordTitleHash = hash;
+}
+
+bool ESP32_VS1053_Stream::_openRecordFile()
+{
+    _recordFile.close();
+
+    // show.mp3, show-1.mp3, show-2.mp3...
+    char name[256];
+    const char *dot = strrchr(_recordName, '.');
+    const char *slash = strrchr(_recordName, '/');
+    if (!_recordPart)
+        snprintf(name, sizeof(name), "%s", _recordName);
+    else if (dot && (!slash || dot > slash))
+        snprintf(name, sizeof(name), "%.*s-%u%s", int(dot - _recordName), _recordName, _recordPart, dot);
+    else
+        snprintf(name, sizeof(name), "%s-%u", _recordName, _recordPart);
+    _recordPart++;
+
+    _recordFile = _recordFs->open(name, FILE_WRITE);
+    if (!_recordFile)
+    {
+        log_e("Could not open %s for recording", name);
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_RECORDING);
+        return false;
+    }
+    log_i("recording to %s", name);
+    return true;
+}
+
+void ESP32_VS1053_Stream::_writeRecording(const bool flush)
+{
+    while (true)
+    {
+        if (_recordSplitQueued && _recordBuffer.totalRead() == _recordSplitAt)
+        {
+            _openRecordFile();
+            _recordSplitQueued = false;
+        }
+
+        const size_t used = _recordBuffer.used();
+        if (!used || (used < VS1053_RECORD_WRITE_SIZE && !flush && !_recordSplitQueued))
+            return;
+
+        size_t size = 0;
+        const uint8_t *data = _recordBuffer.acquireRead(size);
+        size = min(size, (size_t)VS1053_RECORD_WRITE_SIZE);
+        if (_recordSplitQueued)
+            size = min(size, _recordSplitAt - _recordBuffer.totalRead());
+
+        if (_recordFile && _recordFile.write(data, size) != size)
+        {
+            log_e("Recording write failed");
+            _recordFile.close();
+            if (_errorCallback)
+                _emitText(EVENT_ERROR, ERROR_RECORDING);
+        }
+        _recordBuffer.commitRead(size);
+    }
+}
+
+void ESP32_VS1053_Stream::_recordTaskLoop(void *arg)
+{
+    ESP32_VS1053_Stream *self = static_cast<ESP32_VS1053_Stream *>(arg);
+
+    while (!self->_recordTaskStop)
+    {
+        self->_writeRecording(false);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    self->_writeRecording(true);
+
+    self->_recordTaskRunning = false;
+    vTaskDelete(nullptr);
+}
+
+void ESP32_VS1053_Stream::loop()
+{
+    const unsigned long startUs = micros();
+    _loop();
+    const uint32_t elapsedUs = micros() - startUs;
+
+    _storeMax(_stats.loopMaxUs, elapsedUs);
+    _stats.loopTotalUs += elapsedUs;
+    _stats.loopCount++;
+
+    if (millis() - _statsRateMS >= 1000)
+        _updateStatsRates();
+}
+
+void ESP32_VS1053_Stream::_loop()
+{
+    if (_finishedUrl)
+    {
+        char *url = nullptr;
+        bool wanted = false;
+        {
+            Lock lock(_decoderMutex);
+            url = _finishedUrl;
+            _finishedUrl = nullptr;
+            wanted = bool(_eofCallback);
+        }
+        if (wanted && url)
+            _emitText(EVENT_EOF, url);
+        free(url);
+    }
+
+    if (_idleHttp && millis() - _idleSinceMS > VS1053_KEEPALIVE_TIMEOUT_MS)
+    {
+        Lock lock(_sourceMutex);
+        _dropIdleHttp();
+    }
+
+    if (!isRunning())
+        return;
+
+    bool positionDue = false;
+    if (millis() - _positionTimer >= _positionIntervalMs)
+    {
+        Lock lock(_decoderMutex);
+        positionDue = bool(_positionCallback);
+    }
+
+    if (positionDue)
+    {
+        _positionTimer = millis();
+        const uint32_t duration = durationMs();
+        uint32_t ms = 0;
+        size_t bytes = 0;
+        {
+            Lock lock(_decoderMutex);
+            ms = _playTimeMs();
+            bytes = _bytesPlayed;
+        }
+        _emitPosition(ms, duration, bytes);
+    }
+
+    if (_ringbuffer.allocated())
+    {
+        if (!_bufferTaskRunning)
+        {
+            Lock lock(_sourceMutex);
+            _fillRingBuffer();
+        }
+
+        bool ended;
+        {
+            // a running feeder task counts _remainingBytes down under the decoder lock
+            Lock lock(_decoderMutex);
+            if (!_feederTaskRunning && _remainingBytes)
+                _playFromRingBuffer();
+            ended = !_remainingBytes;
+        }
+
+        if (ended)
+        {
+            // the feeder task may have handed over to the next item in the meantime
+            Lock sourceLock(_sourceMutex);
+            Lock decoderLock(_decoderMutex);
+            if (!_remainingBytes && isRunning())
+                _eofStream();
+        }
+        return;
+    }
+
+    if (_playingFile)
+    {
+        _handleLocalFile();
+        return;
+    }
+
+    WiFiClient *stream = _http->getStreamPtr();
+    if (!stream)
+    {
+        log_v("Stream connection lost");
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_CONNECTION_LOST);
+        _eofStream();
+        return;
+    }
+
+    const bool data = stream->available();
+    const auto now = millis();
+    const auto currentStallTimeMS = now - _streamStallStartMS;
+
+    if (!data && _streamStallStartMS && currentStallTimeMS > VS1053_STREAM_TIMEOUT_MS)
+    {
+        log_v("Stream timeout %lu ms", (unsigned long)VS1053_STREAM_TIMEOUT_MS);
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_STREAM_TIMEOUT);
+        _eofStream();
+        return;
+    }
+
+    if (!data && !_streamStallStartMS)
+    {
+        _streamStallStartMS = now ?: 1;
+        return;
+    }
+
+    if (data && _streamStallStartMS)
+    {
+        log_w("Stream stalled for %lu ms", currentStallTimeMS);
+        _streamStallStartMS = 0;
+        if (currentStallTimeMS > VS1053_STREAM_STALL_MS)
+            _stats.streamStalls++;
+    }
+
+    if (data)
+        _feedDecoder(stream);
+}
+
+bool ESP32_VS1053_Stream::isRunning()
+{
+    return _http != nullptr || _hls || _playingFile || _draining || _reconnecting;
+}
+
+void ESP32_VS1053_Stream::stopSong()
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    if (!isRunning())
+        return;
+
+    _learnStation();
+    _vs1053->setVolume(0);
+
+    _sourceState = SOURCE_ACTIVE;
+    _remainingBytes = 0;
+    _offset = 0;
+    _bitrate = 0;
+    _bitrateTimer = 0;
+    _codec = CODEC_UNKNOWN;
+    _reportedCodec = CODEC_UNKNOWN;
+    _decoderSyncAttempts = 0;
+    _icyBitrate = 0;
+    _measuredBitrate = 0;
+    _jitterMs = 0;
+    _lastArrivalMS = 0;
+    _trackSize = 0;
+    _trackEnd = 0;
+    _sourceRemaining = 0;
+    _station = -1;
+    _stationBitrate = 0;
+    _fileSystem = nullptr;
+    _bytesPlayed = 0;
+    _startMs = 0;
+    _handoverPending = false;
+    free(_next.url);
+    _next = {};
+    _setCredentials(nullptr, nullptr);
+    _paused = false;
+    _clearSpill();
+
+    if (_ringbuffer.allocated())
+    {
+        _ringbuffer.clear();
+        _ringbuffer_filled = false;
+        _bufferStallStartMS = 0;
+        _prebufferProgressMS = 0;
+        _rateWindowStartMS = 0;
+        _underrunStartMS = 0;
+    }
+
+    _closeSource();
+    _draining = false;
+    _resetFraming();
+    _dataSeen = false;
+    _releaseWorkBuffer();
+}
+
+uint8_t ESP32_VS1053_Stream::getVolume()
+{
+    return _volume;
+}
+
+void ESP32_VS1053_Stream::setVolume(const uint8_t newVolume)
+{
+    Lock lock(_decoderMutex);
+    _volume = min(VS1053_MAXVOLUME, newVolume);
+    if (_vs1053 && isRunning())
+        _vs1053->setVolume(_volume);
+}
+
+void ESP32_VS1053_Stream::setTone(uint8_t *rtone)
+{
+    Lock lock(_decoderMutex);
+    if (_vs1053)
+        _vs1053->setTone(rtone);
+}
+
+const char *ESP32_VS1053_Stream::lastUrl()
+{
+    // kept for existing sketches, a copy that the tasks can not free from under the caller
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+    const size_t len = lastUrl(nullptr, 0) + 1;
+    char *copy = static_cast<char *>(realloc(_lastUrlCopy, len));
+    if (!copy)
+        return "";
+
+    _lastUrlCopy = copy;
+    lastUrl(_lastUrlCopy, len);
+    return _lastUrlCopy;
+}
+
+size_t ESP32_VS1053_Stream::lastUrl(char *buffer, const size_t len)
+{
+    // the tasks replace _url on a redirect or a handover, so it is copied out under the locks
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+    const char *url = (_http || _hls || _playingFile || _reconnecting) ? _url : "";
+    if (buffer && len)
+        snprintf(buffer, len, "%s", url);
+    return strlen(url);
+}
+
+size_t ESP32_VS1053_Stream::size()
+{
+    return isRunning() ? _trackSize : 0;
+}
+
+size_t ESP32_VS1053_Stream::position()
+{
+    return size() ? (_trackEnd - _remainingBytes) : 0;
+}
+
+uint32_t ESP32_VS1053_Stream::durationMs()
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    if (!size())
+        return 0;
+
+    // local files are indexed on demand, http files once they have been seeked
+    if ((_fileSystem && _seekOffset(_url, _fileSystem, 0, nullptr)) ||
+        (_seekIndexUrl && !strcmp(_seekIndexUrl, _url)))
+        return _seekIndex.durationMs();
+
+    const uint32_t kbps = _bitrate ? _bitrate : _measuredBitrate;
+    return kbps ? (uint64_t)_trackEnd * 8 / kbps : 0;
+}
+
+uint32_t ESP32_VS1053_Stream::positionMs()
+{
+    Lock lock(_decoderMutex);
+    return isRunning() ? _playTimeMs() : 0;
+}
+
+size_t ESP32_VS1053_Stream::bytesPlayed()
+{
+    return isRunning() ? _bytesPlayed : 0;
+}
+
+void ESP32_VS1053_Stream::bufferStatus(size_t &used, size_t &capacity)
+{
+    used = _ringbuffer.used();
+    capacity = _ringbuffer.capacity();
+}
+
+bool ESP32_VS1053_Stream::_acquireWorkBuffer()
+{
+    if (_workBuffer)
+        return true;
+
+    _workBuffer = _arena ? _arena->acquire() : static_cast<uint8_t *>(malloc(VS1053_WORK_BUFFER_SIZE));
+    if (!_workBuffer)
+    {
+        log_e("Could not get a %zu byte work buffer%s", (size_t)VS1053_WORK_BUFFER_SIZE, _arena ? " from the arena" : "");
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_SYSTEM_ERROR);
+        return false;
+    }
+
+    _localbuffer = _workBuffer;
+    _vs1053Buffer = _workBuffer + VS1053_LOCALBUFFER_SIZE;
+    return true;
+}
+
+void ESP32_VS1053_Stream::_releaseWorkBuffer()
+{
+    if (!_workBuffer || isRunning())
+        return;
+
+    if (_arena)
+        _arena->release(_workBuffer);
+    else
+        free(_workBuffer);
+
+    _workBuffer = nullptr;
+    _localbuffer = nullptr;
+    _vs1053Buffer = nullptr;
+}
+
+bool ESP32_VS1053_Stream::setWorkArena(VS1053_Arena *arena)
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    if (isRunning())
+        return false;
+
+    if (arena && arena->blockSize() < VS1053_WORK_BUFFER_SIZE)
+    {
+        log_e("Arena blocks must hold VS1053_WORK_BUFFER_SIZE bytes");
+        return false;
+    }
+
+    _releaseWorkBuffer();
+    _arena = arena;
+    return true;
+}
+
+bool ESP32_VS1053_Stream::_setUrl(const char *url)
+{
+    if (_url && !strcmp(_url, url))
+        return true;
+
+    char *copy = strdup(url);
+    if (!copy)
+    {
+        log_e("Could not store url");
+        return false;
+    }
+
+    free(_url);
+    _url = copy;
+    return true;
+}
+
+VS1053_MemoryUsage ESP32_VS1053_Stream::getMemoryUsage()
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    const auto text = [](const char *str) -> size_t { return str ? strlen(str) + 1 : 0; };
+
+    size_t heap = text(_url) + text(_next.url) + text(_finishedUrl) + text(_seekIndexUrl) +
+                  text(_seekIndexFailedUrl) + text(_username) + text(_pwd) + text(_sourceTag) + text(_recordName);
+
+    for (size_t i = 0; i < VS1053_QUEUE_SIZE; i++)
+        heap += text(_queue[i].url);
+    for (size_t i = 0; i < VS1053_STATION_CACHE_SIZE; i++)
+        heap += text(_stations[i].url) + text(_stations[i].resolved);
+#if VS1053_HLS_ENABLED
+    heap += text(_hlsPlaylistUrl) + text(_hlsSegmentUrl);
+    for (size_t i = 0; i < VS1053_HLS_MAX_SEGMENTS; i++)
+        heap += text(_hlsSegments[i]);
+#endif
+
+    heap += _http ? sizeof(HTTPClient) : 0;
+    heap += _idleHttp ? sizeof(HTTPClient) : 0;
+    heap += _vs1053 ? sizeof(VS1053) : 0;
+    if (_events)
+        heap += (uxQueueMessagesWaiting(_events) + uxQueueSpacesAvailable(_events)) * sizeof(Event);
+
+    VS1053_MemoryUsage usage;
+    usage.object = sizeof(*this);
+    usage.workBuffer = _workBuffer ? VS1053_WORK_BUFFER_SIZE : 0;
+    usage.ringbuffer = _ringbuffer.capacity() + _recordBuffer.capacity();
+    usage.heap = heap;
+    usage.total = usage.object + usage.workBuffer + usage.ringbuffer + usage.heap;
+    return usage;
+}
+
+VS1053_Stats ESP32_VS1053_Stream::getStats()
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    VS1053_Stats stats = {};
+    stats.bytesReceived = _stats.bytesReceived;
+    stats.bytesDecoded = _stats.bytesDecoded;
+    stats.underruns = _stats.underruns;
+    stats.underrunMs = _stats.underrunMs;
+    stats.streamStalls = _stats.streamStalls;
+    stats.bufferHighWater = _stats.bufferHighWater;
+    stats.bufferLowWater = _stats.bufferLowWater;
+    if (stats.bufferLowWater == SIZE_MAX)
+        stats.bufferLowWater = 0;
+    stats.loopMaxUs = _stats.loopMaxUs;
+    const uint32_t loops = _stats.loopCount;
+    stats.loopAvgUs = loops ? _stats.loopTotalUs / loops : 0;
+    stats.decoderSyncAttempts = _stats.decoderSyncAttempts;
+    stats.reconnects = _stats.reconnects;
+    stats.eventsDropped = _stats.eventsDropped;
+    stats.inputBytesPerSecond = _stats.inputBytesPerSecond;
+    stats.outputBytesPerSecond = _stats.outputBytesPerSecond;
+    return stats;
+}
+
+void ESP32_VS1053_Stream::resetStats()
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    _stats.bytesReceived = 0;
+    _stats.bytesDecoded = 0;
+    _stats.underruns = 0;
+    _stats.underrunMs = 0;
+    _stats.streamStalls = 0;
+    _stats.bufferHighWater = 0;
+    _stats.bufferLowWater = SIZE_MAX;
+    _stats.loopMaxUs = 0;
+    _stats.decoderSyncAttempts = 0;
+    _stats.reconnects = 0;
+    _stats.eventsDropped = 0;
+    _stats.inputBytesPerSecond = 0;
+    _stats.outputBytesPerSecond = 0;
+    _stats.loopTotalUs = 0;
+    _stats.loopCount = 0;
+    _statsRateMS = millis();
+    _statsRateReceived = 0;
+    _statsRateDecoded = 0;
+}
+
+void ESP32_VS1053_Stream::_updateStatsRates()
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    const unsigned long elapsed = millis() - _statsRateMS;
+    if (!elapsed)
+        return;
+
+    const uint64_t received = _stats.bytesReceived;
+    const uint64_t decoded = _stats.bytesDecoded;
+    _stats.inputBytesPerSecond = (received - _statsRateReceived) * 1000 / elapsed;
+    _stats.outputBytesPerSecond = (decoded - _statsRateDecoded) * 1000 / elapsed;
+    _statsRateReceived = received;
+    _statsRateDecoded = decoded;
+    _statsRateMS = millis();
+}
+
+bool ESP32_VS1053_Stream::setBufferSize(const size_t bytes, const VS1053_BufferMemory memory)
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    if (!_vs1053 || isRunning())
+    {
+        log_e("need to stop playback first");
+        return false;
+    }
+
+    _deallocateRingbuffer();
+    return _allocateRingbuffer(bytes, memory);
+}
+
+bool ESP32_VS1053_Stream::setBufferTime(const uint32_t ms, const uint16_t kbps, const VS1053_BufferMemory memory)
+{
+    return setBufferSize((uint64_t)ms * kbps / 8, memory); // kbps * ms / 8 = bytes
+}
+
+bool ESP32_VS1053_Stream::connectToFile(fs::FS &fs, const char *filename)
+{
+    return connectToFile(fs, filename, 0);
+}
+
+bool ESP32_VS1053_Stream::connectToFile(fs::FS &fs, const char *filename, const size_t offset)
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    if (!_vs1053 || _playingFile || _http || _hls)
+        return false;
+
+    if (!_openFile(fs, filename, offset))
+    {
+        _releaseWorkBuffer();
+        return false;
+    }
+    return true;
+}
+
+bool ESP32_VS1053_Stream::seekMs(const uint32_t ms)
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    if (!isRunning() || _hls || !_trackSize)
+    {
+        log_w("not seekable");
+        return false;
+    }
+
+    // the queue item that follows is already in the buffer
+    if (_handoverPending)
+    {
+        log_w("next item already buffered");
+        return false;
+    }
 
-        _resolveRedirect(_http->header(LOCATION).c_str(), url, location);
+    char *url = strdup(_url);
+    fs::FS *fileSystem = _fileSystem;
+    const int8_t station = _station;
 
-        stopSong();
-        log_i("%i redirection to: %s", HTTPresult, location);
-        return connectToHost(location, username, pwd, 0);
+    size_t offset = 0;
+    if (!url || !_seekOffset(url, fileSystem, ms, &offset))
+    {
+        free(url);
+        return false;
     }
 
-    default:
-        if (_errorCallback)
-        {
-            char *buff = reinterpret_cast<char *>(_localbuffer);
-            if (HTTPresult < 0)
-                snprintf(buff, sizeof(_localbuffer), "Http error: %s", _http->errorToString(HTTPresult).c_str());
-            else
-                snprintf(buff, sizeof(_localbuffer), "Server error: %i", HTTPresult);
+    // stopSong() forgets the credentials
+    char *username = _username;
+    char *pwd = _pwd;
+    _username = nullptr;
+    _pwd = nullptr;
 
-            _errorCallback(buff);
-        }
+    log_d("seeking to %lu ms at byte %zu", (unsigned long)ms, offset);
+    stopSong();
 
-        stopSong();
-        _redirectCount = 0;
-        return false;
+    const bool resumed = fileSystem ? _openFile(*fileSystem, url, offset)
+                                    : _openHost(url, username ? username : "", pwd ? pwd : "", offset);
+    if (resumed)
+    {
+        _startMs = ms;
+        _setCredentials(username, pwd);
+    }
+    else
+        _releaseWorkBuffer();
+    free(username);
+    free(pwd);
+
+    if (resumed && station != -1 && _stations[station].url)
+    {
+        _station = station;
+        _stationBitrate = _stations[station].bitrate;
     }
+
+    free(url);
+    return resumed;
 }
 
-void ESP32_VS1053_Stream::_playFromRingBuffer()
+bool ESP32_VS1053_Stream::pause()
 {
-    if (!_ringbuffer_filled)
-    {
-        const size_t filled = min(1024 * 15, VS1053_PSRAM_BUFFER_SIZE);
-        const size_t required = min(size() ? size() : filled, filled);
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
 
-        if (VS1053_PSRAM_BUFFER_SIZE - xRingbufferGetCurFreeSize(_ringbuffer_handle) < required)
-            return;
+    // only a buffer can keep receiving while the decoder waits
+    if (!isRunning() || !_ringbuffer.allocated())
+        return false;
 
-        _ringbuffer_filled = true;
-        _bitrateTimer = millis();
-    }
+    _pausedAtMs = _playTimeMs();
+    _paused = true;
+    return true;
+}
 
-    _updateBitRate();
+bool ESP32_VS1053_Stream::resume()
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
 
-    [[maybe_unused]] const auto startTimeMS = millis();
-    size_t bytesToDecoder = 0;
+    if (!_paused)
+        return false;
 
-    const size_t MAX_MOVE = size() ? 2048 : 512; // everything without a size is radio so low bitrate
+    _shiftPlayTime(0); // the decoder clock starts over from the paused play time
+    _paused = false;
+    _rateWindowStartMS = 0; // the pause is not a drop in bitrate
+    return true;
+}
 
-    while (_remainingBytes && bytesToDecoder < MAX_MOVE && _vs1053->data_request())
-    {
-        size_t size = 0;
-        const size_t avail = min(VS1053_PLAYBUFFER_SIZE, (size_t)_remainingBytes);
-        uint8_t *data = (uint8_t *)xRingbufferReceiveUpTo(_ringbuffer_handle, &size, pdMS_TO_TICKS(0), avail);
-        if (!data)
-        {
-            if (_bufferStallStartMS && (millis() - _bufferStallStartMS) > VS1053_PSRAM_BUFFER_TIMEOUT_MS)
-            {
-                log_v("ringbuffer empty for %i ms, bailing out", VS1053_PSRAM_BUFFER_TIMEOUT_MS);
-                if (_errorCallback && _codec != CODEC_UNKNOWN)
-                    _errorCallback(ERROR_RINGBUFFER_EMPTY);
-                _bufferStallStartMS = 0;
-                _remainingBytes = 0;
-                return;
-            }
+bool ESP32_VS1053_Stream::isPaused()
+{
+    return _paused;
+}
 
-            if (!_bufferStallStartMS)
-            {
-                _bufferStallStartMS = millis() ?: 1;
-                log_w("no ringbuffer data available");
-            }
-            return;
-        }
+bool ESP32_VS1053_Stream::skipBack(const uint32_t ms)
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
 
-        if (_bufferStallStartMS)
-        {
-            log_v("ringbuffer was empty for %i ms", millis() - _bufferStallStartMS);
-            _bufferStallStartMS = 0;
-        }
+    if (!isRunning() || !_ringbuffer.allocated())
+        return false;
 
-        _vs1053->playChunk(data, size);
-        vRingbufferReturnItem(_ringbuffer_handle, data);
-        bytesToDecoder += size;
-        _remainingBytes -= (_remainingBytes > 0) ? size : 0;
-    }
-    log_d("%lu ms moving %i bytes ringbuffer->decoder", millis() - startTimeMS, bytesToDecoder);
+    const uint32_t kbps = _streamKbps();
+    const size_t wanted = (uint64_t)kbps * ms / 8;
+    const size_t bytes = _ringbuffer.rewind(min(wanted, _rewindable()));
+    if (!bytes)
+        return false;
+
+    _bytesPlayed -= bytes;
+    if (_remainingBytes != -1)
+        _remainingBytes += bytes;
+    _shiftPlayTime(-(int32_t)((uint64_t)bytes * 8 / kbps));
+
+    log_d("skipped back %zu bytes", bytes);
+    return true;
 }
 
-void ESP32_VS1053_Stream::_streamToRingBuffer(WiFiClient *stream)
+bool ESP32_VS1053_Stream::jumpToLive()
 {
-    size_t bytesToRingBuffer = 0;
-    [[maybe_unused]] const auto startTimeMS = millis();
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
 
-    const size_t MAX_MOVE = size() ? 2048 : 512; // everything without a size is radio so low bitrate
+    // only an endless stream has a live edge
+    if (!isRunning() || !_ringbuffer.allocated() || _remainingBytes != -1 || _handoverPending)
+        return false;
+
+    // the newest audio is at the end of the spill file, simply wait for new audio then
+    const size_t spilled = _spillWritePos - _spillReadPos;
+    const size_t keep = spilled ? 0 : _prebufferBytes();
+    const size_t used = _ringbuffer.used();
+    size_t skip = used > keep ? used - keep : 0;
+    const size_t skipped = skip + spilled;
 
-    if (_musicDataPosition < _metaDataStart &&
-        xRingbufferGetCurFreeSize(_ringbuffer_handle) && stream->available())
+    while (skip)
     {
-        const size_t inStream = _metaDataStart ? _metaDataStart - _musicDataPosition : stream->available();
-        const size_t toMove = min(inStream, xRingbufferGetCurFreeSize(_ringbuffer_handle));
-        const size_t toRead = min(MAX_MOVE, toMove);
-        const size_t inBuffer = stream->read(_localbuffer, toRead);
+        size_t size = 0;
+        if (!_ringbuffer.acquireRead(size))
+            break;
+        size = min(size, skip);
+        _ringbuffer.commitRead(size);
+        skip -= size;
+    }
+    _clearSpill();
 
-        const BaseType_t result = xRingbufferSend(_ringbuffer_handle, _localbuffer, inBuffer, 0);
-        if (result == pdFALSE)
-        {
-            log_v("ringbuffer failed to receive %i bytes. Closing stream.", inBuffer);
-            if (_errorCallback)
-                _errorCallback(ERROR_RINGBUFFER_FAIL);
-            _remainingBytes = 0;
-            return;
-        }
+    if (spilled)
+        _ringbuffer_filled = false;
+    _shiftPlayTime((uint64_t)skipped * 8 / _streamKbps());
+    _paused = false;
+    _rateWindowStartMS = 0;
 
-        bytesToRingBuffer += inBuffer;
-        _musicDataPosition += _metaDataStart ? inBuffer : 0;
-    }
-    log_d("%lu ms moving %i bytes stream->ringbuffer", millis() - startTimeMS, bytesToRingBuffer);
+    log_d("skipped %zu bytes to live", skipped);
+    return true;
 }
 
-void ESP32_VS1053_Stream::_setupStream()
+uint32_t ESP32_VS1053_Stream::timeshiftMs()
 {
-    if (!_offset)
-        _vs1053->stopSong();
-    _bitrateTimer = millis();
-    _dataSeen = true;
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    if (!isRunning())
+        return 0;
+
+    const size_t behind = _ringbuffer.used() + _spillWritePos - _spillReadPos;
+    return (uint64_t)behind * 8 / _streamKbps();
 }
 
-void ESP32_VS1053_Stream::_handleStream(WiFiClient *stream)
+void ESP32_VS1053_Stream::setRewindTime(const uint32_t ms)
 {
-    if (!_dataSeen)
-        _setupStream();
+    Lock sourceLock(_sourceMutex);
+    _rewindMs = ms;
+}
 
-    if (_ringbuffer_handle)
+bool ESP32_VS1053_Stream::setTimeshiftFile(fs::FS &fs, const char *filename)
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    if (_spillReadPos != _spillWritePos)
     {
-        _streamToRingBuffer(stream);
-        _playFromRingBuffer();
+        log_w("time-shift file in use");
+        return false;
     }
-    else
-    {
-        _updateBitRate();
 
-        [[maybe_unused]] const auto startTimeMS = millis();
-        size_t bytesToDecoder = 0;
+    _spillFile.close();
+    _spillFile = fs.open(filename, "w+");
+    if (!_spillFile)
+    {
+        log_e("Could not open %s for time-shift", filename);
+        return false;
+    }
+    _clearSpill();
+    return true;
+}
 
-        const size_t MAX_MOVE = size() ? 2048 : 512; // everything without a size is radio so low bitrate
+void ESP32_VS1053_Stream::clearTimeshiftFile()
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
 
-        while (_musicDataPosition < _metaDataStart && bytesToDecoder < MAX_MOVE &&
-               stream->available() && _vs1053->data_request())
-        {
-            const size_t inStream = _metaDataStart ? _metaDataStart - _musicDataPosition : stream->available();
-            const size_t toRead = min(inStream, VS1053_PLAYBUFFER_SIZE);
-            const size_t inBuffer = stream->read(_vs1053Buffer, toRead);
-            _vs1053->playChunk(_vs1053Buffer, inBuffer);
-            _remainingBytes -= _remainingBytes > 0 ? inBuffer : 0;
-            _musicDataPosition += _metaDataStart ? inBuffer : 0;
-            bytesToDecoder += inBuffer;
-        }
-        log_d("%lu ms moving %i bytes stream->decoder", millis() - startTimeMS, bytesToDecoder);
-    }
+    _spillFile.close();
+    _clearSpill();
+}
 
-    if (_metaDataStart && _musicDataPosition == _metaDataStart && stream->available())
-    {
-        const auto metaLen = stream->read() * 16;
-        if (metaLen)
-        {
-            stream->readBytes(_localbuffer, metaLen);
+size_t ESP32_VS1053_Stream::_keepFree()
+{
+    if (!_rewindMs && !_spillFile)
+        return 0;
 
-            if (_infoCallback)
-                _handleMetadata(reinterpret_cast<char *>(_localbuffer), metaLen);
-        }
+    // a source read can use up to VS1053_LOCALBUFFER_SIZE bytes after the write position as scratch
+    const size_t rewind = (uint64_t)_streamKbps() * _rewindMs / 8;
+    return min(rewind + VS1053_LOCALBUFFER_SIZE, _ringbuffer.capacity() / 2);
+}
 
-        _musicDataPosition = 0;
-    }
+size_t ESP32_VS1053_Stream::_rewindable()
+{
+    const size_t free = _ringbuffer.free();
+    const size_t history = free > VS1053_LOCALBUFFER_SIZE ? free - VS1053_LOCALBUFFER_SIZE : 0;
+    return min(history, _bytesPlayed);
 }
 
-void ESP32_VS1053_Stream::_chunkedStreamToRingBuffer(WiFiClient *stream)
+uint8_t *ESP32_VS1053_Stream::_acquireSource(size_t &space)
 {
-    [[maybe_unused]] const auto startTimeMS = millis();
-    size_t bytesToRingBuffer = 0;
+    uint8_t *dest = _ringbuffer.acquireWrite(space);
+    if (!dest)
+        return nullptr;
 
-    const size_t MAX_MOVE = size() ? 2048 : 512; // everything without a size is radio so low bitrate
+    const size_t free = _ringbuffer.free();
+    const size_t keep = _keepFree();
+    const bool spilling = _spillReadPos != _spillWritePos;
 
-    if (_bytesLeftInChunk && _musicDataPosition < _metaDataStart &&
-        xRingbufferGetCurFreeSize(_ringbuffer_handle) && stream->available())
+    if (!spilling && free > keep)
     {
-        const size_t inStream = _metaDataStart ? _metaDataStart - _musicDataPosition : stream->available();
-        const size_t inChunk = min(_bytesLeftInChunk, inStream);
-        const size_t toMove = min(inChunk, MAX_MOVE);
-        const size_t toRead = min(toMove, xRingbufferGetCurFreeSize(_ringbuffer_handle));
-        const size_t inBuffer = stream->read(_localbuffer, toRead);
-        const BaseType_t result = xRingbufferSend(_ringbuffer_handle, _localbuffer, inBuffer, 0);
-        if (result == pdFALSE)
-        {
-            log_v("ringbuffer failed to receive %i bytes. Closing stream.", inBuffer);
-            if (_errorCallback)
-                _errorCallback(ERROR_RINGBUFFER_FAIL);
-            _remainingBytes = 0;
-            return;
-        }
+        _sourceToSpill = false;
+        space = min(space, free - keep);
+        return dest;
+    }
 
-        _bytesLeftInChunk -= inBuffer;
-        bytesToRingBuffer += inBuffer;
-        _musicDataPosition += _metaDataStart ? inBuffer : 0;
+    if (!_spillFile || _spillWritePos >= VS1053_TIMESHIFT_FILE_SIZE)
+    {
+        _lastArrivalMS = 0; // a full buffer is not a network gap
+        return nullptr;
     }
-    log_d("%lu ms moving %i bytes chunked->ringbuffer", millis() - startTimeMS, bytesToRingBuffer);
+
+    // new audio goes behind what is in the spill file, the free space is only read into
+    _sourceToSpill = true;
+    space = min(space, VS1053_LOCALBUFFER_SIZE);
+    return dest;
 }
 
-void ESP32_VS1053_Stream::_handleChunkedStream(WiFiClient *stream)
+void ESP32_VS1053_Stream::_commitSource(uint8_t *data, const size_t len)
 {
-    if (!_bytesLeftInChunk)
-    {
-        if (!stream->available())
-            return;
+    _record(data, len);
+    if (_sourceToSpill)
+        _spillWrite(data, len);
+    else
+        _ringbuffer.commitWrite(len);
+}
 
-        _bytesLeftInChunk = _nextChunkSize(stream);
-        if (!_bytesLeftInChunk)
-        {
-            _remainingBytes = 0;
-            return;
-        }
-        if (!_dataSeen)
-            _setupStream();
-    }
+bool ESP32_VS1053_Stream::_spillWrite(const uint8_t *data, const size_t len)
+{
+    if (!len)
+        return true;
 
-    if (_ringbuffer_handle)
+    if (!_spillFile.seek(_spillWritePos) || _spillFile.write(data, len) != len)
     {
-        _chunkedStreamToRingBuffer(stream);
-        _playFromRingBuffer();
+        log_e("time-shift file write failed");
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_FILE_IO);
+        _spillFile.close();
+        _clearSpill();
+        return false;
     }
-    else
-    {
-        _updateBitRate();
+    _spillWritePos += len;
+    return true;
+}
 
-        [[maybe_unused]] const auto startTimeMS = millis();
-        size_t bytesToDecoder = 0;
+size_t ESP32_VS1053_Stream::_spillToRingBuffer()
+{
+    const size_t free = _ringbuffer.free();
+    const size_t keep = _keepFree();
+    if (free <= keep)
+        return 0;
+
+    size_t space = 0;
+    uint8_t *dest = _ringbuffer.acquireWrite(space);
+    const size_t toRead = min(min(space, free - keep), min(_spillWritePos - _spillReadPos, VS1053_LOCALBUFFER_SIZE));
+    const size_t bytes = _spillFile.seek(_spillReadPos) ? _spillFile.read(dest, toRead) : 0;
+    if (!bytes)
+    {
+        log_e("time-shift file read failed");
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_FILE_IO);
+        _spillFile.close();
+        _clearSpill();
+        return 0;
+    }
 
-        const size_t MAX_MOVE = size() ? 2048 : 512; // everything without a size is radio so low bitrate
+    _ringbuffer.commitWrite(bytes);
+    _spillReadPos += bytes;
 
-        while (_bytesLeftInChunk && _musicDataPosition < _metaDataStart && bytesToDecoder < MAX_MOVE &&
-               stream->available() && _vs1053->data_request())
-        {
-            const size_t inStream = _metaDataStart ? _metaDataStart - _musicDataPosition : stream->available();
-            const size_t inChunk = min(_bytesLeftInChunk, inStream);
-            const size_t toRead = min(inChunk, VS1053_PLAYBUFFER_SIZE);
-            const size_t inBuffer = stream->read(_vs1053Buffer, toRead);
-            _vs1053->playChunk(_vs1053Buffer, inBuffer);
-            _bytesLeftInChunk -= inBuffer;
-            _musicDataPosition += _metaDataStart ? inBuffer : 0;
-            bytesToDecoder += inBuffer;
-        }
-        log_d("%lu ms moving %i bytes chunked->decoder", millis() - startTimeMS, bytesToDecoder);
-    }
+    // start at the front of the file again once it is played
+    if (_spillReadPos == _spillWritePos)
+        _clearSpill();
+    return bytes;
+}
 
-    if (_metaDataStart && _musicDataPosition == _metaDataStart && _bytesLeftInChunk && stream->available())
-    {
-        const auto metaLen = stream->read() * 16;
-        _bytesLeftInChunk--;
+void ESP32_VS1053_Stream::_clearSpill()
+{
+    _spillReadPos = 0;
+    _spillWritePos = 0;
+    _sourceToSpill = false;
+}
 
-        if (metaLen)
-        {
-            size_t cnt = 0;
+void ESP32_VS1053_Stream::_shiftPlayTime(const int32_t ms)
+{
+    const int64_t position = (int64_t)_playTimeMs() + ms;
+    _vs1053->clearDecodedTime();
+    _decodeSeconds = 0;
+    _decodeTickMS = 0;
+    _startMs = position > 0 ? position : 0;
+    _pausedAtMs = _startMs;
+}
 
-            while (cnt < metaLen)
-            {
-                if (!_bytesLeftInChunk)
-                {
-                    if (!_checkSync(stream))
-                    {
-                        _remainingBytes = 0;
-                        return;
-                    }
-
-                    _bytesLeftInChunk = _nextChunkSize(stream);
-                    if (!_bytesLeftInChunk)
-                    {
-                        _remainingBytes = 0;
-                        return;
-                    }
-                }
-
-                _localbuffer[cnt++] = stream->read();
-                _bytesLeftInChunk--;
-            }
+bool ESP32_VS1053_Stream::_seekOffset(const char *url, fs::FS *fileSystem, const uint32_t ms, size_t *offset)
+{
+    const bool cached = _seekIndexUrl && !strcmp(_seekIndexUrl, url);
+    if (cached && !offset)
+        return true;
 
-            if (_infoCallback)
-                _handleMetadata(reinterpret_cast<char *>(_localbuffer), metaLen);
-        }
+    // ogg, m4a and wma have no frames to index, do not read the whole item again on every call
+    if (_seekIndexFailedUrl && !strcmp(_seekIndexFailedUrl, url))
+        return false;
 
-        _musicDataPosition = 0;
+    File file;
+    if (fileSystem)
+    {
+        file = fileSystem->open(url, FILE_READ, false);
+        if (!file)
+            return false;
     }
 
-    if (!_bytesLeftInChunk)
+    // not _localbuffer, an unbuffered file still plays from there
+    uint8_t *scratch = static_cast<uint8_t *>(malloc(VS1053_LOCALBUFFER_SIZE));
+    if (!scratch)
+        return false;
+
+    const VS1053_SeekIndex::reader_t read = [&](size_t position, uint8_t *data, size_t len) -> size_t
     {
-        if (!_checkSync(stream))
-        {
-            _remainingBytes = 0;
-            return;
-        }
+        if (fileSystem)
+            return file.seek(position) ? file.read(data, len) : 0;
+        return _readRange(url, position, data, len);
+    };
 
-        if (!stream->available())
-            return;
+    if (!cached)
+    {
+        free(_seekIndexUrl);
+        _seekIndexUrl = nullptr;
 
-        _bytesLeftInChunk = _nextChunkSize(stream);
-        if (!_bytesLeftInChunk)
+        const size_t fileSize = fileSystem ? file.size() : _trackSize;
+        if (!_seekIndex.build(read, fileSize, scratch, VS1053_LOCALBUFFER_SIZE))
         {
-            _remainingBytes = 0;
-            return;
+            log_w("no seek index for %s", url);
+            free(_seekIndexFailedUrl);
+            _seekIndexFailedUrl = strdup(url);
+            free(scratch);
+            return false;
         }
+        _seekIndexUrl = strdup(url);
     }
-}
 
-void ESP32_VS1053_Stream::_feedDecoder(WiFiClient *stream)
-{
-    if (_chunkedResponse)
-        _handleChunkedStream(stream);
-    else
-        _handleStream(stream);
+    const bool found = !offset || _seekIndex.offsetFor(read, ms, scratch, VS1053_LOCALBUFFER_SIZE, *offset);
+    if (!found)
+        log_w("%lu ms is out of range", (unsigned long)ms);
 
-    if (!_remainingBytes)
-        _eofStream();
+    free(scratch);
+    return found;
 }
 
-void ESP32_VS1053_Stream::loop()
+size_t ESP32_VS1053_Stream::_readRange(const char *url, const size_t offset, uint8_t *data, const size_t len)
 {
-    if (_playingFile)
+    bool reused = false;
+    HTTPClient *http = _takeHttp(url, reused);
+    if (!http)
+        return 0;
+
+    const bool isHttps = !strncasecmp(url, "https://", 8);
+    http->setConnectTimeout(isHttps ? VS1053_CONNECT_TIMEOUT_MS_SSL
+                                    : VS1053_CONNECT_TIMEOUT_MS);
+
+    if (!http->begin(url))
     {
-        _handleLocalFile();
-        return;
+        _releaseHttp(http);
+        return 0;
     }
 
-    if (!_http)
-        return;
+    char range[32];
+    snprintf(range, sizeof(range), "bytes=%zu-%zu", offset, offset + len - 1);
+    http->addHeader("Range", range);
 
-    if (_ringbuffer_handle && !_http->connected())
-    {
-        if (_remainingBytes)
-            _playFromRingBuffer();
+    int result = http->GET();
+    if (result < 0 && reused)
+        result = http->GET();
 
-        if (!_remainingBytes)
-            _eofStream();
-        return;
-    }
+    const int32_t bodySize = http->getSize();
+    WiFiClient *stream = (result == 206) ? http->getStreamPtr() : nullptr;
 
-    WiFiClient *stream = _http->getStreamPtr();
-    if (!stream)
+    size_t received = 0;
+    if (stream && bodySize > 0)
+        received = stream->readBytes(data, min(len, (size_t)bodySize));
+
+    // a completely read range leaves the connection ready for the next one
+    _releaseHttp(http, (stream && received == (size_t)bodySize) ? url : nullptr);
+    return received;
+}
+
+bool ESP32_VS1053_Stream::_openFile(fs::FS &fs, const char *filename, const size_t offset)
+{
+    if (!_acquireWorkBuffer())
+        return false;
+
+    _file = fs.open(filename, FILE_READ, false);
+    if (!_file)
     {
-        log_v("Stream connection lost");
+        log_v("could not open file");
         if (_errorCallback)
-            _errorCallback(ERROR_CONNECTION_LOST);
-        _eofStream();
-        return;
+            _emitText(EVENT_ERROR, ERROR_COULD_NOT_OPEN);
+        return false;
     }
+    _file.setBufferSize(2048);
 
-    const bool data = stream->available();
-    const auto now = millis();
-    const auto currentStallTimeMS = now - _streamStallStartMS;
-
-    if (!data && _streamStallStartMS && !_ringbuffer_handle &&
-        currentStallTimeMS > VS1053_STREAM_TIMEOUT_MS)
+    if (!_isAudioFile(_file))
     {
-        log_v("Stream timeout %lu ms", VS1053_STREAM_TIMEOUT_MS);
         if (_errorCallback)
-            _errorCallback(ERROR_STREAM_TIMEOUT);
-        _eofStream();
-        return;
+            _emitText(EVENT_ERROR, ERROR_NOT_PLAYABLE);
+
+        _file.close();
+        return false;
     }
 
-    if (!data && !_streamStallStartMS)
+    if (offset >= _file.size())
     {
-        _streamStallStartMS = now ?: 1;
-        if (!_ringbuffer_handle)
-            return;
+        _file.close();
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_OUT_OF_RANGE);
+        return false;
     }
 
-    if (data && _streamStallStartMS)
+    const uint8_t codec = _codecFromFilename(filename);
+    const size_t end = (codec == CODEC_WAV) ? _fileLastWAVByte() : _file.size();
+
+    _file.seek(offset);
+    _sourceRemaining = end - offset;
+
+    if (!_preloading && strcmp(filename, _url))
+        _vs1053->stopSong();
+
+    _setTrack(filename, end - offset, 0, _file.size(), end, codec);
+    _playingFile = true;
+
+    if (_preloading)
+        _next.fs = &fs;
+    else
+        _fileSystem = &fs;
+
+    if (_preloading)
+        return true;
+
+    _bufferIndex = 0;
+    _bufferFill = 0;
+    _bitrateTimer = millis();
+
+    return true;
+}
+
+void ESP32_VS1053_Stream::_setTrack(const char *url, const int32_t remaining, const size_t offset,
+                                    const size_t size, const size_t end, const uint8_t codec)
+{
+    // an item is sniffed from its start, a reconnect continues where it was
+    if (!_reconnecting)
+        _sniffer.reset(!offset);
+
+    if (_preloading)
     {
-        if (!_ringbuffer_handle)
-            log_w("Stream stalled for %lu ms", currentStallTimeMS);
-        _streamStallStartMS = 0;
+        free(_next.url);
+        _next = {strdup(url), remaining, offset, size, end, codec, -1, 0, nullptr};
+        return;
     }
 
-    if (data)
-        _feedDecoder(stream);
+    // a reconnect continues the same item
+    if (_reconnecting)
+        return;
 
-    if (!data && _ringbuffer_handle)
-        _playFromRingBuffer();
-}
+    _remainingBytes = remaining;
+    _offset = offset;
+    _trackSize = size;
+    _trackEnd = end;
+    if (strcmp(_url, url))
+        _setUrl(url);
 
-bool ESP32_VS1053_Stream::isRunning()
-{
-    return _http != nullptr || _playingFile;
+    _resetPlayTime(remaining >= 0 ? end - remaining : offset);
 }
 
-void ESP32_VS1053_Stream::stopSong()
+void ESP32_VS1053_Stream::_resetPlayTime(const size_t startByte)
 {
-    if (!_http && !_playingFile)
-        return;
-
-    _vs1053->setVolume(0);
+    _vs1053->clearDecodedTime();
+    _decodeSeconds = 0;
+    _decodeTickMS = 0;
+    _bytesPlayed = 0;
 
-    _remainingBytes = 0;
-    _offset = 0;
-    _bitrate = 0;
-    _bitrateTimer = 0;
-    _codec = CODEC_UNKNOWN;
-    _decoderSyncAttempts = 0;
+    const bool indexed = startByte && _seekIndexUrl && !strcmp(_seekIndexUrl, _url);
+    _startMs = indexed ? _seekIndex.msAt(startByte) : 0;
+}
 
-    if (_ringbuffer_handle)
-    {
-        size_t size;
-        void *item;
-        while ((item = xRingbufferReceive(_ringbuffer_handle, &size, 0)) != nullptr)
-            vRingbufferReturnItem(_ringbuffer_handle, item);
-        _ringbuffer_filled = false;
-        _bufferStallStartMS = 0;
-    }
+uint32_t ESP32_VS1053_Stream::_playTimeMs()
+{
+    // the interpolation below would run on for up to a second after the fifo drained
+    if (_paused)
+        return _pausedAtMs;
 
-    if (_playingFile)
+    const uint16_t seconds = _vs1053->readRegister(SCI_DECODE_TIME);
+    if (seconds != _decodeSeconds)
     {
-        _file.close();
-        _playingFile = false;
-        return;
+        _decodeSeconds = seconds;
+        _decodeTickMS = millis() ?: 1;
     }
 
-    _http->end();
-    delete _http;
-    _http = nullptr;
-    _bytesLeftInChunk = 0;
-    _dataSeen = false;
+    // the decoder clock has a one second resolution, interpolate in between
+    const uint32_t fraction = _decodeTickMS ? min(millis() - _decodeTickMS, 999UL) : 0;
+    return _startMs + _decodeSeconds * 1000 + fraction;
 }
 
-uint8_t ESP32_VS1053_Stream::getVolume()
+uint8_t ESP32_VS1053_Stream::_codecFromContentType()
 {
-    return _volume;
+    const String contentType = _http->header(CONTENT_TYPE);
+    const char *ct = contentType.c_str();
+
+    if (strcasestr(ct, "audio/mpeg") || strcasestr(ct, "audio/mp3"))
+        return CODEC_MP3;
+    if (strcasestr(ct, "aac"))
+        return CODEC_AAC_ADTS;
+    if (strcasestr(ct, "mp4") || strcasestr(ct, "m4a"))
+        return CODEC_AAC_MP4;
+    if (strcasestr(ct, "flac"))
+        return CODEC_FLAC;
+    if (strcasestr(ct, "ogg"))
+        return CODEC_OGG;
+    if (strcasestr(ct, "wav"))
+        return CODEC_WAV;
+    return CODEC_UNKNOWN;
 }
 
-void ESP32_VS1053_Stream::setVolume(const uint8_t newVolume)
+uint8_t ESP32_VS1053_Stream::_codecFromFilename(const char *filename)
 {
-    _volume = min(VS1053_MAXVOLUME, newVolume);
-    if (_vs1053 && isRunning())
-        _vs1053->setVolume(_volume);
+    const char *ext = strrchr(filename, '.');
+    if (!ext)
+        return CODEC_UNKNOWN;
+
+    if (!strcasecmp(ext, ".mp3"))
+        return CODEC_MP3;
+    if (!strcasecmp(ext, ".aac"))
+        return CODEC_AAC_ADTS;
+    if (!strcasecmp(ext, ".m4a") || !strcasecmp(ext, ".mp4"))
+        return CODEC_AAC_MP4;
+    if (!strcasecmp(ext, ".flac"))
+        return CODEC_FLAC;
+    if (!strcasecmp(ext, ".ogg"))
+        return CODEC_OGG;
+    if (!strcasecmp(ext, ".wav"))
+        return CODEC_WAV;
+    if (!strcasecmp(ext, ".wma"))
+        return CODEC_WMA;
+    if (!strcasecmp(ext, ".mid") || !strcasecmp(ext, ".midi"))
+        return CODEC_MIDI;
+    return CODEC_UNKNOWN;
 }
 
-void ESP32_VS1053_Stream::setTone(uint8_t *rtone)
+bool ESP32_VS1053_Stream::enqueue(const char *url)
 {
-    if (_vs1053)
-        _vs1053->setTone(rtone);
+    return _enqueue(url, nullptr);
 }
 
-const char *ESP32_VS1053_Stream::lastUrl()
+bool ESP32_VS1053_Stream::enqueue(fs::FS &fs, const char *filename)
 {
-    return (_http || _playingFile) ? _url : "";
+    return _enqueue(filename, &fs);
 }
 
-size_t ESP32_VS1053_Stream::size()
+bool ESP32_VS1053_Stream::_enqueue(const char *url, fs::FS *fs)
 {
-    if (_playingFile)
-        return _file.size();
-    return _offset + (_http ? _remainingBytes != -1 ? _http->getSize() : 0 : 0);
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    if (!_vs1053 || !url || strlen(url) >= VS1053_MAX_URL_LENGTH)
+        return false;
+
+    if (_queueCount == VS1053_QUEUE_SIZE)
+    {
+        log_w("queue full");
+        return false;
+    }
+
+    char *copy = strdup(url);
+    if (!copy)
+        return false;
+
+    _queue[(_queueHead + _queueCount) % VS1053_QUEUE_SIZE] = {copy, fs};
+    _queueCount++;
+
+    if (!isRunning())
+        _startQueued();
+
+    return true;
 }
 
-size_t ESP32_VS1053_Stream::position()
+bool ESP32_VS1053_Stream::_popQueue(QueueItem &item)
 {
-    if (_playingFile)
-        return _file.position();
-    return size() ? (size() - _remainingBytes) : 0;
+    if (!_queueCount)
+        return false;
+
+    item = _queue[_queueHead];
+    _queue[_queueHead] = {};
+    _queueHead = (_queueHead + 1) % VS1053_QUEUE_SIZE;
+    _queueCount--;
+    return true;
 }
 
-void ESP32_VS1053_Stream::bufferStatus(size_t &used, size_t &capacity)
+void ESP32_VS1053_Stream::clearQueue()
 {
-    used = _ringbuffer_handle ? VS1053_PSRAM_BUFFER_SIZE - xRingbufferGetCurFreeSize(_ringbuffer_handle) : 0;
-    capacity = _ringbuffer_handle ? VS1053_PSRAM_BUFFER_SIZE : 0;
+    Lock sourceLock(_sourceMutex);
+
+    QueueItem item;
+    while (_popQueue(item))
+        free(item.url);
 }
 
-bool ESP32_VS1053_Stream::connectToFile(fs::FS &fs, const char *filename)
+size_t ESP32_VS1053_Stream::queueLength()
 {
-    return connectToFile(fs, filename, 0);
+    return _queueCount;
 }
 
-bool ESP32_VS1053_Stream::connectToFile(fs::FS &fs, const char *filename, const size_t offset)
+void ESP32_VS1053_Stream::_startQueued()
 {
-    if (!_vs1053 || _playingFile || _http)
-        return false;
-
-    _file = fs.open(filename, FILE_READ, false);
-    if (!_file)
+    QueueItem item;
+    while (!isRunning() && _popQueue(item))
     {
-        log_v("could not open file");
-        if (_errorCallback)
-            _errorCallback(ERROR_COULD_NOT_OPEN);
-        return false;
+        if (item.fs)
+            connectToFile(*item.fs, item.url);
+        else
+            connectToHost(item.url);
+        free(item.url);
     }
-    _file.setBufferSize(2048);
+}
 
-    if (!_isAudioFile(_file))
+void ESP32_VS1053_Stream::_preloadNext()
+{
+    _learnStation();
+
+    // the finished source is completely in the ringbuffer
+    _draining = true;
+    _closeSource();
+
+    QueueItem item;
+    while (_popQueue(item))
     {
-        if (_errorCallback)
-            _errorCallback(ERROR_NOT_PLAYABLE);
+        _dataSeen = true; // the decoder is already running
+        _preloading = true;
 
-        _file.close();
-        return false;
+        const bool opened = item.fs ? _openFile(*item.fs, item.url, 0)
+                                    : WiFi.isConnected() && _openStation(item.url, "", "", 0);
+        _preloading = false;
+
+        log_d("preloading %s %s", item.url, opened ? "done" : "failed");
+        free(item.url);
+
+        if (!opened)
+            continue;
+
+        _draining = false;
+        _handoverAt = _ringbuffer.totalWritten();
+        _handoverPending = true;
+        _sourceState = SOURCE_ACTIVE;
+        return;
     }
+}
 
-    if (offset >= _file.size())
+void ESP32_VS1053_Stream::_handover()
+{
+    // skip whatever the decoder did not need from the finished item
+    while (_ringbuffer.totalRead() != _handoverAt)
     {
-        _file.close();
-        if (_errorCallback)
-            _errorCallback(ERROR_OUT_OF_RANGE);
-        return false;
+        size_t size = 0;
+        if (!_ringbuffer.acquireRead(size))
+            break;
+        _ringbuffer.commitRead(min(size, _handoverAt - _ringbuffer.totalRead()));
     }
 
-    const char *ext = strrchr(filename, '.');
-    if (ext && strcasecmp(ext, ".wav") == 0)
-        _remainingBytes = _fileLastWAVByte() - offset;
-    else
-        _remainingBytes = _file.size() - offset;
+    // reported from loop() so the callback never runs with the decoder locked
+    free(_finishedUrl);
+    _finishedUrl = strdup(_url);
 
-    _file.seek(offset);
-    if (strcmp(filename, _url))
+    // frame based formats resync on the next frame, everything else needs a fresh decoder
+    const bool seamless = _codec == _next.codec && (_codec == CODEC_MP3 || _codec == CODEC_AAC_ADTS);
+    if (!seamless)
     {
         _vs1053->stopSong();
-        snprintf(_url, sizeof(_url), "%s", filename);
+        _codec = CODEC_UNKNOWN;
+        _reportedCodec = CODEC_UNKNOWN;
+        _decoderSyncAttempts = 0;
+        _bitrate = 0;
     }
-    _playingFile = true;
-    _bufferIndex = 0;
-    _bufferFill = 0;
-    _bitrateTimer = millis();
-
-    return true;
+    log_i("%s handover to %s", seamless ? "gapless" : "decoder reset", _next.url ? _next.url : "");
+
+    _station = _next.station;
+    _stationBitrate = _next.stationBitrate;
+    _fileSystem = _next.fs;
+    _remainingBytes = _next.remainingBytes;
+    _offset = _next.offset;
+    _trackSize = _next.size;
+    _trackEnd = _next.end;
+    _setUrl(_next.url ? _next.url : "");
+    _resetPlayTime(_next.remainingBytes >= 0 ? _next.end - _next.remainingBytes : _next.offset);
+    free(_next.url);
+    _next = {};
+    _handoverPending = false;
+    _setCredentials(nullptr, nullptr);
 }
 
 size_t ESP32_VS1053_Stream::_fileLastWAVByte()
@@ -1061,52 +3952,48 @@ size_t ESP32_VS1053_Stream::_fileLastWAVByte()
 
 void ESP32_VS1053_Stream::_handleLocalFile()
 {
-    log_d("file pos: %lu", _file.position());
-    log_d("remaining bytes: %lu", _remainingBytes);
-
-    _updateBitRate();
-
     if (!_remainingBytes)
     {
         _eofStream();
         return;
     }
 
-    if (!_ringbuffer_handle)
+    _updateBitRate();
+    _handleLocalFileNoPSRAM();
+}
+
+size_t ESP32_VS1053_Stream::_fileToRingBuffer()
+{
+    log_d("file pos: %lu", _file.position());
+    log_d("remaining bytes: %ld", (long)_sourceRemaining);
+
+    if (!_sourceRemaining || _file.position() >= _file.size())
     {
-        _handleLocalFileNoPSRAM();
-        return;
+        _sourceState = SOURCE_DONE;
+        return 0;
     }
 
     [[maybe_unused]] const auto startTimeMS = millis();
 
-    if (_remainingBytes && _file.position() < _file.size())
-    {
-        const size_t free = xRingbufferGetCurFreeSize(_ringbuffer_handle);
-        if (free > 1024)
-        {
-            const size_t toRead = min(sizeof(_localbuffer), free);
-            const size_t avail = min(toRead, (size_t)_remainingBytes);
-            const size_t bytes = _file.read(_localbuffer, avail);
-            if (bytes)
-            {
-                if (xRingbufferSend(_ringbuffer_handle, _localbuffer, bytes, 0) == pdFALSE)
-                {
-                    log_v("ringbuffer failed to receive %i bytes. Closing stream.", bytes);
-                    if (_errorCallback)
-                        _errorCallback(ERROR_RINGBUFFER_FAIL);
-                    _remainingBytes = 0;
-                }
-
-                log_d("%lu ms moving %i bytes localfile->ringbuffer", millis() - startTimeMS, bytes);
-            }
-        }
-    }
+    const size_t keep = _keepFree();
+    if (_ringbuffer.free() <= 1024 + keep)
+        return 0;
 
-    if (_remainingBytes)
-        _playFromRingBuffer();
-    else
-        _eofStream();
+    size_t space = 0;
+    uint8_t *dest = _ringbuffer.acquireWrite(space);
+
+    const size_t toRead = min(VS1053_LOCALBUFFER_SIZE, min(space, _ringbuffer.free() - keep));
+    const size_t avail = min(toRead, (size_t)_sourceRemaining);
+    const size_t bytes = _file.read(dest, avail);
+    if (!bytes)
+        return 0;
+
+    _ringbuffer.commitWrite(bytes);
+    _sourceRemaining -= bytes;
+    _stats.bytesReceived += bytes;
+
+    log_d("%lu ms moving %zu bytes localfile->ringbuffer", millis() - startTimeMS, bytes);
+    return bytes;
 }
 
 void ESP32_VS1053_Stream::_handleLocalFileNoPSRAM()
@@ -1117,7 +4004,7 @@ void ESP32_VS1053_Stream::_handleLocalFileNoPSRAM()
         {
             constexpr int32_t MAX_MOVE = 1024;
 
-            static_assert(MAX_MOVE <= sizeof(_localbuffer), "MAX_MOVE must be smaller than sizeof(_localbuffer)");
+            static_assert(MAX_MOVE <= VS1053_LOCALBUFFER_SIZE, "MAX_MOVE must be smaller than VS1053_LOCALBUFFER_SIZE");
 
             size_t toRead = min(MAX_MOVE, _remainingBytes);
             _bufferFill = _file.read(_localbuffer, toRead);
@@ -1126,12 +4013,13 @@ void ESP32_VS1053_Stream::_handleLocalFileNoPSRAM()
             if (_bufferFill == 0)
             {
                 if (_errorCallback)
-                    _errorCallback(ERROR_FILE_IO);
+                    _emitText(EVENT_ERROR, ERROR_FILE_IO);
                 _eofStream();
                 return;
             }
 
             _remainingBytes -= _bufferFill;
+            _stats.bytesReceived += _bufferFill;
         }
         else
         {
@@ -1141,12 +4029,9 @@ void ESP32_VS1053_Stream::_handleLocalFileNoPSRAM()
         }
     }
 
-    while (_bufferIndex < _bufferFill && _vs1053->data_request())
-    {
-        size_t chunk = min(VS1053_PLAYBUFFER_SIZE, _bufferFill - _bufferIndex);
-        _vs1053->playChunk(&_localbuffer[_bufferIndex], chunk);
-        _bufferIndex += chunk;
-    }
+    const size_t written = _sdiWrite(&_localbuffer[_bufferIndex], _bufferFill - _bufferIndex);
+    _bufferIndex += written;
+    _bytesPlayed += written;
 }
 
 bool ESP32_VS1053_Stream::_isAudioFile(File &f)
@@ -1189,6 +4074,51 @@ bool ESP32_VS1053_Stream::_isAudioFile(File &f)
     return true;
 }
 
+size_t ESP32_VS1053_Stream::_sniff(uint8_t *data, const size_t len)
+{
+    const size_t kept = _sniffer.sniff(data, len);
+    if (kept < len)
+        _dropSniffed(len - kept);
+
+    if (_sniffer.active())
+        return kept;
+
+    if (_sniffer.rejected())
+    {
+        // ends the item as soon as the buffer is played, no need to wait for the decoder to give up
+        log_w("stream is not playable");
+        if (_errorCallback)
+            _emitText(EVENT_ERROR, ERROR_NOT_PLAYABLE);
+        _sourceState = SOURCE_DONE;
+        return kept;
+    }
+
+    static const uint8_t CODECS[] = {CODEC_UNKNOWN, CODEC_MP3, CODEC_AAC_ADTS, CODEC_AAC_ADIF, CODEC_AAC_MP4,
+                                     CODEC_WAV, CODEC_WMA, CODEC_MIDI, CODEC_OGG, CODEC_FLAC};
+    const uint8_t codec = CODECS[_sniffer.format()];
+    log_d("sniffed %s, %zu bytes skipped", _codecName(codec), len - kept);
+
+    // a preloaded item only tells the handover, its codec is reported when it plays
+    if (_handoverPending)
+        _next.codec = codec;
+    else if (_codecCallback)
+    {
+        _reportedCodec = codec;
+        _emitText(EVENT_CODEC, _codecName(codec));
+    }
+    return kept;
+}
+
+void ESP32_VS1053_Stream::_dropSniffed(const size_t bytes)
+{
+    // the item ends when its last byte is played, bytes that never reach the decoder would hold that off
+    Lock lock(_decoderMutex);
+    int32_t &remaining = _handoverPending ? _next.remainingBytes : _remainingBytes;
+    size_t &end = _handoverPending ? _next.end : _trackEnd;
+    remaining -= remaining > 0 ? min((int32_t)bytes, remaining) : 0;
+    end -= min(bytes, end);
+}
+
 void ESP32_VS1053_Stream::_updateBitRate()
 {
     if (millis() - _bitrateTimer > 20)
@@ -1204,6 +4134,7 @@ void ESP32_VS1053_Stream::_readBitRate()
 
     if (hdat1 == 0) // decoder not locked yet
     {
+        _stats.decoderSyncAttempts++;
         if (++_decoderSyncAttempts > 50)
         {
             log_v("decoder failed to sync");
@@ -1256,8 +4187,9 @@ void ESP32_VS1053_Stream::_readBitRate()
         if (_codec != CODEC_UNKNOWN)
             setVolume(_volume);
 
-        if (_codec != CODEC_UNKNOWN && _codecCallback)
-            _codecCallback(_codecName(_codec));
+        if (_codec != CODEC_UNKNOWN && _codec != _reportedCodec && _codecCallback)
+            _emitText(EVENT_CODEC, _codecName(_codec));
+        _reportedCodec = _codec;
     }
 
     if (!_bitrateCallback)
@@ -1288,7 +4220,7 @@ void ESP32_VS1053_Stream::_readBitRate()
     if (bitrate != _bitrate)
     {
         _bitrate = bitrate;
-        _bitrateCallback(bitrate);
+        _emitBitrate(bitrate);
     }
 }
 
@@ -1301,66 +4233,361 @@ const char *ESP32_VS1053_Stream::_codecName(uint8_t codec)
 
 void ESP32_VS1053_Stream::setCodecCB(codec_callback_t cb)
 {
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
     _codecCallback = cb;
 }
 
 void ESP32_VS1053_Stream::clearCodecCB()
 {
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
     _codecCallback = nullptr;
 }
 
 void ESP32_VS1053_Stream::setBitrateCB(bitrate_callback_t cb)
 {
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
     _bitrateCallback = cb;
 }
 
 void ESP32_VS1053_Stream::clearBitrateCB()
 {
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
     _bitrateCallback = nullptr;
 }
 
 void ESP32_VS1053_Stream::setStationCB(station_callback_t cb)
 {
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
     _stationCallback = cb;
 }
 
 void ESP32_VS1053_Stream::clearStationCB()
 {
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
     _stationCallback = nullptr;
 }
 
 void ESP32_VS1053_Stream::setInfoCB(streaminfo_callback_t cb)
 {
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
     _infoCallback = cb;
 }
 
 void ESP32_VS1053_Stream::clearInfoCB()
 {
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
     _infoCallback = nullptr;
 }
 
+void ESP32_VS1053_Stream::setMetadataCB(metadata_callback_t cb)
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+    _metadataCallback = cb;
+}
+
+void ESP32_VS1053_Stream::clearMetadataCB()
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+    _metadataCallback = nullptr;
+}
+
 void ESP32_VS1053_Stream::setEofCB(eof_callback_t cb)
 {
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
     _eofCallback = cb;
 }
 
 void ESP32_VS1053_Stream::clearEofCB()
 {
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
     _eofCallback = nullptr;
 }
 
+void ESP32_VS1053_Stream::setPositionCB(position_callback_t cb, const uint32_t intervalMs)
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+    _positionIntervalMs = intervalMs;
+    _positionCallback = cb;
+}
+
+void ESP32_VS1053_Stream::clearPositionCB()
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+    _positionCallback = nullptr;
+}
+
 void ESP32_VS1053_Stream::setErrorCB(error_callback_t cb)
 {
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
     _errorCallback = cb;
 }
 
 void ESP32_VS1053_Stream::clearErrorCB()
 {
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
     _errorCallback = nullptr;
 }
 
+void ESP32_VS1053_Stream::_dispatchEvent(const Event &event)
+{
+    switch (event.type)
+    {
+    case EVENT_STATION:
+        if (const station_callback_t callback = _callback(_stationCallback))
+            callback(event.data);
+        break;
+
+    case EVENT_CODEC:
+        if (const codec_callback_t callback = _callback(_codecCallback))
+            callback(event.data);
+        break;
+
+    case EVENT_BITRATE:
+        if (const bitrate_callback_t callback = _callback(_bitrateCallback))
+            callback(event.value);
+        break;
+
+    case EVENT_INFO:
+        if (const streaminfo_callback_t callback = _callback(_infoCallback))
+            callback(event.data);
+        break;
+
+    case EVENT_METADATA:
+        if (const metadata_callback_t callback = _callback(_metadataCallback))
+            callback(reinterpret_cast<const VS1053_MetadataField *>(event.data), event.bytes);
+        break;
+
+    case EVENT_EOF:
+        if (const eof_callback_t callback = _callback(_eofCallback))
+            callback(event.data);
+        break;
+
+    case EVENT_POSITION:
+        if (const position_callback_t callback = _callback(_positionCallback))
+            callback(event.value, event.duration, event.bytes);
+        break;
+
+    case EVENT_ERROR:
+        if (const error_callback_t callback = _callback(_errorCallback))
+            callback(event.data);
+        break;
+    }
+}
+
+void ESP32_VS1053_Stream::_postEvent(Event &event)
+{
+    // the feeding path never waits for the application, a full queue drops the event
+    if (xQueueSend(_events, &event, 0) == pdTRUE)
+        return;
+
+    log_w("Event queue full, dropped event %i", event.type);
+    _stats.eventsDropped++;
+    free(event.data);
+}
+
+void ESP32_VS1053_Stream::_emitText(const uint8_t type, const char *text)
+{
+    if (type == EVENT_ERROR && _muteErrors)
+        return;
+
+    Event event = {type, 0, 0, 0, const_cast<char *>(text)};
+    if (!_events)
+    {
+        _dispatchEvent(event);
+        return;
+    }
+
+    event.data = strdup(text);
+    if (!event.data)
+    {
+        _stats.eventsDropped++;
+        return;
+    }
+    _postEvent(event);
+}
+
+void ESP32_VS1053_Stream::_emitBitrate(const uint32_t bitrate)
+{
+    Event event = {EVENT_BITRATE, bitrate, 0, 0, nullptr};
+    if (!_events)
+        _dispatchEvent(event);
+    else
+        _postEvent(event);
+}
+
+void ESP32_VS1053_Stream::_emitPosition(const uint32_t ms, const uint32_t duration, const size_t bytes)
+{
+    Event event = {EVENT_POSITION, ms, duration, bytes, nullptr};
+    if (!_events)
+        _dispatchEvent(event);
+    else
+        _postEvent(event);
+}
+
+void ESP32_VS1053_Stream::_emitMetadata(const VS1053_MetadataField *fields, const size_t count)
+{
+    if (!_events)
+    {
+        if (const metadata_callback_t callback = _callback(_metadataCallback))
+            callback(fields, count);
+        return;
+    }
+
+    // the fields point into _localbuffer, which is reused for the next block
+    // so they are packed with a copy of their text into one allocation
+    size_t size = count * sizeof(VS1053_MetadataField);
+    for (size_t i = 0; i < count; i++)
+        size += fields[i].keyLength + fields[i].valueLength + 2;
+
+    char *data = static_cast<char *>(malloc(size));
+    if (!data)
+    {
+        _stats.eventsDropped++;
+        return;
+    }
+
+    VS1053_MetadataField *copy = reinterpret_cast<VS1053_MetadataField *>(data);
+    char *text = data + count * sizeof(VS1053_MetadataField);
+    for (size_t i = 0; i < count; i++)
+    {
+        copy[i] = {text, fields[i].keyLength, text + fields[i].keyLength + 1, fields[i].valueLength};
+        memcpy(text, fields[i].key, fields[i].keyLength + 1);
+        text += fields[i].keyLength + 1;
+        memcpy(text, fields[i].value, fields[i].valueLength + 1);
+        text += fields[i].valueLength + 1;
+    }
+
+    Event event = {EVENT_METADATA, 0, 0, count, data};
+    _postEvent(event);
+}
+
+void ESP32_VS1053_Stream::_deleteEventQueue()
+{
+    if (!_events)
+        return;
+
+    Event event;
+    while (xQueueReceive(_events, &event, 0) == pdTRUE)
+        free(event.data);
+
+    vQueueDelete(_events);
+    _events = nullptr;
+}
+
+bool ESP32_VS1053_Stream::setEventQueue(const size_t length)
+{
+    Lock sourceLock(_sourceMutex);
+    Lock decoderLock(_decoderMutex);
+
+    // checked under the lock startEventTask() holds, so the queue is never swapped under a starting task
+    if (_eventTaskRunning)
+    {
+        log_e("Stop the event task before changing the event queue");
+        return false;
+    }
+
+    _deleteEventQueue();
+
+    if (!length)
+        return true;
+
+    _events = xQueueCreate(length, sizeof(Event));
+    if (!_events)
+    {
+        log_e("Could not create event queue");
+        return false;
+    }
+    return true;
+}
+
+size_t ESP32_VS1053_Stream::pollEvents()
+{
+    if (!_events || _eventTaskRunning)
+        return 0;
+
+    // only what is waiting now, events posted while calling back wait for the next poll
+    size_t dispatched = 0;
+    size_t waiting = uxQueueMessagesWaiting(_events);
+    Event event;
+    while (waiting-- && xQueueReceive(_events, &event, 0) == pdTRUE)
+    {
+        _dispatchEvent(event);
+        free(event.data);
+        dispatched++;
+    }
+    return dispatched;
+}
+
+void ESP32_VS1053_Stream::_eventTaskLoop(void *arg)
+{
+    ESP32_VS1053_Stream *self = static_cast<ESP32_VS1053_Stream *>(arg);
+
+    while (!self->_eventTaskStop)
+    {
+        Event event;
+        if (xQueueReceive(self->_events, &event, pdMS_TO_TICKS(100)) != pdTRUE)
+            continue;
+
+        self->_dispatchEvent(event);
+        free(event.data);
+    }
+
+    self->_eventTaskRunning = false;
+    vTaskDelete(nullptr);
+}
+
+bool ESP32_VS1053_Stream::startEventTask(const BaseType_t core, const UBaseType_t priority, const uint32_t stackSize)
+{
+    Lock lock(_sourceMutex);
+
+    if (!_events || _eventTaskRunning)
+        return false;
+
+    _eventTaskStop = false;
+    _eventTaskRunning = true;
+
+    if (xTaskCreatePinnedToCore(_eventTaskLoop, "vs1053_events", stackSize, this, priority, &_eventTask, core) != pdPASS)
+    {
+        log_e("Could not start event task");
+        _eventTaskRunning = false;
+        _eventTask = nullptr;
+        return false;
+    }
+    log_d("Event task started on core %i", core);
+    return true;
+}
+
+void ESP32_VS1053_Stream::stopEventTask()
+{
+    if (!_eventTaskRunning)
+        return;
+
+    _eventTaskStop = true;
+    while (_eventTaskRunning)
+        delay(1);
+
+    _eventTask = nullptr;
+}
+
 bool ESP32_VS1053_Stream::playChunk(uint8_t *data, size_t len, bool stopSong)
 {
+    Lock lock(_decoderMutex);
     if (!_vs1053)
         return false;
 
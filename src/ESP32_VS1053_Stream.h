@@ -6,25 +6,174 @@
 #include <WiFiClient.h>
 #include <HTTPClient.h>
 #include <FS.h>
-#include <freertos/ringbuf.h>
+#include <SPI.h>
+#include <atomic>
+#include <functional>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
 #include <esp_heap_caps.h>
+#include <Preferences.h>
 #include <VS1053.h> /* https://github.com/baldram/ESP_VS1053_Library */
 
+#include "VS1053_Ringbuffer.h"
+#include "VS1053_TsDemux.h"
+#include "VS1053_SeekIndex.h"
+#include "VS1053_Sniffer.h"
+#include "VS1053_Arena.h"
+
+#ifndef VS1053_INITIALVOLUME
 #define VS1053_INITIALVOLUME 95
-#define VS1053_ICY_METADATA true
+#endif
+#ifndef VS1053_ICY_METADATA
+#define VS1053_ICY_METADATA true    /* false leaves the metadata parser out of the build */
+#endif
+#ifndef VS1053_CHUNKED_ENABLED
+#define VS1053_CHUNKED_ENABLED true /* false requests http/1.0, which is never chunked, and leaves the chunk parser out */
+#endif
+#ifndef VS1053_HLS_ENABLED
+#define VS1053_HLS_ENABLED true     /* false leaves hls playlists and the transport stream demuxer out */
+#endif
+#ifndef VS1053_CONNECT_TIMEOUT_MS
 #define VS1053_CONNECT_TIMEOUT_MS 500
+#endif
+#ifndef VS1053_CONNECT_TIMEOUT_MS_SSL
 #define VS1053_CONNECT_TIMEOUT_MS_SSL 1000
+#endif
+#ifndef VS1053_STREAM_TIMEOUT_MS
 #define VS1053_STREAM_TIMEOUT_MS 900
+#endif
+#ifndef VS1053_STREAM_STALL_MS
+#define VS1053_STREAM_STALL_MS 500 /* a gap between network reads this long is counted as a stall */
+#endif
+#ifndef VS1053_MAX_URL_LENGTH
 #define VS1053_MAX_URL_LENGTH 2048
+#endif
+#ifndef VS1053_MAX_REDIRECT_COUNT
 #define VS1053_MAX_REDIRECT_COUNT 3
+#endif
+#ifndef VS1053_KEEPALIVE_TIMEOUT_MS
+#define VS1053_KEEPALIVE_TIMEOUT_MS 5000 /* an unused kept-alive connection is closed after this time */
+#endif
+#ifndef VS1053_RECONNECT_ATTEMPTS
+#define VS1053_RECONNECT_ATTEMPTS 5        /* reconnects after a dropped connection before giving up, 0 disables */
+#endif
+#ifndef VS1053_RECONNECT_DELAY_MS
+#define VS1053_RECONNECT_DELAY_MS 1000     /* wait before a next reconnect, multiplied by the failed attempts */
+#endif
+#ifndef VS1053_RECONNECT_TIMEOUT_MS
+#define VS1053_RECONNECT_TIMEOUT_MS 3000   /* an open connection that sends nothing for this long is reconnected */
+#endif
+#ifndef VS1053_QUEUE_SIZE
+#define VS1053_QUEUE_SIZE 4
+#endif
+#ifndef VS1053_MAX_METADATA_FIELDS
+#define VS1053_MAX_METADATA_FIELDS 8
+#endif
+#ifndef VS1053_STATION_CACHE_SIZE
+#define VS1053_STATION_CACHE_SIZE 8
+#endif
+#ifndef VS1053_STATION_CACHE_NAMESPACE
+#define VS1053_STATION_CACHE_NAMESPACE "vs1053_cache"
+#endif
+#ifndef VS1053_HLS_MAX_SEGMENTS
+#define VS1053_HLS_MAX_SEGMENTS 8           /* segments waiting to be fetched */
+#endif
+#ifndef VS1053_HLS_LIVE_START_SEGMENTS
+#define VS1053_HLS_LIVE_START_SEGMENTS 3    /* a live playlist starts this many segments from the end */
+#endif
+#ifndef VS1053_HLS_MAX_BANDWIDTH
+#define VS1053_HLS_MAX_BANDWIDTH 320000     /* highest variant bandwidth in bits/s picked from a master playlist */
+#endif
+#ifndef VS1053_HLS_MAX_PLAYLIST_FAILURES
+#define VS1053_HLS_MAX_PLAYLIST_FAILURES 3  /* consecutive failed live playlist refreshes before giving up */
+#endif
 
+#ifndef VS1053_PSRAM_BUFFER_ENABLED
 #define VS1053_PSRAM_BUFFER_ENABLED true
+#endif
+#ifndef VS1053_PSRAM_BUFFER_TIMEOUT_MS
 #define VS1053_PSRAM_BUFFER_TIMEOUT_MS 10
+#endif
+#ifndef VS1053_PREBUFFER_MS
+#define VS1053_PREBUFFER_MS 1000
+#endif
+#ifndef VS1053_DEFAULT_BITRATE_KBPS
+#define VS1053_DEFAULT_BITRATE_KBPS 128 /* used to size the prebuffer until the bitrate is known */
+#endif
+#ifndef VS1053_PSRAM_BUFFER_SIZE
 #define VS1053_PSRAM_BUFFER_SIZE 65536
+#endif
+#ifndef VS1053_INTERNAL_BUFFER_SIZE
+#define VS1053_INTERNAL_BUFFER_SIZE 16384 /* used when there is no psram, set to 0 to play unbuffered */
+#endif
+
+#ifndef VS1053_BUFFER_TASK_CORE
+#define VS1053_BUFFER_TASK_CORE 0
+#endif
+#ifndef VS1053_BUFFER_TASK_PRIORITY
+#define VS1053_BUFFER_TASK_PRIORITY 5
+#endif
+#ifndef VS1053_BUFFER_TASK_STACK
+#define VS1053_BUFFER_TASK_STACK 4096
+#endif
+
+#ifndef VS1053_FEEDER_TASK_CORE
+#define VS1053_FEEDER_TASK_CORE 1
+#endif
+#ifndef VS1053_FEEDER_TASK_PRIORITY
+#define VS1053_FEEDER_TASK_PRIORITY 6
+#endif
+#ifndef VS1053_FEEDER_TASK_STACK
+#define VS1053_FEEDER_TASK_STACK 4096
+#endif
+#ifndef VS1053_FEEDER_TASK_TIMEOUT_MS
+#define VS1053_FEEDER_TASK_TIMEOUT_MS 5
+#endif
+
+#ifndef VS1053_MAX_DECODERS
+#define VS1053_MAX_DECODERS 4 /* decoders that can share a feeder task */
+#endif
+
+#ifndef VS1053_EVENT_TASK_CORE
+#define VS1053_EVENT_TASK_CORE 1
+#endif
+#ifndef VS1053_EVENT_TASK_PRIORITY
+#define VS1053_EVENT_TASK_PRIORITY 1
+#endif
+#ifndef VS1053_EVENT_TASK_STACK
+#define VS1053_EVENT_TASK_STACK 4096
+#endif
+
+#ifndef VS1053_TIMESHIFT_FILE_SIZE
+#define VS1053_TIMESHIFT_FILE_SIZE 67108864 /* largest time-shift file, about an hour at 128 kbps */
+#endif
+#ifndef VS1053_RECORD_BUFFER_SIZE
+#define VS1053_RECORD_BUFFER_SIZE 32768 /* received audio waiting to be written to the recording */
+#endif
+#ifndef VS1053_RECORD_WRITE_SIZE
+#define VS1053_RECORD_WRITE_SIZE 4096   /* recordings are written in blocks of this size */
+#endif
+#ifndef VS1053_RECORD_TASK_CORE
+#define VS1053_RECORD_TASK_CORE 0
+#endif
+#ifndef VS1053_RECORD_TASK_PRIORITY
+#define VS1053_RECORD_TASK_PRIORITY 1
+#endif
+#ifndef VS1053_RECORD_TASK_STACK
+#define VS1053_RECORD_TASK_STACK 4096
+#endif
+
+#ifndef VS1053_SDI_SPI_SPEED
+#define VS1053_SDI_SPI_SPEED 4000000 /* data (sdi) clock, the VS1053 allows up to CLKI/4 */
+#endif
 
 constexpr size_t VS1053_LOCALBUFFER_SIZE = 4096; // need at least 4kB to safely receive ICY metadata
 constexpr uint8_t VS1053_MAXVOLUME = 100;
 constexpr size_t VS1053_PLAYBUFFER_SIZE = 32;
+constexpr size_t VS1053_HOST_KEY_LENGTH = 272; // "https://" + hostname + ":port"
+constexpr size_t VS1053_WORK_BUFFER_SIZE = VS1053_LOCALBUFFER_SIZE + VS1053_PLAYBUFFER_SIZE; // held while playing
 
 static_assert(VS1053_LOCALBUFFER_SIZE >= 4096,
               "VS1053_LOCALBUFFER_SIZE must be equal or greater than 4096");
@@ -32,12 +181,57 @@ static_assert(VS1053_LOCALBUFFER_SIZE >= 4096,
 static_assert(VS1053_MAX_URL_LENGTH <= VS1053_LOCALBUFFER_SIZE,
               "VS1053_MAX_URL_LENGTH must be smaller than or equal to VS1053_LOCALBUFFER_SIZE");
 
-typedef void (*station_callback_t)(const char *name);
-typedef void (*codec_callback_t)(const char *codec);
-typedef void (*bitrate_callback_t)(uint32_t bitrate);
-typedef void (*streaminfo_callback_t)(const char *info);
-typedef void (*eof_callback_t)(const char *url);
-typedef void (*error_callback_t)(const char *error);
+enum class VS1053_BufferMemory : uint8_t
+{
+    PREFER_PSRAM, /* psram if available, else a buffer of at most VS1053_INTERNAL_BUFFER_SIZE in internal ram */
+    PSRAM_ONLY,
+    INTERNAL_ONLY
+};
+
+struct VS1053_MetadataField
+{
+    const char *key; /* key and value point into the metadata block and are zero terminated */
+    size_t keyLength;
+    const char *value;
+    size_t valueLength;
+};
+
+struct VS1053_Stats
+{
+    uint64_t bytesReceived;         /* raw bytes read from the network or file */
+    uint64_t bytesDecoded;          /* audio bytes sent to the decoder */
+    uint32_t underruns;             /* times the ringbuffer ran dry while the source was still active */
+    uint32_t underrunMs;            /* total time spent rebuffering after an underrun */
+    uint32_t streamStalls;          /* network gaps longer than VS1053_STREAM_STALL_MS */
+    size_t bufferHighWater;         /* highest ringbuffer fill */
+    size_t bufferLowWater;          /* lowest ringbuffer fill during playback, after the prebuffer filled */
+    uint32_t loopMaxUs;             /* longest loop() call */
+    uint32_t loopAvgUs;             /* average loop() call */
+    uint32_t decoderSyncAttempts;   /* bitrate polls before the decoder reported a codec */
+    uint32_t reconnects;            /* connections reopened after they dropped */
+    uint32_t eventsDropped;         /* callbacks lost because the event queue was full */
+    uint32_t inputBytesPerSecond;   /* received over the last second */
+    uint32_t outputBytesPerSecond;  /* decoded over the last second */
+};
+
+struct VS1053_MemoryUsage
+{
+    size_t object;     /* the instance itself */
+    size_t workBuffer; /* held while an item plays, from the arena when one is set */
+    size_t ringbuffer; /* ringbuffer and recording buffer, in psram when available */
+    size_t heap;       /* urls, queue, station cache, event queue, http clients and the decoder driver */
+    size_t total;
+};
+
+/* plain functions still work, a lambda can capture the instance or zone it belongs to */
+typedef std::function<void(const char *name)> station_callback_t;
+typedef std::function<void(const char *codec)> codec_callback_t;
+typedef std::function<void(uint32_t bitrate)> bitrate_callback_t;
+typedef std::function<void(const char *info)> streaminfo_callback_t;
+typedef std::function<void(const VS1053_MetadataField *fields, size_t count)> metadata_callback_t;
+typedef std::function<void(const char *url)> eof_callback_t;
+typedef std::function<void(uint32_t positionMs, uint32_t durationMs, size_t bytesPlayed)> position_callback_t;
+typedef std::function<void(const char *error)> error_callback_t;
 
 class ESP32_VS1053_Stream
 {
@@ -45,8 +239,12 @@ class ESP32_VS1053_Stream
 public:
     ESP32_VS1053_Stream();
     ~ESP32_VS1053_Stream();
+    ESP32_VS1053_Stream(const ESP32_VS1053_Stream &) = delete; // owns tasks, locks, buffers and atomic counters
+    ESP32_VS1053_Stream &operator=(const ESP32_VS1053_Stream &) = delete;
 
     bool startDecoder(const uint8_t CS, const uint8_t DCS, const uint8_t DREQ);
+    bool startDecoder(const uint8_t CS, const uint8_t DCS, const uint8_t DREQ,
+                      const size_t bufferSize, const VS1053_BufferMemory memory = VS1053_BufferMemory::PREFER_PSRAM);
     bool isChipConnected();
 
     bool connectToHost(const char *url);
@@ -57,6 +255,27 @@ public:
     bool connectToFile(fs::FS &fs, const char *filename);
     bool connectToFile(fs::FS &fs, const char *filename, const size_t offset);
 
+    bool seekMs(const uint32_t ms);
+
+    bool pause();
+    bool resume();
+    bool isPaused();
+    bool skipBack(const uint32_t ms);
+    bool jumpToLive();
+    uint32_t timeshiftMs();
+    void setRewindTime(const uint32_t ms);
+    bool setTimeshiftFile(fs::FS &fs, const char *filename);
+    void clearTimeshiftFile();
+
+    bool enqueue(const char *url);
+    bool enqueue(fs::FS &fs, const char *filename);
+    void clearQueue();
+    size_t queueLength();
+
+    bool saveStationCache();
+    bool loadStationCache();
+    void clearStationCache();
+
     void setCodecCB(codec_callback_t cb);
     void clearCodecCB();
 
@@ -69,14 +288,48 @@ public:
     void setInfoCB(streaminfo_callback_t cb);
     void clearInfoCB();
 
+    void setMetadataCB(metadata_callback_t cb);
+    void clearMetadataCB();
+
     void setEofCB(eof_callback_t cb);
     void clearEofCB();
 
+    void setPositionCB(position_callback_t cb, const uint32_t intervalMs = 1000);
+    void clearPositionCB();
+
     void setErrorCB(error_callback_t cb);
     void clearErrorCB();
 
+    bool setEventQueue(const size_t length); /* 0 calls back from the feeding path, the default */
+    size_t pollEvents();
+    bool startEventTask(const BaseType_t core = VS1053_EVENT_TASK_CORE,
+                        const UBaseType_t priority = VS1053_EVENT_TASK_PRIORITY,
+                        const uint32_t stackSize = VS1053_EVENT_TASK_STACK);
+    void stopEventTask();
+
     void loop();
 
+    bool startBufferTask(const BaseType_t core = VS1053_BUFFER_TASK_CORE,
+                         const UBaseType_t priority = VS1053_BUFFER_TASK_PRIORITY,
+                         const uint32_t stackSize = VS1053_BUFFER_TASK_STACK);
+    void stopBufferTask();
+
+    bool startFeederTask(const BaseType_t core = VS1053_FEEDER_TASK_CORE,
+                         const UBaseType_t priority = VS1053_FEEDER_TASK_PRIORITY,
+                         const uint32_t stackSize = VS1053_FEEDER_TASK_STACK);
+    void stopFeederTask();
+
+    bool startSharedFeederTask(const BaseType_t core = VS1053_FEEDER_TASK_CORE,
+                               const UBaseType_t priority = VS1053_FEEDER_TASK_PRIORITY,
+                               const uint32_t stackSize = VS1053_FEEDER_TASK_STACK);
+
+    static void setBufferBudget(const size_t bytes);
+    static size_t bufferBudgetLeft();
+
+    bool startRecording(fs::FS &fs, const char *filename, const bool splitOnTitle = false);
+    void stopRecording();
+    bool isRecording();
+
     bool isRunning();
 
     void stopSong();
@@ -85,14 +338,33 @@ public:
 
     void setVolume(const uint8_t newVolume); /* 0-100 */
 
-    const char *lastUrl();
+    const char *lastUrl() __attribute__((deprecated("use lastUrl(buffer, len), this pointer is only valid until the next call")));
+    size_t lastUrl(char *buffer, const size_t len);
 
     size_t size();
 
     size_t position();
 
+    uint32_t durationMs();
+
+    uint32_t positionMs();
+
+    size_t bytesPlayed();
+
     void bufferStatus(size_t &used, size_t &capacity);
 
+    VS1053_Stats getStats();
+    void resetStats();
+
+    VS1053_MemoryUsage getMemoryUsage();
+    bool setWorkArena(VS1053_Arena *arena); /* nullptr takes the work buffer from the heap, the default */
+
+    bool setBufferSize(const size_t bytes, const VS1053_BufferMemory memory = VS1053_BufferMemory::PREFER_PSRAM);
+    bool setBufferTime(const uint32_t ms, const uint16_t kbps,
+                       const VS1053_BufferMemory memory = VS1053_BufferMemory::PREFER_PSRAM);
+
+    void setPrebufferTime(const uint32_t ms);
+
     void setTone(uint8_t *rtone);
     /*  Bass/Treble: void setTone(uint8_t *rtone);
         toneha       = <0..15>        // Setting treble gain (0 off, 1.5dB steps)
@@ -105,47 +377,332 @@ public:
     bool playChunk(uint8_t *data, size_t len, bool stopSong = true);
 
 private:
+    class Lock
+    {
+    public:
+        explicit Lock(SemaphoreHandle_t mutex) : _mutex(mutex)
+        {
+            if (_mutex)
+                xSemaphoreTakeRecursive(_mutex, portMAX_DELAY);
+        }
+        ~Lock()
+        {
+            if (_mutex)
+                xSemaphoreGiveRecursive(_mutex);
+        }
+        Lock(const Lock &) = delete;
+        Lock &operator=(const Lock &) = delete;
+
+    private:
+        SemaphoreHandle_t _mutex;
+    };
+
     VS1053 *_vs1053;
     HTTPClient *_http;
-    uint8_t _vs1053Buffer[VS1053_PLAYBUFFER_SIZE];
-    uint8_t _localbuffer[VS1053_LOCALBUFFER_SIZE];
-    char _url[VS1053_MAX_URL_LENGTH];
-
-    RingbufHandle_t _ringbuffer_handle;
-    StaticRingbuffer_t *_buffer_struct;
-    uint8_t *_buffer_storage;
+    uint8_t *_vs1053Buffer = nullptr; // VS1053_PLAYBUFFER_SIZE bytes at the end of the work buffer
+    uint8_t *_localbuffer = nullptr;  // VS1053_LOCALBUFFER_SIZE bytes at the start of the work buffer
+    char *_url = nullptr;             // stored at its length, never nullptr after construction
+    char *_lastUrlCopy = nullptr;     // what the deprecated lastUrl() returns
+
+    VS1053_Arena *_arena = nullptr;
+    uint8_t *_workBuffer = nullptr; // only allocated while an item plays
+    bool _acquireWorkBuffer();
+    void _releaseWorkBuffer();
+    bool _setUrl(const char *url);
+
+    VS1053_Ringbuffer _ringbuffer;
+
+    volatile bool _paused = false;
+    uint32_t _rewindMs = 0;      // played audio kept in the free space of the ringbuffer for skipBack()
+    File _spillFile;             // continues the ringbuffer on a card while playback is behind
+    size_t _spillWritePos = 0;   // next byte of new audio in the spill file
+    size_t _spillReadPos = 0;    // next byte that goes back into the ringbuffer
+    bool _sourceToSpill = false; // the current source read goes to the spill file
+    size_t _keepFree();
+    size_t _rewindable();
+    uint8_t *_acquireSource(size_t &space);
+    void _commitSource(uint8_t *data, const size_t len);
+    bool _spillWrite(const uint8_t *data, const size_t len);
+    size_t _spillToRingBuffer();
+    void _clearSpill();
+    void _shiftPlayTime(const int32_t ms);
 
     File _file;
     bool _playingFile = false;
+    fs::FS *_fileSystem = nullptr; // filesystem of the playing file, nullptr for network items
+
+    VS1053_SeekIndex _seekIndex;
+    char *_seekIndexUrl = nullptr;       // item the seek index was built for
+    char *_seekIndexFailedUrl = nullptr; // item that could not be indexed
+    bool _seekOffset(const char *url, fs::FS *fileSystem, const uint32_t ms, size_t *offset);
+    size_t _readRange(const char *url, const size_t offset, uint8_t *data, const size_t len);
+
+    SemaphoreHandle_t _sourceMutex = nullptr; // guards the source side: _http, _file and the stream parser state
+    TaskHandle_t _bufferTask = nullptr;
+    volatile bool _bufferTaskRunning = false;
+    volatile bool _bufferTaskStop = false;
+    static void _bufferTaskLoop(void *arg);
+
+    SemaphoreHandle_t _decoderMutex = nullptr; // guards the decoder side: _vs1053 and the playback state
+    TaskHandle_t _feederTask = nullptr;
+    std::atomic<bool> _feederTaskRunning{false}; // the task clears it on its way out, stopFeederTask() waits for that
+    std::atomic<bool> _feederTaskStop{false};
+    uint8_t _dreqPin = 0;
+    uint8_t _dcsPin = 0;
+    const SPISettings _sdiSettings = SPISettings(VS1053_SDI_SPI_SPEED, MSBFIRST, SPI_MODE0);
+    size_t _sdiWrite(const uint8_t *data, const size_t len);
+    static void _feederTaskLoop(void *arg);
+
+    // one feeder task for all decoders on the bus, guarded by _sharedMutex
+    static ESP32_VS1053_Stream *_shared[VS1053_MAX_DECODERS];
+    static size_t _sharedCount;
+    static SemaphoreHandle_t _sharedMutex;
+    static TaskHandle_t _sharedFeederTask;
+    static volatile bool _sharedFeederRunning;
+    bool _sharedFeeder = false;
+    void _leaveSharedFeeder();
+    static void _sharedFeederTaskLoop(void *arg);
+
+    static std::atomic<size_t> _bufferBudget;    // ringbuffer bytes all instances may use, 0 is no limit
+    static std::atomic<size_t> _bufferAllocated; // ringbuffer bytes all instances use
+
+    VS1053_Ringbuffer _recordBuffer; // filled on the source side, emptied by the record task
+    fs::FS *_recordFs = nullptr;
+    char *_recordName = nullptr;
+    File _recordFile;
+    uint16_t _recordPart = 0;
+    bool _recording = false;
+    bool _recordSplit = false;
+    uint32_t _recordTitleHash = 0;
+    std::atomic<bool> _recordSplitQueued{false}; // set on the source side after _recordSplitAt, cleared by the task
+    std::atomic<size_t> _recordSplitAt{0};        // record buffer position where the next file starts
+    TaskHandle_t _recordTask = nullptr;
+    std::atomic<bool> _recordTaskRunning{false}; // the task clears it once it no longer touches the file or buffer
+    std::atomic<bool> _recordTaskStop{false};
+    void _record(const uint8_t *data, const size_t len);
+    void _recordTitle(const char *title, const size_t audioBefore);
+    bool _openRecordFile();
+    void _writeRecording(const bool flush);
+    static void _recordTaskLoop(void *arg);
+    static void _dreqISR(void *arg);
+
+    enum SourceState
+    {
+        SOURCE_ACTIVE,
+        SOURCE_DONE,
+        SOURCE_FAILED
+    };
+    volatile uint8_t _sourceState = SOURCE_ACTIVE;
+    int32_t _sourceRemaining = 0; // bytes the source still has to deliver, -1 when unknown
+
+    struct QueueItem
+    {
+        char *url;
+        fs::FS *fs; // nullptr for network items
+    };
+    QueueItem _queue[VS1053_QUEUE_SIZE] = {};
+    size_t _queueHead = 0;
+    size_t _queueCount = 0;
+
+    struct NextTrack
+    {
+        char *url;
+        int32_t remainingBytes;
+        size_t offset;
+        size_t size;
+        size_t end;
+        uint8_t codec;
+        int8_t station;
+        uint32_t stationBitrate;
+        fs::FS *fs;
+    };
+    NextTrack _next = {};                 // opened by the source while the current item still plays
+    volatile bool _preloading = false;    // the source is opening the next item
+    volatile bool _draining = false;      // the source is closed, the ringbuffer still holds the end of the item
+    volatile bool _handoverPending = false;
+    size_t _handoverAt = 0;               // ringbuffer byte count where the next item starts
+    char *_finishedUrl = nullptr;         // item that was handed over, waiting for the eof callback
+
+    struct StationCacheEntry
+    {
+        char *url;      // as requested
+        char *resolved; // after redirects and playlists
+        uint8_t codec;
+        uint16_t bitrate; // kbps
+        uint16_t jitterMs;
+        uint32_t lastUsed;
+    };
+    StationCacheEntry _stations[VS1053_STATION_CACHE_SIZE] = {};
+    uint32_t _stationClock = 0;
+    int8_t _station = -1;         // cache entry of the playing item
+    uint32_t _stationBitrate = 0; // kbps remembered from an earlier visit
+    bool _openStation(const char *url, const char *username, const char *pwd, const size_t offset);
+    int8_t _findStation(const char *url);
+    int8_t _rememberStation(const char *url);
+    void _learnStation();
+    void _forgetStation(const int8_t index);
+
+    bool _enqueue(const char *url, fs::FS *fs);
+    bool _popQueue(QueueItem &item);
+    void _startQueued();
+    void _preloadNext();
+    void _handover();
+    void _setTrack(const char *url, const int32_t remaining, const size_t offset,
+                   const size_t size, const size_t end, const uint8_t codec);
+    uint8_t _codecFromContentType();
+    uint8_t _codecFromFilename(const char *filename);
+
+#if VS1053_CHUNKED_ENABLED
+    enum ChunkState
+    {
+        CHUNK_SIZE,
+        CHUNK_EXTENSION,
+        CHUNK_DATA,
+        CHUNK_DATA_CR,
+        CHUNK_DATA_LF,
+        CHUNK_END,
+        CHUNK_ERROR
+    };
+    uint8_t _chunkState = CHUNK_SIZE;
+    size_t _bytesLeftInChunk = 0;
+    bool _chunkedResponse = false;
+    size_t _dechunk(uint8_t *data, const size_t len);
+    void _handleChunkedStream(WiFiClient *stream);
+    size_t _chunkedStreamToRingBuffer(WiFiClient *stream);
+#else
+    static constexpr bool _chunkedResponse = false; // requests are http/1.0
+#endif
 
-    size_t _nextChunkSize(WiFiClient *stream);
-    bool _checkSync(WiFiClient *stream);
-    void _handleMetadata(char *data, const size_t len);
+#if VS1053_ICY_METADATA
+    int32_t _metaDataStart = 0;
+    int32_t _musicDataPosition = 0;
+    size_t _metaRemaining = 0; // metadata bytes still to come
+    size_t _metaFill = 0;      // metadata bytes collected in _localbuffer
+    void _handleMetadata(char *data, const size_t len, const size_t audioBefore);
+#else
+    static constexpr int32_t _metaDataStart = 0; // metadata is not requested
+#endif
+    size_t _stripMetadata(uint8_t *data, const size_t len);
+    void _resetFraming();
     void _eofStream();
+    bool _openHost(const char *url, const char *username, const char *pwd, const size_t offset);
+    bool _openFile(fs::FS &fs, const char *filename, const size_t offset);
+    void _closeHttp(const char *reuseUrl = nullptr);
+    void _releaseHttp(HTTPClient *&http, const char *reuseUrl = nullptr);
+    void _closeSource();
+
+    HTTPClient *_idleHttp = nullptr; // kept-alive connection waiting for a next request to the same host
+    char _idleKey[VS1053_HOST_KEY_LENGTH] = {0};
+    unsigned long _idleSinceMS = 0;
+    HTTPClient *_takeHttp(const char *url, bool &reused);
+    void _dropIdleHttp();
+    bool _hostKey(const char *url, char *key, const size_t len);
     bool _canRedirect();
     void _resolveRedirect(const char *location, const char *base, char *result);
     bool _escapeUrl(const char *url, const size_t len);
     bool _isPlaylistContentType();
-    const char *_parsePlaylist();
+    bool _isRejectedContentType();
+    void _reportHttpError(const int result);
+    const char *_parsePlaylist(bool &complete);
+    const char *_playlistEntry(char *line);
     void _setupStream();
     void _handleStream(WiFiClient *stream);
-    void _handleChunkedStream(WiFiClient *stream);
     void _handleLocalFile();
     void _handleLocalFileNoPSRAM();
     void _feedDecoder(WiFiClient *stream);
-    void _allocateRingbuffer();
+    bool _allocateRingbuffer(const size_t requested, const VS1053_BufferMemory memory);
     void _deallocateRingbuffer();
-    void _playFromRingBuffer();
-    void _streamToRingBuffer(WiFiClient *stream);
-    void _chunkedStreamToRingBuffer(WiFiClient *stream);
+    size_t _playFromRingBuffer();
+    size_t _fillRingBuffer();
+    size_t _fileToRingBuffer();
+    size_t _streamToRingBuffer(WiFiClient *stream);
+
+#if VS1053_HLS_ENABLED
+    enum HlsFormat
+    {
+        HLS_FORMAT_UNKNOWN,
+        HLS_FORMAT_TS,    // mpeg transport stream segments
+        HLS_FORMAT_PACKED // packed audio segments, optionally with an id3 header
+    };
+    bool _hls = false;
+    char *_hlsPlaylistUrl = nullptr; // media playlist after variant selection and redirects
+    char *_hlsSegmentUrl = nullptr;  // segment that is being received
+    char *_hlsSegments[VS1053_HLS_MAX_SEGMENTS] = {};
+    size_t _hlsSegmentHead = 0;
+    size_t _hlsSegmentCount = 0;
+    uint32_t _hlsNextSequence = 0; // media sequence number of the next new segment
+    uint32_t _hlsTargetDuration = 0;
+    unsigned long _hlsRefreshMS = 0;
+    uint8_t _hlsFailures = 0;
+    bool _hlsEndList = false;
+    bool _hlsMore = false; // the last playlist had more segments than fit in _hlsSegments
+    uint8_t _hlsFormat = HLS_FORMAT_UNKNOWN;
+    size_t _hlsSkip = 0; // id3 header bytes still to skip
+    VS1053_TsDemux _tsDemux;
+    bool _hlsStart(char *playlistUrl, const bool complete);
+    void _hlsStop();
+    int _hlsRequest(char *&url);
+    bool _hlsLoadPlaylist(const bool variant = false);
+    bool _hlsSelectVariant(char *text);
+    bool _hlsAdvance();
+    bool _hlsOpenSegment();
+    void _hlsCloseSegment();
+    size_t _hlsToRingBuffer();
+#else
+    static constexpr bool _hls = false; // hls playlists give ERROR_HLS_UNSUPPORTED
+#endif
 
     codec_callback_t _codecCallback = nullptr;
     bitrate_callback_t _bitrateCallback = nullptr;
     station_callback_t _stationCallback = nullptr;
     streaminfo_callback_t _infoCallback = nullptr;
+    metadata_callback_t _metadataCallback = nullptr;
     eof_callback_t _eofCallback = nullptr;
+    position_callback_t _positionCallback = nullptr;
     error_callback_t _errorCallback = nullptr;
 
+    enum EventType : uint8_t
+    {
+        EVENT_STATION,
+        EVENT_CODEC,
+        EVENT_BITRATE,
+        EVENT_INFO,
+        EVENT_METADATA,
+        EVENT_EOF,
+        EVENT_POSITION,
+        EVENT_ERROR
+    };
+
+    struct Event
+    {
+        uint8_t type;
+        uint32_t value;    // bitrate or position
+        uint32_t duration;
+        size_t bytes;      // bytes played or metadata field count
+        char *data;        // text or packed metadata, owned by the queue
+    };
+
+    QueueHandle_t _events = nullptr; // when set callbacks run from pollEvents() or the event task
+    TaskHandle_t _eventTask = nullptr;
+    std::atomic<bool> _eventTaskRunning{false}; // set under _sourceMutex, the task clears it on its way out
+    std::atomic<bool> _eventTaskStop{false};
+    static void _eventTaskLoop(void *arg);
+    void _emitText(const uint8_t type, const char *text);
+    void _emitBitrate(const uint32_t bitrate);
+    void _emitMetadata(const VS1053_MetadataField *fields, const size_t count);
+    void _emitPosition(const uint32_t ms, const uint32_t duration, const size_t bytes);
+    void _postEvent(Event &event);
+    void _dispatchEvent(const Event &event);
+
+    // the setters hold both locks, a copy taken under one of them can be called after it is released
+    template <typename T>
+    T _callback(const T &callback)
+    {
+        Lock lock(_decoderMutex);
+        return callback;
+    }
+    void _deleteEventQueue();
+
     enum Codec
     {
         CODEC_UNKNOWN,
@@ -160,10 +717,15 @@ private:
         CODEC_FLAC
     };
 
+    const uint8_t SCI_DECODE_TIME = 0x04;
     const uint8_t SCI_HDAT0 = 0x08;
     const uint8_t SCI_HDAT1 = 0x09;
 
     uint8_t _codec = CODEC_UNKNOWN;
+    uint8_t _reportedCodec = CODEC_UNKNOWN; // last codec passed to the codec callback
+    VS1053_Sniffer _sniffer;                // reports the codec from the first received bytes
+    size_t _sniff(uint8_t *data, const size_t len);
+    void _dropSniffed(const size_t bytes);
     void _updateBitRate();
     bool _isAudioFile(File &f);
     void _readBitRate();
@@ -174,35 +736,100 @@ private:
 
     size_t _fileLastWAVByte();
 
+    uint32_t _startMs = 0;           // play time of the item when the decoder clock was cleared
+    uint16_t _decodeSeconds = 0;     // last value of SCI_DECODE_TIME
+    unsigned long _decodeTickMS = 0; // when _decodeSeconds last changed
+    uint32_t _pausedAtMs = 0;        // play time while paused
+    size_t _bytesPlayed = 0;         // bytes of the current item sent to the decoder
+    uint32_t _positionIntervalMs = 1000;
+    unsigned long _positionTimer = 0;
+    void _resetPlayTime(const size_t startByte);
+    uint32_t _playTimeMs();
+
     size_t _bufferIndex = 0;
     size_t _bufferFill = 0;
 
     size_t _offset = 0;
+    size_t _trackSize = 0;
+    size_t _trackEnd = 0; // last playable byte + 1
     int32_t _remainingBytes = 0;
-    size_t _bytesLeftInChunk = 0;
-    int32_t _metaDataStart = 0;
-    int32_t _musicDataPosition = 0;
     uint8_t _volume = VS1053_INITIALVOLUME;
-    bool _chunkedResponse = false;
     bool _dataSeen = false;
     bool _ringbuffer_filled = false;
+    uint32_t _prebufferMs = VS1053_PREBUFFER_MS;
+    uint32_t _icyBitrate = 0;      // kbps from the icy-br header
+    uint32_t _measuredBitrate = 0; // kbps measured from the rate the decoder consumes data
+    unsigned long _rateWindowStartMS = 0;
+    size_t _rateWindowBytes = 0;
+    std::atomic<uint32_t> _jitterMs{0}; // decaying peak of the gaps between network reads, read by the feeder side
+    unsigned long _lastArrivalMS = 0;
+    size_t _prebufferLevel = 0;
+    unsigned long _prebufferProgressMS = 0;
+    size_t _prebufferBytes();
+    uint32_t _streamKbps();
+    std::atomic<uint32_t> _lastKbps{VS1053_DEFAULT_BITRATE_KBPS}; // the last _streamKbps(), read by a shared feeder task
+    void _updateJitter();
+    void _updateMeasuredBitrate(const size_t bytes);
     unsigned long _streamStallStartMS = 0;
     unsigned long _bufferStallStartMS = 0;
     uint8_t _redirectCount = 0;
     bool _isHLS = false;
 
+    char *_username = nullptr;  // credentials of the playing station, a reconnect needs them again
+    char *_pwd = nullptr;
+    char *_sourceTag = nullptr; // strong ETag or Last-Modified of the source, validates a resumed download
+    volatile bool _reconnecting = false;
+    volatile bool _muteErrors = false; // attempts that may fail quietly, only giving up is reported
+    uint8_t _reconnectAttempt = 0;
+    unsigned long _reconnectMS = 0; // when the connection dropped or the last attempt failed
+    bool _connectionDropped();
+    size_t _reconnect();
+    void _setCredentials(const char *username, const char *pwd);
+
+    struct StatsCounters // the tasks and loop() count without a lock, getStats() copies them field by field
+    {
+        std::atomic<uint64_t> bytesReceived{0};
+        std::atomic<uint64_t> bytesDecoded{0};
+        std::atomic<uint32_t> underruns{0};
+        std::atomic<uint32_t> underrunMs{0};
+        std::atomic<uint32_t> streamStalls{0};
+        std::atomic<size_t> bufferHighWater{0};
+        std::atomic<size_t> bufferLowWater{SIZE_MAX};
+        std::atomic<uint32_t> loopMaxUs{0};
+        std::atomic<uint32_t> decoderSyncAttempts{0};
+        std::atomic<uint32_t> reconnects{0};
+        std::atomic<uint32_t> eventsDropped{0};
+        std::atomic<uint32_t> inputBytesPerSecond{0};
+        std::atomic<uint32_t> outputBytesPerSecond{0};
+        std::atomic<uint64_t> loopTotalUs{0};
+        std::atomic<uint32_t> loopCount{0};
+    };
+    StatsCounters _stats; // counters survive stopSong(), only resetStats() clears them
+    unsigned long _underrunStartMS = 0;
+    unsigned long _statsRateMS = 0;   // start of the current rate window
+    uint64_t _statsRateReceived = 0;  // bytesReceived at the start of the rate window
+    uint64_t _statsRateDecoded = 0;   // bytesDecoded at the start of the rate window
+    void _updateStatsRates();
+    void _loop();
+
     const char *CONTENT_TYPE = "Content-Type";
     const char *ICY_NAME = "icy-name";
     const char *ICY_METAINT = "icy-metaint";
     const char *ENCODING = "Transfer-Encoding";
     const char *LOCATION = "Location";
+    const char *ICY_BR = "icy-br";
+    const char *ETAG = "ETag";
+    const char *LAST_MODIFIED = "Last-Modified";
 
-    const char *_header[5] =
+    const char *_header[8] =
         {CONTENT_TYPE,
          ICY_NAME,
          ICY_METAINT,
          ENCODING,
-         LOCATION};
+         LOCATION,
+         ICY_BR,
+         ETAG,
+         LAST_MODIFIED};
 
     const char *ERROR_HTTP_ERROR = "Http create error";
     const char *ERROR_SYSTEM_ERROR = "System error";
@@ -214,14 +841,15 @@ private:
     const char *ERROR_REDIRECTING = "Redirection error";
     const char *ERROR_PLAYLIST_EMPTY = "No url found";
     const char *ERROR_RINGBUFFER_EMPTY = "Ringbuffer empty";
-    const char *ERROR_RINGBUFFER_FAIL = "Ringbuffer error";
     const char *ERROR_CONNECTION_LOST = "Connection lost";
     const char *ERROR_STREAM_TIMEOUT = "Stream timeout";
     const char *ERROR_COULD_NOT_OPEN = "Could not open";
     const char *ERROR_NOT_PLAYABLE = "Not playable";
     const char *ERROR_HLS_UNSUPPORTED = "HLS streams not supported";
+    const char *ERROR_HLS_PLAYLIST = "Invalid HLS playlist";
     const char *ERROR_OUT_OF_RANGE = "Out of range offset";
     const char *ERROR_FILE_IO = "File i/o error";
+    const char *ERROR_RECORDING = "Recording error";
 };
 
 #endif
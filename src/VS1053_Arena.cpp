@@ -0,0 +1,38 @@
+#include "VS1053_Arena.h"
+
+VS1053_Arena::VS1053_Arena(uint8_t *memory, const size_t size, const size_t blockSize)
+    : _memory(memory), _blockSize(blockSize),
+      _blocks((memory && blockSize) ? min(size / blockSize, MAX_BLOCKS) : 0)
+{
+}
+
+uint8_t *VS1053_Arena::acquire()
+{
+    uint32_t used = _used.load();
+    while (true)
+    {
+        size_t block = 0;
+        while (block < _blocks && (used & (1UL << block)))
+            block++;
+
+        if (block == _blocks)
+            return nullptr;
+
+        // a failed exchange reloads used, another task took a block first
+        if (_used.compare_exchange_weak(used, used | (1UL << block)))
+            return _memory + block * _blockSize;
+    }
+}
+
+void VS1053_Arena::release(uint8_t *block)
+{
+    if (block < _memory || block >= _memory + _blocks * _blockSize)
+        return;
+
+    _used.fetch_and(~(1UL << ((block - _memory) / _blockSize)));
+}
+
+size_t VS1053_Arena::blocksFree() const
+{
+    return _blocks - __builtin_popcount(_used.load());
+}
@@ -0,0 +1,36 @@
+#ifndef __VS1053_Arena__
+#define __VS1053_Arena__
+
+#include <Arduino.h>
+#include <atomic>
+
+/*  Hands out fixed size blocks from memory supplied by the application.
+    Several decoders can share one arena, a block is only taken while its decoder plays.
+    acquire() and release() are lock free and can be called from any task. */
+
+class VS1053_Arena
+{
+
+public:
+    static constexpr size_t MAX_BLOCKS = 32;
+
+    VS1053_Arena(uint8_t *memory, const size_t size, const size_t blockSize);
+
+    VS1053_Arena(const VS1053_Arena &) = delete;
+    VS1053_Arena &operator=(const VS1053_Arena &) = delete;
+
+    uint8_t *acquire();
+    void release(uint8_t *block);
+
+    size_t blockSize() const { return _blockSize; }
+    size_t blocks() const { return _blocks; }
+    size_t blocksFree() const;
+
+private:
+    uint8_t *const _memory;
+    const size_t _blockSize;
+    const size_t _blocks;
+    std::atomic<uint32_t> _used{0}; // one bit per block
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include "VS1053_Ringbuffer.h"
+
+VS1053_Ringbuffer::~VS1053_Ringbuffer()
+{
+    release();
+}
+
+bool VS1053_Ringbuffer::allocate(const size_t capacity, const uint32_t caps)
+{
+    if (_storage)
+    {
+        log_e("Ringbuffer already allocated");
+        return false;
+    }
+
+    if (!capacity)
+        return false;
+
+    _storage = (uint8_t *)heap_caps_malloc(sizeof(uint8_t) * capacity, caps);
+    if (!_storage)
+        return false;
+
+    _capacity = capacity;
+    clear();
+    return true;
+}
+
+void VS1053_Ringbuffer::release()
+{
+    heap_caps_free(_storage);
+    _storage = nullptr;
+    _capacity = 0;
+    clear();
+}
+
+void VS1053_Ringbuffer::clear()
+{
+    _head = 0;
+    _tail = 0;
+    _written = 0;
+    _read = 0;
+    _used.store(0);
+}
+
+uint8_t *VS1053_Ringbuffer::acquireWrite(size_t &len)
+{
+    const size_t space = free();
+    len = min(space, _capacity - _head);
+    return len ? _storage + _head : nullptr;
+}
+
+void VS1053_Ringbuffer::commitWrite(const size_t len)
+{
+    _head = (_head + len) % _capacity;
+    _written += len;
+    _used.fetch_add(len);
+}
+
+uint8_t *VS1053_Ringbuffer::acquireRead(size_t &len)
+{
+    const size_t data = used();
+    len = min(data, _capacity - _tail);
+    return len ? _storage + _tail : nullptr;
+}
+
+void VS1053_Ringbuffer::commitRead(const size_t len)
+{
+    _tail = (_tail + len) % _capacity;
+    _read += len;
+    _used.fetch_sub(len);
+}
+
+size_t VS1053_Ringbuffer::rewind(size_t len)
+{
+    // read bytes stay in the free space until the producer writes over them
+    len = min(len, min(free(), _read));
+    _tail = (_tail + _capacity - len) % _capacity;
+    _read -= len;
+    _used.fetch_add(len);
+    return len;
+}
@@ -0,0 +1,53 @@
+#ifndef __VS1053_Ringbuffer__
+#define __VS1053_Ringbuffer__
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_heap_caps.h>
+
+/*  Single producer/single consumer byte ringbuffer.
+    Data is written and read in place: acquire a contiguous span, use it, then commit the number of bytes used.
+    clear(), release() and rewind() are not thread safe and should only be called when both sides are idle. */
+
+class VS1053_Ringbuffer
+{
+
+public:
+    VS1053_Ringbuffer() = default;
+    ~VS1053_Ringbuffer();
+
+    VS1053_Ringbuffer(const VS1053_Ringbuffer &) = delete;
+    VS1053_Ringbuffer &operator=(const VS1053_Ringbuffer &) = delete;
+
+    bool allocate(const size_t capacity, const uint32_t caps);
+    void release();
+    void clear();
+
+    bool allocated() const { return _storage != nullptr; }
+    size_t capacity() const { return _capacity; }
+    size_t used() const { return _used.load(); }
+    size_t free() const { return _capacity - _used.load(); }
+    size_t totalWritten() const { return _written; } // producer side running byte count
+    size_t totalRead() const { return _read; }       // consumer side running byte count
+
+    uint8_t *acquireWrite(size_t &len);
+    void commitWrite(const size_t len);
+
+    uint8_t *acquireRead(size_t &len);
+    void commitRead(const size_t len);
+
+    // gives back up to len read bytes that are still in the free space, returns how many
+    // both sides must be stopped or a write lands on the bytes given back: hold _sourceMutex and _decoderMutex
+    size_t rewind(size_t len);
+
+private:
+    uint8_t *_storage = nullptr;
+    size_t _capacity = 0;
+    size_t _head = 0; // write index, only touched by the producer
+    size_t _tail = 0; // read index, only touched by the consumer
+    size_t _written = 0;
+    size_t _read = 0;
+    std::atomic<size_t> _used{0};
+};
+
+#endif
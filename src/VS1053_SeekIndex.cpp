@@ -0,0 +1,496 @@
+#include "VS1053_SeekIndex.h"
+#include "VS1053_Sniffer.h"
+
+static uint16_t _be16(const uint8_t *p) { return p[0] << 8 | p[1]; }
+static uint32_t _be24(const uint8_t *p) { return p[0] << 16 | p[1] << 8 | p[2]; }
+static uint32_t _be32(const uint8_t *p) { return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+static uint64_t _be64(const uint8_t *p) { return (uint64_t)_be32(p) << 32 | _be32(p + 4); }
+static uint16_t _le16(const uint8_t *p) { return p[1] << 8 | p[0]; }
+static uint32_t _le32(const uint8_t *p) { return (uint32_t)p[3] << 24 | p[2] << 16 | p[1] << 8 | p[0]; }
+static uint32_t _synchsafe(const uint8_t *p) { return (p[0] & 0x7F) << 21 | (p[1] & 0x7F) << 14 | (p[2] & 0x7F) << 7 | (p[3] & 0x7F); }
+
+void VS1053_SeekIndex::clear()
+{
+    _format = FORMAT_NONE;
+    _fileSize = 0;
+    _dataStart = 0;
+    _dataEnd = 0;
+    _durationMs = 0;
+    _bytesPerSecond = 0;
+    _blockAlign = 1;
+    _sampleRate = 0;
+    _blockSize = 0;
+    _pointCount = 0;
+}
+
+bool VS1053_SeekIndex::build(const reader_t &read, const size_t fileSize, uint8_t *scratch, const size_t scratchSize)
+{
+    clear();
+    _fileSize = fileSize;
+    _dataEnd = fileSize;
+
+    size_t start = 0;
+    size_t len = read(0, scratch, scratchSize);
+
+    // skip id3v2 tags, a tag with cover art is often larger than the scratch buffer
+    while (len >= 10 && !memcmp(scratch, "ID3", 3))
+    {
+        start += 10 + _synchsafe(scratch + 6) + ((scratch[5] & 0x10) ? 10 : 0);
+        len = (start < fileSize) ? read(start, scratch, scratchSize) : 0;
+    }
+
+    if (len < 12)
+        return false;
+
+    bool success = false;
+    if (!memcmp(scratch, "fLaC", 4))
+        success = _parseFlac(read, start, scratch, scratchSize);
+    else if (!memcmp(scratch, "RIFF", 4) && !memcmp(scratch + 8, "WAVE", 4))
+        success = _parseWav(read, scratch, scratchSize);
+    else
+        success = _parseMpeg(start, scratch, len);
+
+    if (!success)
+    {
+        clear();
+        return false;
+    }
+
+    log_d("seek index: %lu ms, data %zu-%zu, %zu points", (unsigned long)_durationMs, _dataStart, _dataEnd, _pointCount);
+    return true;
+}
+
+bool VS1053_SeekIndex::_parseMpeg(const size_t start, const uint8_t *data, const size_t len)
+{
+    for (size_t i = 0; i + 8 <= len; i++)
+    {
+        if (data[i] != 0xFF)
+            continue;
+
+        if ((data[i + 1] & 0xF6) == 0xF0)
+        {
+            if (_parseAdts(start + i, data + i, len - i))
+                return true;
+        }
+        else if (_parseMp3(start + i, data + i, len - i))
+            return true;
+    }
+    return false;
+}
+
+bool VS1053_SeekIndex::_parseMp3(const size_t start, const uint8_t *data, const size_t len)
+{
+    size_t frameLength;
+    uint32_t kbps, rate;
+    uint16_t samples;
+    uint8_t sideInfo;
+    if (!VS1053_Sniffer::mp3Header(data, frameLength, kbps, rate, samples, sideInfo))
+        return false;
+
+    // the next frame header confirms the sync
+    size_t nextLength;
+    uint32_t nextKbps, nextRate;
+    uint16_t nextSamples;
+    uint8_t nextSideInfo;
+    if (frameLength + 4 > len ||
+        !VS1053_Sniffer::mp3Header(data + frameLength, nextLength, nextKbps, nextRate, nextSamples, nextSideInfo) || nextRate != rate)
+        return false;
+
+    _dataStart = start;
+
+    const uint8_t *xing = data + 4 + sideInfo;
+    if ((size_t)sideInfo + 20 <= len && (!memcmp(xing, "Xing", 4) || !memcmp(xing, "Info", 4)))
+    {
+        const uint32_t flags = _be32(xing + 4);
+        const uint8_t *field = xing + 8;
+        const uint32_t frames = (flags & 0x01) ? _be32(field) : 0;
+        field += (flags & 0x01) ? 4 : 0;
+        const uint32_t bytes = (flags & 0x02) ? _be32(field) : _dataEnd - _dataStart;
+        field += (flags & 0x02) ? 4 : 0;
+
+        if (frames && bytes)
+        {
+            _durationMs = (uint64_t)frames * samples * 1000 / rate;
+
+            if ((flags & 0x04) && field + 100 <= data + len)
+            {
+                for (size_t i = 0; i < 100; i++)
+                    _addPoint(_durationMs * i / 100, _dataStart + (uint64_t)field[i] * bytes / 256);
+                _format = FORMAT_TABLE;
+                return true;
+            }
+
+            _bytesPerSecond = (uint64_t)bytes * 1000 / max(_durationMs, (uint32_t)1);
+            _format = FORMAT_CBR;
+            return true;
+        }
+    }
+
+    const uint8_t *vbri = data + 36;
+    if (36 + 26 <= len && !memcmp(vbri, "VBRI", 4))
+    {
+        const uint32_t frames = _be32(vbri + 14);
+        const uint16_t entries = _be16(vbri + 18);
+        const uint16_t scale = _be16(vbri + 20);
+        const uint16_t entrySize = _be16(vbri + 22);
+        const uint16_t framesPerEntry = _be16(vbri + 24);
+        const uint8_t *toc = vbri + 26;
+
+        if (frames && entrySize >= 1 && entrySize <= 4 && toc + entries * entrySize <= data + len)
+        {
+            _durationMs = (uint64_t)frames * samples * 1000 / rate;
+
+            const size_t step = entries / MAX_POINTS + 1;
+            size_t offset = _dataStart;
+            for (size_t i = 0; i < entries; i++)
+            {
+                if (i % step == 0)
+                    _addPoint((uint64_t)i * framesPerEntry * samples * 1000 / rate, offset);
+
+                uint32_t entry = 0;
+                for (size_t b = 0; b < entrySize; b++)
+                    entry = entry << 8 | toc[i * entrySize + b];
+                offset += entry * scale;
+            }
+            _format = FORMAT_TABLE;
+            return true;
+        }
+    }
+
+    // no table so assume a constant bitrate
+    _bytesPerSecond = kbps * 125;
+    _durationMs = (uint64_t)(_dataEnd - _dataStart) * 1000 / _bytesPerSecond;
+    _format = FORMAT_CBR;
+    return true;
+}
+
+bool VS1053_SeekIndex::_parseAdts(const size_t start, const uint8_t *data, const size_t len)
+{
+    // adts has no bitrate field, so the average of the frames in the scratch buffer is used
+    size_t frames = 0;
+    size_t bytes = 0;
+    uint64_t samples = 0;
+    uint32_t rate = 0;
+
+    size_t position = 0;
+    while (position + 7 <= len)
+    {
+        size_t frameLength;
+        uint32_t frameRate;
+        uint16_t frameSamples;
+        if (!VS1053_Sniffer::adtsHeader(data + position, frameLength, frameRate, frameSamples) || (frames && frameRate != rate))
+            break;
+
+        rate = frameRate;
+        frames++;
+        bytes += frameLength;
+        samples += frameSamples;
+        position += frameLength;
+    }
+
+    if (frames < 2)
+        return false;
+
+    _dataStart = start;
+    _bytesPerSecond = (uint64_t)bytes * rate / samples;
+    _durationMs = (uint64_t)(_dataEnd - _dataStart) * 1000 / max(_bytesPerSecond, (uint32_t)1);
+    _format = FORMAT_CBR;
+    return true;
+}
+
+bool VS1053_SeekIndex::_parseWav(const reader_t &read, uint8_t *scratch, const size_t scratchSize)
+{
+    size_t position = 12; // skip RIFF header
+    while (position + 8 <= _fileSize)
+    {
+        const size_t len = read(position, scratch, min(scratchSize, (size_t)24));
+        if (len < 8)
+            return false;
+
+        const uint32_t chunkSize = _le32(scratch + 4);
+
+        if (!memcmp(scratch, "fmt ", 4))
+        {
+            if (len < 22)
+                return false;
+            _bytesPerSecond = _le32(scratch + 16);
+            _blockAlign = max(_le16(scratch + 20), (uint16_t)1);
+        }
+        else if (!memcmp(scratch, "data", 4))
+        {
+            if (!_bytesPerSecond)
+                return false;
+
+            _dataStart = position + 8;
+            _dataEnd = min(_dataStart + chunkSize, _fileSize);
+            _durationMs = (uint64_t)(_dataEnd - _dataStart) * 1000 / _bytesPerSecond;
+            _format = FORMAT_CBR;
+            return true;
+        }
+
+        position += 8 + chunkSize + (chunkSize & 1); // chunks are word aligned
+    }
+    return false;
+}
+
+bool VS1053_SeekIndex::_parseFlac(const reader_t &read, const size_t start, uint8_t *scratch, const size_t scratchSize)
+{
+    uint64_t totalSamples = 0;
+    size_t seekTable = 0;
+    size_t seekTableLength = 0;
+
+    size_t position = start + 4;
+    bool last = false;
+    while (!last)
+    {
+        if (read(position, scratch, 4) != 4)
+            return false;
+
+        last = scratch[0] & 0x80;
+        const uint8_t type = scratch[0] & 0x7F;
+        const size_t length = _be24(scratch + 1);
+        const size_t body = position + 4;
+
+        if (type == 0) // STREAMINFO
+        {
+            if (length < 18 || read(body, scratch, 18) != 18)
+                return false;
+
+            _blockSize = (_be16(scratch) == _be16(scratch + 2)) ? _be16(scratch) : 0;
+            _sampleRate = scratch[10] << 12 | scratch[11] << 4 | scratch[12] >> 4;
+            totalSamples = (uint64_t)(scratch[13] & 0x0F) << 32 | _be32(scratch + 14);
+        }
+        else if (type == 3) // SEEKTABLE
+        {
+            seekTable = body;
+            seekTableLength = length;
+        }
+        position = body + length;
+    }
+
+    if (!_sampleRate)
+        return false;
+
+    _dataStart = position;
+    if (totalSamples)
+        _durationMs = totalSamples * 1000 / _sampleRate;
+
+    // seek point offsets are relative to the first frame, placeholders sort last
+    const size_t count = seekTableLength / 18;
+    const size_t step = count / MAX_POINTS + 1;
+    const size_t perRead = scratchSize / 18;
+    for (size_t i = 0; i < count; i += perRead)
+    {
+        const size_t points = min(perRead, count - i);
+        if (read(seekTable + i * 18, scratch, points * 18) != points * 18)
+            break;
+
+        for (size_t j = 0; j < points; j++)
+        {
+            const uint8_t *point = scratch + j * 18;
+            if ((i + j) % step || _be64(point) == UINT64_MAX)
+                continue;
+            _addPoint(_be64(point) * 1000 / _sampleRate, _dataStart + _be64(point + 8));
+        }
+    }
+
+    _format = FORMAT_FLAC;
+    return true;
+}
+
+void VS1053_SeekIndex::_addPoint(const uint32_t ms, const size_t offset)
+{
+    if (_pointCount < MAX_POINTS)
+        _points[_pointCount++] = {ms, (uint32_t)offset};
+}
+
+bool VS1053_SeekIndex::offsetFor(const reader_t &read, const uint32_t ms, uint8_t *scratch, const size_t scratchSize,
+                                 size_t &offset)
+{
+    if (!valid() || (_durationMs && ms >= _durationMs))
+        return false;
+
+    switch (_format)
+    {
+    case FORMAT_TABLE:
+    {
+        size_t i = 0;
+        while (i + 1 < _pointCount && _points[i + 1].ms <= ms)
+            i++;
+
+        const SeekPoint from = _points[i];
+        const SeekPoint to = (i + 1 < _pointCount) ? _points[i + 1] : SeekPoint{_durationMs, (uint32_t)_dataEnd};
+
+        offset = from.offset;
+        if (to.ms > from.ms && to.offset > from.offset)
+            offset += (uint64_t)(ms - from.ms) * (to.offset - from.offset) / (to.ms - from.ms);
+        return offset < _dataEnd;
+    }
+
+    case FORMAT_CBR:
+        offset = _dataStart + (uint64_t)ms * _bytesPerSecond / 1000;
+        offset -= (offset - _dataStart) % _blockAlign;
+        return offset < _dataEnd;
+
+    case FORMAT_FLAC:
+    {
+        // narrow the search to the seek points around the target
+        size_t low = _dataStart;
+        size_t high = _dataEnd;
+        for (size_t i = 0; i < _pointCount; i++)
+        {
+            if (_points[i].ms > ms)
+            {
+                high = min(high, (size_t)_points[i].offset);
+                break;
+            }
+            low = max(low, (size_t)_points[i].offset);
+        }
+
+        offset = _flacSeek(read, (uint64_t)ms * _sampleRate / 1000, low, high, scratch, scratchSize);
+        return true;
+    }
+    }
+    return false;
+}
+
+uint32_t VS1053_SeekIndex::msAt(const size_t offset) const
+{
+    if (!valid() || offset <= _dataStart || _dataEnd <= _dataStart)
+        return 0;
+
+    if (_format == FORMAT_CBR)
+        return (uint64_t)(offset - _dataStart) * 1000 / _bytesPerSecond;
+
+    if (_format == FORMAT_TABLE)
+    {
+        size_t i = 0;
+        while (i + 1 < _pointCount && _points[i + 1].offset <= offset)
+            i++;
+
+        const SeekPoint from = _points[i];
+        const SeekPoint to = (i + 1 < _pointCount) ? _points[i + 1] : SeekPoint{_durationMs, (uint32_t)_dataEnd};
+        if (to.offset <= from.offset || offset <= from.offset)
+            return from.ms;
+        return from.ms + (uint64_t)(min(offset, (size_t)to.offset) - from.offset) * (to.ms - from.ms) / (to.offset - from.offset);
+    }
+
+    return (uint64_t)(min(offset, _dataEnd) - _dataStart) * _durationMs / (_dataEnd - _dataStart);
+}
+
+bool VS1053_SeekIndex::_flacFrame(const uint8_t *data, const size_t len, uint64_t &sample) const
+{
+    if (len < 6 || data[0] != 0xFF || (data[1] & 0xFE) != 0xF8)
+        return false;
+
+    const bool variable = data[1] & 0x01;
+    const uint8_t blockCode = data[2] >> 4;
+    const uint8_t rateCode = data[2] & 0x0F;
+    const uint8_t channels = data[3] >> 4;
+    const uint8_t sizeCode = (data[3] >> 1) & 0x07;
+    if (!blockCode || rateCode == 0x0F || channels > 10 || sizeCode == 3 || sizeCode == 7 || (data[3] & 0x01))
+        return false;
+
+    // utf-8 coded frame or sample number
+    uint64_t number = data[4];
+    uint8_t extra = 0;
+    if (number & 0x80)
+    {
+        uint8_t mask = 0x40;
+        while (number & mask)
+        {
+            extra++;
+            mask >>= 1;
+        }
+        if (!extra || extra > 6)
+            return false;
+        number &= mask - 1;
+    }
+
+    size_t position = 5;
+    if (position + extra > len)
+        return false;
+
+    for (uint8_t i = 0; i < extra; i++)
+    {
+        if ((data[position] & 0xC0) != 0x80)
+            return false;
+        number = number << 6 | (data[position++] & 0x3F);
+    }
+
+    position += (blockCode == 6) ? 1 : (blockCode == 7) ? 2 : 0;
+    position += (rateCode == 12) ? 1 : (rateCode == 13 || rateCode == 14) ? 2 : 0;
+    if (position >= len)
+        return false;
+
+    uint8_t crc = 0;
+    for (size_t i = 0; i < position; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    if (crc != data[position])
+        return false;
+
+    if (!variable && !_blockSize)
+        return false;
+
+    sample = variable ? number : number * _blockSize;
+    return true;
+}
+
+bool VS1053_SeekIndex::_flacFrameAt(const reader_t &read, const size_t from, const size_t to, uint8_t *scratch,
+                                    const size_t scratchSize, size_t &position, uint64_t &sample) const
+{
+    constexpr size_t MAX_HEADER = 16;
+    constexpr uint8_t MAX_WINDOWS = 8;
+
+    size_t window = from;
+    for (uint8_t i = 0; i < MAX_WINDOWS && window < to; i++)
+    {
+        const size_t len = read(window, scratch, scratchSize);
+        if (len <= MAX_HEADER)
+            return false;
+
+        for (size_t j = 0; j < len - MAX_HEADER && window + j < to; j++)
+        {
+            if (scratch[j] == 0xFF && _flacFrame(scratch + j, len - j, sample))
+            {
+                position = window + j;
+                return true;
+            }
+        }
+
+        // overlap so a header on the border is not missed
+        window += len - MAX_HEADER;
+    }
+    return false;
+}
+
+size_t VS1053_SeekIndex::_flacSeek(const reader_t &read, const uint64_t target, size_t low, size_t high,
+                                   uint8_t *scratch, const size_t scratchSize) const
+{
+    size_t position;
+    uint64_t sample;
+
+    // low always is a frame start at or before the target
+    while (high - low > scratchSize)
+    {
+        const size_t middle = low + (high - low) / 2;
+        if (!_flacFrameAt(read, middle, high, scratch, scratchSize, position, sample) || sample > target)
+            high = middle;
+        else
+            low = position;
+    }
+
+    // the last frame that starts at or before the target
+    size_t best = low;
+    size_t from = low + 1;
+    while (_flacFrameAt(read, from, high, scratch, scratchSize, position, sample) && sample <= target)
+    {
+        best = position;
+        from = position + 1;
+    }
+    return best;
+}
@@ -0,0 +1,73 @@
+#ifndef __VS1053_SeekIndex__
+#define __VS1053_SeekIndex__
+
+#include <Arduino.h>
+#include <functional>
+
+/*  Maps a play time to a byte offset in an audio file.
+    The index is built from the file header: mp3 Xing/Info and VBRI tables, flac STREAMINFO and SEEKTABLE,
+    wav data chunks, and the frame headers of constant bitrate mp3 and aac adts.
+    Flac files are bisected on frame sample numbers between seek points.
+    All file access goes through a reader so the same code serves local files and http range requests. */
+
+class VS1053_SeekIndex
+{
+
+public:
+    typedef std::function<size_t(size_t offset, uint8_t *data, size_t len)> reader_t;
+
+    static constexpr size_t MAX_POINTS = 100;
+
+    bool build(const reader_t &read, const size_t fileSize, uint8_t *scratch, const size_t scratchSize);
+    void clear();
+
+    bool valid() const { return _format != FORMAT_NONE; }
+    uint32_t durationMs() const { return _durationMs; }
+    size_t dataStart() const { return _dataStart; }
+    size_t dataEnd() const { return _dataEnd; }
+
+    bool offsetFor(const reader_t &read, const uint32_t ms, uint8_t *scratch, const size_t scratchSize, size_t &offset);
+    uint32_t msAt(const size_t offset) const;
+
+private:
+    enum Format
+    {
+        FORMAT_NONE,
+        FORMAT_TABLE, // vbr mp3 with a toc
+        FORMAT_CBR,   // constant bytes per second: cbr mp3, aac adts, wav
+        FORMAT_FLAC
+    };
+
+    struct SeekPoint
+    {
+        uint32_t ms;
+        uint32_t offset;
+    };
+
+    uint8_t _format = FORMAT_NONE;
+    size_t _fileSize = 0;
+    size_t _dataStart = 0;
+    size_t _dataEnd = 0;
+    uint32_t _durationMs = 0;
+    uint32_t _bytesPerSecond = 0;
+    uint16_t _blockAlign = 1;
+    uint32_t _sampleRate = 0;
+    uint16_t _blockSize = 0; // flac fixed block size, 0 when variable
+    SeekPoint _points[MAX_POINTS];
+    size_t _pointCount = 0;
+
+    bool _parseMpeg(const size_t start, const uint8_t *data, const size_t len);
+    bool _parseMp3(const size_t start, const uint8_t *data, const size_t len);
+    bool _parseAdts(const size_t start, const uint8_t *data, const size_t len);
+    bool _parseWav(const reader_t &read, uint8_t *scratch, const size_t scratchSize);
+    bool _parseFlac(const reader_t &read, const size_t start, uint8_t *scratch, const size_t scratchSize);
+    void _addPoint(const uint32_t ms, const size_t offset);
+
+    bool _flacFrame(const uint8_t *data, const size_t len, uint64_t &sample) const;
+    bool _flacFrameAt(const reader_t &read, const size_t from, const size_t to, uint8_t *scratch,
+                      const size_t scratchSize, size_t &position, uint64_t &sample) const;
+    size_t _flacSeek(const reader_t &read, const uint64_t target, size_t low, size_t high,
+                     uint8_t *scratch, const size_t scratchSize) const;
+};
+
+#endif
@@ -0,0 +1,238 @@
+#include "VS1053_Sniffer.h"
+
+static uint32_t _synchsafe(const uint8_t *p) { return (p[0] & 0x7F) << 21 | (p[1] & 0x7F) << 14 | (p[2] & 0x7F) << 7 | (p[3] & 0x7F); }
+
+bool VS1053_Sniffer::mp3Header(const uint8_t *data, size_t &frameLength, uint32_t &kbps, uint32_t &rate,
+                               uint16_t &samples, uint8_t &sideInfo)
+{
+    static const uint16_t BITRATES[5][14] = {
+        {32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448}, // mpeg1 layer 1
+        {32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},    // mpeg1 layer 2
+        {32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},     // mpeg1 layer 3
+        {32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},    // mpeg2(.5) layer 1
+        {8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}};        // mpeg2(.5) layer 2 and 3
+    static const uint16_t RATES[3] = {44100, 48000, 32000};
+
+    if (data[0] != 0xFF || (data[1] & 0xE0) != 0xE0)
+        return false;
+
+    const uint8_t version = (data[1] >> 3) & 0x03; // 0 mpeg2.5, 2 mpeg2, 3 mpeg1
+    const uint8_t layer = (data[1] >> 1) & 0x03;   // 1 layer 3, 2 layer 2, 3 layer 1
+    const uint8_t bitrateIndex = data[2] >> 4;
+    const uint8_t rateIndex = (data[2] >> 2) & 0x03;
+    if (version == 1 || !layer || !bitrateIndex || bitrateIndex == 15 || rateIndex == 3)
+        return false;
+
+    const bool mpeg1 = version == 3;
+    const bool padding = (data[2] >> 1) & 0x01;
+    const bool mono = (data[3] >> 6) == 3;
+
+    kbps = BITRATES[mpeg1 ? 3 - layer : (layer == 3 ? 3 : 4)][bitrateIndex - 1];
+    rate = RATES[rateIndex] >> (mpeg1 ? 0 : version == 2 ? 1 : 2);
+
+    if (layer == 3)
+    {
+        samples = 384;
+        frameLength = (12 * kbps * 1000 / rate + padding) * 4;
+    }
+    else
+    {
+        samples = (layer == 1 && !mpeg1) ? 576 : 1152;
+        frameLength = samples / 8 * kbps * 1000 / rate + padding;
+    }
+    sideInfo = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+    return true;
+}
+
+bool VS1053_Sniffer::adtsHeader(const uint8_t *data, size_t &frameLength, uint32_t &rate, uint16_t &samples)
+{
+    static const uint32_t RATES[13] = {96000, 88200, 64000, 48000, 44100, 32000, 24000,
+                                       22050, 16000, 12000, 11025, 8000, 7350};
+
+    if (data[0] != 0xFF || (data[1] & 0xF6) != 0xF0)
+        return false;
+
+    const uint8_t rateIndex = (data[2] >> 2) & 0x0F;
+    if (rateIndex >= 13)
+        return false;
+
+    rate = RATES[rateIndex];
+    frameLength = (data[3] & 0x03) << 11 | data[4] << 3 | data[5] >> 5;
+    samples = 1024 * ((data[6] & 0x03) + 1);
+    return frameLength >= 7;
+}
+
+void VS1053_Sniffer::reset(const bool fromStart)
+{
+    _state = fromStart ? STATE_SNIFFING : STATE_IDLE;
+    _format = FORMAT_UNKNOWN;
+    _atStart = true;
+    _tagRemaining = 0;
+    _searched = 0;
+    _carryLen = 0;
+}
+
+size_t VS1053_Sniffer::sniff(uint8_t *data, const size_t len)
+{
+    if (_state != STATE_SNIFFING)
+        return len;
+
+    // a tag goes to the decoder untouched, the audio behind it is sniffed
+    const size_t tag = min(len, _tagRemaining);
+    _tagRemaining -= tag;
+    uint8_t *audio = data + tag;
+    const size_t size = len - tag;
+    if (!size)
+        return len;
+
+    if (_atStart)
+    {
+        if (size >= 10 && !memcmp(audio, "ID3", 3))
+        {
+            _tagRemaining = 10 + _synchsafe(audio + 6) + ((audio[5] & 0x10) ? 10 : 0);
+            return tag + sniff(audio, size);
+        }
+        _atStart = false;
+
+        _format = _magic(audio, size);
+        if (_format != FORMAT_UNKNOWN)
+        {
+            _state = STATE_DONE;
+            return len;
+        }
+
+        if (_isText(audio, size))
+        {
+            _state = STATE_REJECTED;
+            return tag;
+        }
+    }
+
+    Format format = FORMAT_UNKNOWN;
+    const size_t frame = _findFrame(audio, size, format);
+    if (frame == _carryLen + size)
+    {
+        _keepTail(audio, size);
+        _searched += size;
+        if (_searched >= MAX_SNIFF_BYTES)
+            _state = STATE_REJECTED;
+        return tag;
+    }
+
+    // a frame that started in the previous block goes on from its remainder, the decoder syncs on the next one
+    const size_t skip = frame > _carryLen ? frame - _carryLen : 0;
+    if (skip)
+        memmove(audio, audio + skip, size - skip);
+
+    _carryLen = 0;
+    _format = format;
+    _state = STATE_DONE;
+    return len - skip;
+}
+
+void VS1053_Sniffer::_keepTail(const uint8_t *data, const size_t len)
+{
+    // a header split over two blocks is found when the next one arrives
+    const size_t total = _carryLen + len;
+    const size_t keep = total < CARRY_BYTES ? total : CARRY_BYTES;
+    uint8_t tail[CARRY_BYTES];
+    for (size_t i = 0; i < keep; i++)
+        tail[i] = _at(data, total - keep + i);
+    memcpy(_carry, tail, keep);
+    _carryLen = keep;
+}
+
+VS1053_Sniffer::Format VS1053_Sniffer::_magic(const uint8_t *data, const size_t len) const
+{
+    static const uint8_t ASF_GUID[8] = {0x30, 0x26, 0xB2, 0x75, 0x8E, 0x66, 0xCF, 0x11};
+
+    if (len < 12)
+        return FORMAT_UNKNOWN;
+
+    if (!memcmp(data, "OggS", 4))
+        return FORMAT_OGG;
+    if (!memcmp(data, "fLaC", 4))
+        return FORMAT_FLAC;
+    if (!memcmp(data, "RIFF", 4) && !memcmp(data + 8, "WAVE", 4))
+        return FORMAT_WAV;
+    if (!memcmp(data + 4, "ftyp", 4))
+        return FORMAT_AAC_MP4;
+    if (!memcmp(data, "ADIF", 4))
+        return FORMAT_AAC_ADIF;
+    if (!memcmp(data, "MThd", 4))
+        return FORMAT_MIDI;
+    if (!memcmp(data, ASF_GUID, sizeof(ASF_GUID)))
+        return FORMAT_WMA;
+    return FORMAT_UNKNOWN;
+}
+
+bool VS1053_Sniffer::_isText(const uint8_t *data, const size_t len) const
+{
+    // an error page or a playlist served as audio
+    const size_t n = min(len, (size_t)64);
+    size_t printable = 0;
+    for (size_t i = 0; i < n; i++)
+        if (isprint(data[i]) || isspace(data[i]))
+            printable++;
+
+    return n >= 16 && (printable * 100) / n > 90;
+}
+
+uint8_t VS1053_Sniffer::_at(const uint8_t *data, const size_t index) const
+{
+    return index < _carryLen ? _carry[index] : data[index - _carryLen];
+}
+
+size_t VS1053_Sniffer::_findFrame(const uint8_t *data, const size_t len, Format &format) const
+{
+    // positions count from the bytes carried over from the previous block
+    const size_t total = _carryLen + len;
+    uint8_t header[HEADER_BYTES];
+
+    for (size_t i = 0; i + HEADER_BYTES <= total; i++)
+    {
+        const uint8_t first = _at(data, i);
+        if (first != 'O' && first != 0xFF)
+            continue;
+
+        for (size_t j = 0; j < HEADER_BYTES; j++)
+            header[j] = _at(data, i + j);
+
+        if (!memcmp(header, "OggS", 4))
+        {
+            format = FORMAT_OGG;
+            return i;
+        }
+
+        if (first != 0xFF)
+            continue;
+
+        const bool adts = (header[1] & 0xF6) == 0xF0;
+        size_t frameLength;
+        uint32_t kbps, rate;
+        uint16_t samples;
+        uint8_t sideInfo;
+        if (adts ? !adtsHeader(header, frameLength, rate, samples)
+                 : !mp3Header(header, frameLength, kbps, rate, samples, sideInfo))
+            continue;
+
+        // the next frame header confirms the sync, unless it is not received yet
+        const size_t next = i + frameLength;
+        if (next + HEADER_BYTES <= total)
+        {
+            for (size_t j = 0; j < HEADER_BYTES; j++)
+                header[j] = _at(data, next + j);
+
+            size_t nextLength;
+            uint32_t nextRate;
+            const bool confirmed = adts ? adtsHeader(header, nextLength, nextRate, samples)
+                                        : mp3Header(header, nextLength, kbps, nextRate, samples, sideInfo);
+            if (!confirmed || nextRate != rate)
+                continue;
+        }
+
+        format = adts ? FORMAT_AAC_ADTS : FORMAT_MP3;
+        return i;
+    }
+    return total;
+}
@@ -0,0 +1,69 @@
+#ifndef __VS1053_Sniffer__
+#define __VS1053_Sniffer__
+
+#include <Arduino.h>
+
+/*  Tells the audio format from the first received bytes, long before the decoder locks on.
+    Container formats are recognized by their magic number at the start of the data, mp3 and aac adts
+    by a frame header that is followed by a next one. An id3v2 tag in front of the audio is passed on.
+    Bytes in front of the first frame are dropped in place. Text and data without any frame are rejected. */
+
+class VS1053_Sniffer
+{
+
+public:
+    enum Format : uint8_t
+    {
+        FORMAT_UNKNOWN,
+        FORMAT_MP3,
+        FORMAT_AAC_ADTS,
+        FORMAT_AAC_ADIF,
+        FORMAT_AAC_MP4,
+        FORMAT_WAV,
+        FORMAT_WMA,
+        FORMAT_MIDI,
+        FORMAT_OGG,
+        FORMAT_FLAC
+    };
+
+    static constexpr size_t MAX_SNIFF_BYTES = 8192; // searched for a first frame before the data is rejected
+
+    void reset(const bool fromStart);
+    size_t sniff(uint8_t *data, const size_t len);
+
+    bool active() const { return _state == STATE_SNIFFING; }
+    bool rejected() const { return _state == STATE_REJECTED; }
+    Format format() const { return _format; }
+
+    static bool mp3Header(const uint8_t *data, size_t &frameLength, uint32_t &kbps, uint32_t &rate,
+                          uint16_t &samples, uint8_t &sideInfo);
+    static bool adtsHeader(const uint8_t *data, size_t &frameLength, uint32_t &rate, uint16_t &samples);
+
+private:
+    enum State : uint8_t
+    {
+        STATE_IDLE, // resumed or seeked data starts mid-frame, the decoder finds its own way in
+        STATE_SNIFFING,
+        STATE_DONE,
+        STATE_REJECTED
+    };
+
+    static constexpr size_t HEADER_BYTES = 7;                // an adts header, mp3 needs 4
+    static constexpr size_t CARRY_BYTES = HEADER_BYTES - 1; // a header starting here is not complete yet
+
+    uint8_t _state = STATE_IDLE;
+    Format _format = FORMAT_UNKNOWN;
+    bool _atStart = false;
+    size_t _tagRemaining = 0;
+    size_t _searched = 0;
+    uint8_t _carry[CARRY_BYTES];
+    size_t _carryLen = 0;
+
+    Format _magic(const uint8_t *data, const size_t len) const;
+    bool _isText(const uint8_t *data, const size_t len) const;
+    uint8_t _at(const uint8_t *data, const size_t index) const;
+    size_t _findFrame(const uint8_t *data, const size_t len, Format &format) const;
+    void _keepTail(const uint8_t *data, const size_t len);
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "VS1053_TsDemux.h"
+
+void VS1053_TsDemux::reset()
+{
+    _fill = 0;
+    _pmtPid = NULL_PID;
+    _audioPid = NULL_PID;
+}
+
+size_t VS1053_TsDemux::demux(uint8_t *data, const size_t len)
+{
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < len)
+    {
+        if (data[in] != SYNC_BYTE)
+        {
+            in++; // resync
+            continue;
+        }
+
+        if (len - in < PACKET_SIZE)
+        {
+            _fill = len - in;
+            memcpy(_packet, data + in, _fill);
+            break;
+        }
+
+        out += _parsePacket(data + in, data + out);
+        in += PACKET_SIZE;
+    }
+    return out;
+}
+
+size_t VS1053_TsDemux::complete(const size_t len)
+{
+    _fill += len;
+    if (_fill < PACKET_SIZE)
+        return 0;
+
+    _fill = 0;
+    return (_packet[0] == SYNC_BYTE) ? _parsePacket(_packet, _packet) : 0;
+}
+
+size_t VS1053_TsDemux::_parsePacket(const uint8_t *packet, uint8_t *out)
+{
+    const uint16_t pid = ((packet[1] & 0x1F) << 8) | packet[2];
+    const bool unitStart = packet[1] & 0x40;
+    const uint8_t adaptation = (packet[3] >> 4) & 0x03;
+
+    if (!(adaptation & 0x01)) // no payload
+        return 0;
+
+    size_t offset = 4;
+    if (adaptation & 0x02)
+        offset += 1 + packet[4];
+    if (offset >= PACKET_SIZE)
+        return 0;
+
+    const uint8_t *payload = packet + offset;
+    size_t len = PACKET_SIZE - offset;
+
+    if (pid == PAT_PID)
+    {
+        if (unitStart)
+            _parsePat(payload, len);
+        return 0;
+    }
+
+    if (_pmtPid != NULL_PID && pid == _pmtPid)
+    {
+        if (unitStart)
+            _parsePmt(payload, len);
+        return 0;
+    }
+
+    if (_audioPid == NULL_PID || pid != _audioPid)
+        return 0;
+
+    if (unitStart)
+    {
+        // skip the pes header
+        if (len < 9 || payload[0] || payload[1] || payload[2] != 0x01)
+            return 0;
+
+        const size_t header = 9 + payload[8];
+        if (header >= len)
+            return 0;
+
+        payload += header;
+        len -= header;
+    }
+
+    memmove(out, payload, len);
+    return len;
+}
+
+void VS1053_TsDemux::_parsePat(const uint8_t *payload, const size_t len)
+{
+    const size_t pointer = 1 + payload[0];
+    if (pointer + 8 > len)
+        return;
+
+    const uint8_t *section = payload + pointer;
+    if (section[0] != 0x00) // program association table
+        return;
+
+    const size_t sectionLength = ((section[1] & 0x0F) << 8) | section[2];
+    const size_t end = min(3 + sectionLength - 4, len - pointer); // minus crc
+
+    for (size_t i = 8; i + 4 <= end; i += 4)
+    {
+        const uint16_t program = (section[i] << 8) | section[i + 1];
+        if (!program) // network pid
+            continue;
+
+        _pmtPid = ((section[i + 2] & 0x1F) << 8) | section[i + 3];
+        return;
+    }
+}
+
+void VS1053_TsDemux::_parsePmt(const uint8_t *payload, const size_t len)
+{
+    const size_t pointer = 1 + payload[0];
+    if (pointer + 12 > len)
+        return;
+
+    const uint8_t *section = payload + pointer;
+    if (section[0] != 0x02) // program map table
+        return;
+
+    const size_t sectionLength = ((section[1] & 0x0F) << 8) | section[2];
+    const size_t end = min(3 + sectionLength - 4, len - pointer); // minus crc
+    const size_t programInfoLength = ((section[10] & 0x0F) << 8) | section[11];
+
+    for (size_t i = 12 + programInfoLength; i + 5 <= end;)
+    {
+        const uint8_t streamType = section[i];
+        const uint16_t pid = ((section[i + 1] & 0x1F) << 8) | section[i + 2];
+        const size_t infoLength = ((section[i + 3] & 0x0F) << 8) | section[i + 4];
+
+        // 0x0F aac adts, 0x03 mpeg-1 audio, 0x04 mpeg-2 audio
+        if (streamType == 0x0F || streamType == 0x03 || streamType == 0x04)
+        {
+            _audioPid = pid;
+            return;
+        }
+        i += 5 + infoLength;
+    }
+}
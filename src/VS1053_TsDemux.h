@@ -0,0 +1,39 @@
+#ifndef __VS1053_TsDemux__
+#define __VS1053_TsDemux__
+
+#include <Arduino.h>
+
+/*  Extracts the first audio elementary stream (aac adts or mpeg audio) from an mpeg transport stream.
+    Packets are demuxed in place. A packet that is cut off at the end of the data is kept until
+    the missing bytes are read into carry() and passed to complete(), which leaves the payload at payload(). */
+
+class VS1053_TsDemux
+{
+
+public:
+    static constexpr size_t PACKET_SIZE = 188;
+
+    void reset();
+    size_t demux(uint8_t *data, const size_t len);
+
+    size_t missing() const { return _fill ? PACKET_SIZE - _fill : 0; }
+    uint8_t *carry() { return _packet + _fill; }
+    size_t complete(const size_t len);
+    const uint8_t *payload() const { return _packet; }
+
+private:
+    static constexpr uint8_t SYNC_BYTE = 0x47;
+    static constexpr uint16_t PAT_PID = 0x0000;
+    static constexpr uint16_t NULL_PID = 0x1FFF;
+
+    uint8_t _packet[PACKET_SIZE];
+    size_t _fill = 0;
+    uint16_t _pmtPid = NULL_PID;
+    uint16_t _audioPid = NULL_PID;
+
+    size_t _parsePacket(const uint8_t *packet, uint8_t *out);
+    void _parsePat(const uint8_t *payload, const size_t len);
+    void _parsePmt(const uint8_t *payload, const size_t len);
+};
+
+#endif
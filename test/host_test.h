@@ -0,0 +1,317 @@
+#ifndef __HOST_TEST__
+#define __HOST_TEST__
+
+/*  Checks and helpers shared by the host tests. A test is a plain executable, ctest only looks at the
+    exit code, so a failed check prints where it failed and the test carries on to report the rest. */
+
+#include <ESP32_VS1053_Stream.h>
+#include <string>
+#include <vector>
+
+static int _hostFailures = 0;
+
+#define CHECK(condition)                                                            \
+    do                                                                              \
+    {                                                                               \
+        if (!(condition))                                                           \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            _hostFailures++;                                                        \
+        }                                                                           \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                              \
+    do                                                                                          \
+    {                                                                                           \
+        const auto _a = (actual);                                                               \
+        const auto _e = (expected);                                                             \
+        if (!(_a == _e))                                                                        \
+        {                                                                                       \
+            fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, \
+                    (long long)_a, (long long)_e);                                              \
+            _hostFailures++;                                                                    \
+        }                                                                                       \
+    } while (0)
+
+inline int hostTestResult(const char *name)
+{
+    fprintf(stderr, "%s: %s\n", name, _hostFailures ? "FAILED" : "passed");
+    return _hostFailures ? 1 : 0;
+}
+
+constexpr uint8_t HOST_CS = 5;
+constexpr uint8_t HOST_DCS = 16;
+constexpr uint8_t HOST_DREQ = 4;
+
+/* mpeg1 layer 3 frames at 44.1 kHz, the payload never holds a sync word so only the headers sync */
+inline std::string hostMp3(const size_t frames, const uint32_t kbps = 128)
+{
+    static const uint16_t BITRATES[] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+    uint8_t index = 9;
+    for (uint8_t i = 1; i < sizeof(BITRATES) / sizeof(BITRATES[0]); i++)
+        if (BITRATES[i] == kbps)
+            index = i;
+
+    const size_t length = 144 * BITRATES[index] * 1000 / 44100;
+    std::string audio;
+    uint32_t seed = 1;
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+        audio += char(0xFF);
+        audio += char(0xFB);
+        audio += char(index << 4);
+        audio += char(0x44);
+        for (size_t i = 4; i < length; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            audio += char((seed >> 16) & 0x7F);
+        }
+    }
+    return audio;
+}
+
+/* filler that never holds a sync byte, so only the headers written around it sync */
+inline void hostPayload(std::string &out, const size_t len, uint32_t &seed)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        out += char((seed >> 16) & 0x7F);
+    }
+}
+
+/* aac adts frames at 44.1 kHz stereo */
+inline std::string hostAdts(const size_t frames, const size_t frameLength = 372)
+{
+    std::string audio;
+    uint32_t seed = 7;
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+        const uint8_t header[7] = {0xFF, 0xF1, 0x50, uint8_t(0x80 | frameLength >> 11),
+                                   uint8_t(frameLength >> 3), uint8_t((frameLength & 0x07) << 5 | 0x1F), 0xFC};
+        audio.append(reinterpret_cast<const char *>(header), sizeof(header));
+        hostPayload(audio, frameLength - sizeof(header), seed);
+    }
+    return audio;
+}
+
+inline void hostLe(std::string &out, const uint32_t value, const size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+        out += char(value >> (8 * i));
+}
+
+inline void hostBe(std::string &out, const uint64_t value, const size_t bytes)
+{
+    for (size_t i = bytes; i > 0; i--)
+        out += char(value >> (8 * (i - 1)));
+}
+
+/* 16 bit stereo pcm at 44.1 kHz, 176400 bytes per second */
+inline std::string hostWav(const size_t dataBytes)
+{
+    std::string wav = "RIFF";
+    hostLe(wav, 36 + dataBytes, 4);
+    wav += "WAVEfmt ";
+    hostLe(wav, 16, 4);
+    hostLe(wav, 1, 2);          // pcm
+    hostLe(wav, 2, 2);          // channels
+    hostLe(wav, 44100, 4);      // sample rate
+    hostLe(wav, 44100 * 4, 4);  // bytes per second
+    hostLe(wav, 4, 2);          // block align
+    hostLe(wav, 16, 2);         // bits per sample
+    wav += "data";
+    hostLe(wav, dataBytes, 4);
+    uint32_t seed = 3;
+    hostPayload(wav, dataBytes, seed);
+    return wav;
+}
+
+inline uint8_t hostCrc8(const uint8_t *data, const size_t len)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+/* flac with a fixed block size of 4096 samples at 44.1 kHz and, when asked, a seek point every 16 frames */
+inline std::string hostFlac(const size_t frames, const size_t frameBytes = 2000, const bool seekTable = true)
+{
+    constexpr uint32_t BLOCK = 4096;
+    const size_t points = seekTable ? (frames + 15) / 16 : 0;
+
+    std::string flac = "fLaC";
+    flac += char(points ? 0x00 : 0x80); // STREAMINFO, the last block without a seek table
+    hostBe(flac, 34, 3);
+    hostBe(flac, BLOCK, 2);
+    hostBe(flac, BLOCK, 2);
+    hostBe(flac, 0, 3);
+    hostBe(flac, 0, 3);
+    const uint64_t samples = (uint64_t)frames * BLOCK;
+    hostBe(flac, (uint64_t)44100 << 44 | (uint64_t)1 << 41 | (uint64_t)15 << 36 | samples, 8);
+    flac.append(16, '\0'); // md5
+
+    if (points)
+    {
+        flac += char(0x83); // SEEKTABLE, last
+        hostBe(flac, points * 18, 3);
+        for (size_t i = 0; i < points; i++)
+        {
+            hostBe(flac, (uint64_t)i * 16 * BLOCK, 8);
+            hostBe(flac, (uint64_t)i * 16 * frameBytes, 8);
+            hostBe(flac, BLOCK, 2);
+        }
+    }
+
+    uint32_t seed = 5;
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+        std::string header;
+        header += char(0xFF);
+        header += char(0xF8);
+        header += char(0xC9); // 4096 samples, 44.1 kHz
+        header += char(0x18); // left/side stereo, 16 bit
+        if (frame < 0x80)
+            header += char(frame);
+        else
+        {
+            header += char(0xC0 | frame >> 6);
+            header += char(0x80 | (frame & 0x3F));
+        }
+        header += char(hostCrc8(reinterpret_cast<const uint8_t *>(header.data()), header.size()));
+        flac += header;
+        hostPayload(flac, frameBytes - header.size(), seed);
+    }
+    return flac;
+}
+
+/* interleaves icy metadata after every metaint bytes of audio, a title is only sent when it changes */
+inline std::string hostIcy(const std::string &audio, const size_t metaint, const std::vector<std::string> &titles)
+{
+    std::string body;
+    size_t block = 0;
+    for (size_t pos = 0; pos < audio.size(); pos += metaint)
+    {
+        body += audio.substr(pos, metaint);
+        if (pos + metaint > audio.size())
+            break;
+
+        const size_t index = block++;
+        if (index % 2 || index / 2 >= titles.size())
+        {
+            body += char(0);
+            continue;
+        }
+
+        std::string meta = "StreamTitle='" + titles[index / 2] + "';StreamUrl='';";
+        meta.resize((meta.size() + 15) / 16 * 16, '\0');
+        body += char(meta.size() / 16);
+        body += meta;
+    }
+    return body;
+}
+
+/* transport stream packets and tables as a broadcaster muxes them */
+constexpr uint16_t HOST_PMT_PID = 0x1000;
+constexpr uint16_t HOST_AUDIO_PID = 0x0101;
+constexpr uint16_t HOST_VIDEO_PID = 0x0100;
+
+inline std::string hostTsPacket(const uint16_t pid, const bool unitStart, const std::string &payload)
+{
+    std::string packet;
+    packet += '\x47';
+    packet += static_cast<char>((unitStart ? 0x40 : 0x00) | (pid >> 8));
+    packet += static_cast<char>(pid & 0xFF);
+
+    const size_t room = VS1053_TsDemux::PACKET_SIZE - 4;
+    if (payload.size() >= room)
+    {
+        packet += '\x10'; // payload only
+        return packet + payload.substr(0, room);
+    }
+
+    // pad with adaptation field stuffing
+    const size_t adaptation = room - payload.size() - 1;
+    packet += '\x30';
+    packet += static_cast<char>(adaptation);
+    if (adaptation)
+        packet += '\x00' + std::string(adaptation - 1, '\xFF');
+    return packet + payload;
+}
+
+inline std::string hostTsSection(const uint8_t tableId, const std::string &body)
+{
+    // table id, section length, table id extension, version, section numbers, body, crc
+    const size_t length = 5 + body.size() + 4;
+    std::string data(1, '\x00'); // pointer field
+    data += static_cast<char>(tableId);
+    data += static_cast<char>(0xB0 | (length >> 8));
+    data += static_cast<char>(length & 0xFF);
+    data += std::string("\x00\x01\xC1\x00\x00", 5);
+    return data + body + std::string(4, '\x00');
+}
+
+/* an mpeg transport stream that carries the audio as aac adts, with a video stream in front of it when asked */
+inline std::string hostTs(const std::string &audio, const bool withVideo = false)
+{
+    std::string ts;
+    std::string pat = std::string("\x00\x01", 2);
+    pat += static_cast<char>(0xE0 | (HOST_PMT_PID >> 8));
+    pat += static_cast<char>(HOST_PMT_PID & 0xFF);
+    ts += hostTsPacket(0x0000, true, hostTsSection(0x00, pat));
+
+    std::string pmt;
+    pmt += static_cast<char>(0xE0 | (HOST_AUDIO_PID >> 8)); // pcr pid
+    pmt += static_cast<char>(HOST_AUDIO_PID & 0xFF);
+    pmt += std::string("\xF0\x00", 2); // no program info
+    if (withVideo)
+    {
+        pmt += '\x1B'; // h.264 comes first and is skipped
+        pmt += static_cast<char>(0xE0 | (HOST_VIDEO_PID >> 8));
+        pmt += static_cast<char>(HOST_VIDEO_PID & 0xFF);
+        pmt += std::string("\xF0\x03\x0A\x01\x00", 5);
+    }
+    pmt += '\x0F';
+    pmt += static_cast<char>(0xE0 | (HOST_AUDIO_PID >> 8));
+    pmt += static_cast<char>(HOST_AUDIO_PID & 0xFF);
+    pmt += std::string("\xF0\x00", 2);
+    ts += hostTsPacket(HOST_PMT_PID, true, hostTsSection(0x02, pmt));
+
+    // one pes packet per 2000 bytes of audio, with a pts in its header
+    const std::string pes = std::string("\x00\x00\x01\xC0\x00\x00\x80\x80\x05\x21\x00\x01\x00\x01", 14);
+    for (size_t pos = 0; pos < audio.size();)
+    {
+        const size_t end = min(pos + 2000, audio.size());
+        std::string unit = pes + audio.substr(pos, end - pos);
+        bool first = true;
+        for (size_t at = 0; at < unit.size(); at += 184)
+        {
+            if (withVideo && (at / 184) % 3 == 0)
+                ts += hostTsPacket(HOST_VIDEO_PID, first, std::string(184, '\x00'));
+            ts += hostTsPacket(HOST_AUDIO_PID, first, unit.substr(at, 184));
+            first = false;
+        }
+        pos = end;
+    }
+    return ts;
+}
+
+/* calls loop() every stepMs of virtual time until done() or the time is up, returns the time it took */
+inline uint32_t hostRun(ESP32_VS1053_Stream &stream, const uint32_t maxMs, std::function<bool()> done,
+                        const uint32_t stepMs = 2)
+{
+    const unsigned long start = millis();
+    while (millis() - start < maxMs && !done())
+    {
+        stream.loop();
+        hostAdvanceMs(stepMs);
+    }
+    return millis() - start;
+}
+
+#endif
@@ -0,0 +1,298 @@
+#include <Arduino.h>
+#include <SPI.h>
+#include <esp_heap_caps.h>
+#include <freertos/task.h>
+#include <map>
+#include <mutex>
+#include <thread>
+
+HardwareSerial Serial;
+SPIClass SPI;
+
+static std::atomic<uint64_t> _nowUs{0};
+static size_t _psram = 0;
+
+struct HostPin
+{
+    host_pin_read_t read;
+    host_pin_write_t write;
+    uint8_t level = LOW;
+};
+static std::map<uint8_t, HostPin> _pins;
+
+struct HostInterrupt
+{
+    void (*handler)(void *);
+    void *arg;
+    int mode;
+    uint8_t level;
+};
+static std::mutex _interruptMutex; // the chip reports edges from whichever thread talks to it
+static std::map<uint8_t, HostInterrupt> _interrupts;
+static std::atomic<size_t> _interruptCount{0};
+
+void hostLog(const int level, const char *format, ...)
+{
+    static const int wanted = getenv("HOST_LOG_LEVEL") ? atoi(getenv("HOST_LOG_LEVEL")) : 0;
+    if (level > wanted)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "[%8lu][%c] ", millis(), "?EWIDV"[level]);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+unsigned long millis() { return _nowUs / 1000; }
+unsigned long micros() { return _nowUs; }
+void hostAdvanceUs(const uint64_t us)
+{
+    _nowUs += us;
+
+    // a chip only notices time passing when it is asked, reading the pin lets it raise its edge
+    std::vector<uint8_t> pins;
+    {
+        std::lock_guard<std::mutex> lock(_interruptMutex);
+        for (const auto &interrupt : _interrupts)
+            pins.push_back(interrupt.first);
+    }
+    for (const uint8_t pin : pins)
+        digitalRead(pin);
+
+    hostSettleTasks();
+}
+void hostSetTimeUs(const uint64_t us) { _nowUs = us; }
+
+void delay(const uint32_t ms)
+{
+    // a task waits in real time, only the thread that drives the test moves the clock
+    if (hostInTask())
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms ? ms : 1));
+    else
+    {
+        hostAdvanceMs(ms);
+        std::this_thread::yield();
+    }
+}
+
+void yield() { std::this_thread::yield(); }
+
+bool psramFound() { return _psram; }
+void hostSetPsram(const size_t bytes) { _psram = bytes; }
+
+void pinMode(const uint8_t, const uint8_t) {}
+
+int digitalRead(const uint8_t pin)
+{
+    const auto it = _pins.find(pin);
+    if (it == _pins.end())
+        return LOW;
+    return it->second.read ? it->second.read() : it->second.level;
+}
+
+void digitalWrite(const uint8_t pin, const uint8_t value)
+{
+    HostPin &state = _pins[pin];
+    state.level = value;
+    if (state.write)
+        state.write(value);
+}
+
+void attachInterruptArg(const uint8_t pin, void (*handler)(void *), void *arg, const int mode)
+{
+    const uint8_t level = digitalRead(pin);
+    std::lock_guard<std::mutex> lock(_interruptMutex);
+    _interrupts[pin] = {handler, arg, mode, level};
+}
+
+void detachInterrupt(const uint8_t pin)
+{
+    std::lock_guard<std::mutex> lock(_interruptMutex);
+    _interrupts.erase(pin);
+}
+
+void hostPinLevel(const uint8_t pin, const uint8_t level)
+{
+    std::lock_guard<std::mutex> lock(_interruptMutex);
+    const auto it = _interrupts.find(pin);
+    if (it == _interrupts.end() || it->second.level == level)
+        return;
+
+    it->second.level = level;
+    const int mode = it->second.mode;
+    if (mode == CHANGE || (mode == RISING && level == HIGH) || (mode == FALLING && level == LOW))
+    {
+        _interruptCount++;
+        it->second.handler(it->second.arg);
+    }
+}
+
+size_t hostInterrupts() { return _interruptCount; }
+
+void hostAttachPin(const uint8_t pin, host_pin_read_t read, host_pin_write_t write)
+{
+    _pins[pin] = {read, write, HIGH};
+}
+
+void hostDetachPin(const uint8_t pin) { _pins.erase(pin); }
+
+void SPIClass::writeBytes(const uint8_t *data, uint32_t size)
+{
+    if (_write)
+        _write(data, size);
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+    writeBytes(&data, 1);
+    return 0;
+}
+
+void *heap_caps_malloc(const size_t size, const uint32_t caps)
+{
+    if ((caps & MALLOC_CAP_SPIRAM) && !_psram)
+        return nullptr;
+    return malloc(size);
+}
+
+void heap_caps_free(void *ptr) { free(ptr); }
+
+size_t heap_caps_get_free_size(const uint32_t caps) { return (caps & MALLOC_CAP_SPIRAM) ? _psram : 256 * 1024; }
+size_t heap_caps_get_largest_free_block(const uint32_t caps) { return heap_caps_get_free_size(caps); }
+
+bool String::endsWith(const String &suffix) const
+{
+    return _str.size() >= suffix._str.size() &&
+           !_str.compare(_str.size() - suffix._str.size(), suffix._str.size(), suffix._str);
+}
+
+int String::indexOf(const String &str, const unsigned int from) const
+{
+    const size_t found = _str.find(str._str, from);
+    return found == std::string::npos ? -1 : found;
+}
+
+int String::indexOf(const char c, const unsigned int from) const
+{
+    const size_t found = _str.find(c, from);
+    return found == std::string::npos ? -1 : found;
+}
+
+String String::substring(const unsigned int from, const unsigned int to) const
+{
+    const unsigned int left = min(from, to);
+    const unsigned int right = min(max(from, to), (unsigned int)_str.size());
+    return left < right ? _str.substr(left, right - left) : "";
+}
+
+void String::trim()
+{
+    const size_t first = _str.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos)
+    {
+        _str.clear();
+        return;
+    }
+    _str = _str.substr(first, _str.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+void String::toLowerCase()
+{
+    for (char &c : _str)
+        c = tolower(c);
+}
+
+String &String::operator+=(const String &other)
+{
+    _str += other._str;
+    return *this;
+}
+
+String &String::operator+=(const char *other)
+{
+    _str += other ? other : "";
+    return *this;
+}
+
+String &String::operator+=(const char c)
+{
+    _str += c;
+    return *this;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t written = 0;
+    while (written < size && write(buffer[written]))
+        written++;
+    return written;
+}
+
+size_t Print::println(const char *str)
+{
+    return print(str) + print("\r\n");
+}
+
+size_t Print::printf(const char *format, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    const int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return len > 0 ? write(reinterpret_cast<const uint8_t *>(buffer), min((size_t)len, sizeof(buffer) - 1)) : 0;
+}
+
+int Stream::_timedRead()
+{
+    // nothing arrives while a read blocks on the virtual clock, so waiting is moving the clock
+    const unsigned long start = millis();
+    do
+    {
+        const int c = read();
+        if (c >= 0)
+            return c;
+        delay(1);
+    } while (millis() - start < _timeout);
+    return -1;
+}
+
+size_t Stream::readBytes(uint8_t *buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length)
+    {
+        const int c = _timedRead();
+        if (c < 0)
+            break;
+        buffer[count++] = c;
+    }
+    return count;
+}
+
+size_t Stream::readBytesUntil(const char terminator, char *buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length)
+    {
+        const int c = _timedRead();
+        if (c < 0 || c == terminator)
+            break;
+        buffer[count++] = c;
+    }
+    return count;
+}
+
+String Stream::readStringUntil(const char terminator)
+{
+    std::string str;
+    int c = _timedRead();
+    while (c >= 0 && c != terminator)
+    {
+        str += char(c);
+        c = _timedRead();
+    }
+    return String(str);
+}
@@ -0,0 +1,157 @@
+#ifndef __HOST_Arduino__
+#define __HOST_Arduino__
+
+/*  Host stand-in for the parts of the ESP32 Arduino core the library uses.
+    Time is virtual: millis() and micros() only move when a test, delay() or vTaskDelay() moves them,
+    so a replayed stream behaves the same on every run. */
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cstdarg>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <strings.h>
+
+using std::max;
+using std::min;
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define IRAM_ATTR
+#define RISING 1
+#define FALLING 2
+#define CHANGE 3
+#define INPUT 1
+#define OUTPUT 2
+#define HIGH 1
+#define LOW 0
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+/* set HOST_LOG_LEVEL to 1..5 (error..verbose) to see the library log */
+void hostLog(const int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+#define log_e(format, ...) hostLog(1, format, ##__VA_ARGS__)
+#define log_w(format, ...) hostLog(2, format, ##__VA_ARGS__)
+#define log_i(format, ...) hostLog(3, format, ##__VA_ARGS__)
+#define log_d(format, ...) hostLog(4, format, ##__VA_ARGS__)
+#define log_v(format, ...) hostLog(5, format, ##__VA_ARGS__)
+
+unsigned long millis();
+unsigned long micros();
+void delay(const uint32_t ms);
+void yield();
+
+/* the virtual clock, moving it fires the interrupts of pins that changed and lets the woken tasks run */
+void hostAdvanceUs(const uint64_t us);
+inline void hostAdvanceMs(const uint32_t ms) { hostAdvanceUs((uint64_t)ms * 1000); }
+void hostSetTimeUs(const uint64_t us);
+
+bool psramFound();
+void pinMode(const uint8_t pin, const uint8_t mode);
+int digitalRead(const uint8_t pin);
+void digitalWrite(const uint8_t pin, const uint8_t value);
+void attachInterruptArg(const uint8_t pin, void (*handler)(void *), void *arg, const int mode);
+void detachInterrupt(const uint8_t pin);
+
+/* a simulated chip claims its pins */
+typedef std::function<int()> host_pin_read_t;
+typedef std::function<void(uint8_t)> host_pin_write_t;
+void hostAttachPin(const uint8_t pin, host_pin_read_t read, host_pin_write_t write);
+void hostDetachPin(const uint8_t pin);
+void hostPinLevel(const uint8_t pin, const uint8_t level); // the chip drove a claimed pin, an attached interrupt fires on its edge
+size_t hostInterrupts(); // interrupt handlers run so far
+
+class String
+{
+public:
+    String(const char *str = "") : _str(str ? str : "") {}
+    String(const std::string &str) : _str(str) {}
+    String(const int value) : _str(std::to_string(value)) {}
+    String(const unsigned value) : _str(std::to_string(value)) {}
+    String(const long value) : _str(std::to_string(value)) {}
+    String(const unsigned long value) : _str(std::to_string(value)) {}
+
+    const char *c_str() const { return _str.c_str(); }
+    unsigned int length() const { return _str.length(); }
+    bool isEmpty() const { return _str.empty(); }
+    bool equals(const String &other) const { return _str == other._str; }
+    bool equalsIgnoreCase(const String &other) const { return !strcasecmp(c_str(), other.c_str()); }
+    bool startsWith(const String &prefix) const { return !_str.compare(0, prefix._str.size(), prefix._str); }
+    bool endsWith(const String &suffix) const;
+    int indexOf(const String &str, const unsigned int from = 0) const;
+    int indexOf(const char c, const unsigned int from = 0) const;
+    String substring(const unsigned int from) const { return from < _str.size() ? _str.substr(from) : ""; }
+    String substring(const unsigned int from, const unsigned int to) const;
+    long toInt() const { return strtol(c_str(), nullptr, 10); }
+    void trim();
+    void toLowerCase();
+    char *begin() { return &_str[0]; }
+    char *end() { return &_str[0] + _str.size(); }
+    char charAt(const unsigned int index) const { return index < _str.size() ? _str[index] : 0; }
+    char operator[](const unsigned int index) const { return charAt(index); }
+
+    String &operator+=(const String &other);
+    String &operator+=(const char *other);
+    String &operator+=(const char c);
+    friend String operator+(const String &a, const String &b) { return String(a._str + b._str); }
+    bool operator==(const String &other) const { return _str == other._str; }
+    bool operator==(const char *other) const { return _str == (other ? other : ""); }
+    bool operator!=(const String &other) const { return _str != other._str; }
+
+private:
+    std::string _str;
+};
+
+class Print
+{
+public:
+    virtual ~Print() = default;
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *str) { return write(reinterpret_cast<const uint8_t *>(str), strlen(str)); }
+    size_t print(const char *str) { return write(str); }
+    size_t println(const char *str = "");
+    size_t printf(const char *format, ...);
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(const unsigned long ms) { _timeout = ms; }
+    size_t readBytes(uint8_t *buffer, size_t length);
+    size_t readBytes(char *buffer, size_t length) { return readBytes(reinterpret_cast<uint8_t *>(buffer), length); }
+    size_t readBytesUntil(const char terminator, char *buffer, size_t length);
+    String readStringUntil(const char terminator);
+
+protected:
+    unsigned long _timeout = 1000;
+    int _timedRead();
+};
+
+class HardwareSerial : public Stream
+{
+public:
+    void begin(const unsigned long) {}
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+    using Print::write;
+};
+extern HardwareSerial Serial;
+
+#endif
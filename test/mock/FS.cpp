@@ -0,0 +1,88 @@
+#include <FS.h>
+
+using namespace fs;
+
+File::File(std::shared_ptr<HostNode> node, const bool append) : _node(node)
+{
+    if (append)
+        _position = node->data.size();
+}
+
+size_t File::read(uint8_t *buffer, size_t size)
+{
+    if (!_node || _position >= _node->data.size())
+        return 0;
+    const size_t count = min(size, _node->data.size() - _position);
+    memcpy(buffer, _node->data.data() + _position, count);
+    _position += count;
+    return count;
+}
+
+int File::read()
+{
+    uint8_t c;
+    return read(&c, 1) ? c : -1;
+}
+
+int File::available() { return _node ? _node->data.size() - min(_position, _node->data.size()) : 0; }
+
+int File::peek() { return available() ? _node->data[_position] : -1; }
+
+size_t File::write(const uint8_t *buffer, size_t size)
+{
+    if (!_node)
+        return 0;
+    if (_node->data.size() < _position + size)
+        _node->data.resize(_position + size);
+    memcpy(_node->data.data() + _position, buffer, size);
+    _position += size;
+    return size;
+}
+
+bool File::seek(uint32_t position, SeekMode mode)
+{
+    if (!_node)
+        return false;
+    const size_t base = mode == SeekSet ? 0 : mode == SeekCur ? _position : _node->data.size();
+    if (base + position > _node->data.size())
+        return false;
+    _position = base + position;
+    return true;
+}
+
+const char *File::name() const
+{
+    const char *path = this->path();
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+fs::File HostFS::open(const char *path, const char *mode, const bool create)
+{
+    const bool writing = mode[0] == 'w' || mode[0] == 'a';
+    auto it = _files.find(path);
+    if (it == _files.end())
+    {
+        if (!writing && !create)
+            return File();
+        it = _files.emplace(path, std::make_shared<HostNode>()).first;
+        it->second->path = path;
+    }
+    if (mode[0] == 'w')
+        it->second->data.clear();
+    return File(it->second, mode[0] == 'a');
+}
+
+void HostFS::put(const std::string &path, const std::string &data)
+{
+    auto node = std::make_shared<HostNode>();
+    node->path = path;
+    node->data.assign(data.begin(), data.end());
+    _files[path] = node;
+}
+
+std::string HostFS::get(const std::string &path) const
+{
+    const auto it = _files.find(path);
+    return it == _files.end() ? "" : std::string(it->second->data.begin(), it->second->data.end());
+}
@@ -0,0 +1,79 @@
+#ifndef __HOST_FS__
+#define __HOST_FS__
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs
+{
+    enum SeekMode
+    {
+        SeekSet,
+        SeekCur,
+        SeekEnd
+    };
+
+    struct HostNode
+    {
+        std::string path;
+        std::vector<uint8_t> data;
+    };
+
+    class File : public Stream
+    {
+    public:
+        File() = default;
+        explicit File(std::shared_ptr<HostNode> node, const bool append = false);
+
+        operator bool() const { return bool(_node); }
+        size_t read(uint8_t *buffer, size_t size);
+        int read() override;
+        int available() override;
+        int peek() override;
+        size_t write(uint8_t c) override { return write(&c, 1); }
+        size_t write(const uint8_t *buffer, size_t size) override;
+        bool seek(uint32_t position, SeekMode mode = SeekSet);
+        size_t position() const { return _position; }
+        size_t size() const { return _node ? _node->data.size() : 0; }
+        void close() { _node.reset(); }
+        void flush() {}
+        bool setBufferSize(size_t) { return true; }
+        const char *path() const { return _node ? _node->path.c_str() : ""; }
+        const char *name() const;
+
+    private:
+        std::shared_ptr<HostNode> _node;
+        size_t _position = 0;
+    };
+
+    class FS
+    {
+    public:
+        virtual ~FS() = default;
+        virtual File open(const char *path, const char *mode = FILE_READ, const bool create = false) = 0;
+        virtual bool exists(const char *path) = 0;
+        virtual bool remove(const char *path) = 0;
+    };
+}
+
+using fs::File;
+
+/* a file system in memory, files are filled and checked by the tests */
+class HostFS : public fs::FS
+{
+public:
+    fs::File open(const char *path, const char *mode = FILE_READ, const bool create = false) override;
+    bool exists(const char *path) override { return _files.count(path); }
+    bool remove(const char *path) override { return _files.erase(path); }
+
+    void put(const std::string &path, const std::string &data);
+    std::string get(const std::string &path) const;
+
+private:
+    std::map<std::string, std::shared_ptr<fs::HostNode>> _files;
+};
+
+#endif
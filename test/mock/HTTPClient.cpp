@@ -0,0 +1,147 @@
+#include <HTTPClient.h>
+
+static std::string _lower(std::string str)
+{
+    for (char &c : str)
+        c = tolower(c);
+    return str;
+}
+
+bool HTTPClient::begin(const String &url)
+{
+    if (strncasecmp(url.c_str(), "http://", 7) && strncasecmp(url.c_str(), "https://", 8))
+        return false;
+
+    _request = {};
+    _request.url = url.c_str();
+    _headers.clear();
+    _size = -1;
+    return true;
+}
+
+void HTTPClient::end()
+{
+    // like the real client a connection that can take a next request stays open
+    const auto connection = _client.connection();
+    if (!connection)
+        return;
+    if (!_reuse || !connection->complete() || !connection->response().keepAlive || !connection->open())
+        _client.stop();
+}
+
+bool HTTPClient::connected() { return _client.connected(); }
+
+void HTTPClient::addHeader(const String &name, const String &value)
+{
+    _request.headers[_lower(name.c_str())] = value.c_str();
+}
+
+void HTTPClient::setAuthorization(const char *username, const char *password)
+{
+    _request.username = username;
+    _request.password = password;
+}
+
+void HTTPClient::collectHeaders(const char *names[], const size_t count)
+{
+    _collect.clear();
+    for (size_t i = 0; i < count; i++)
+        _collect.push_back(_lower(names[i]));
+}
+
+int HTTPClient::GET()
+{
+    _request.http10 = _http10;
+
+    const auto previous = _client.connection();
+    const bool reused = previous && previous->complete() && previous->response().keepAlive && previous->open();
+    if (!reused)
+        HostServer::countConnection();
+
+    int status = 0;
+    const auto connection = HostServer::connect(_request, status);
+    if (!connection)
+    {
+        _client.stop();
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    _client.attach(connection);
+    hostAdvanceMs(connection->response().responseMs);
+
+    _headers.clear();
+    for (const auto &header : connection->response().headers)
+    {
+        const std::string name = _lower(header.first);
+        if (name == "content-length" && !connection->chunked())
+            _size = atoi(header.second.c_str());
+        if (std::find(_collect.begin(), _collect.end(), name) != _collect.end())
+            _headers.emplace_back(name, header.second);
+    }
+    return status;
+}
+
+String HTTPClient::getString()
+{
+    const auto connection = _client.connection();
+    if (!connection)
+        return "";
+
+    std::string wire;
+    uint8_t buffer[512];
+    while (!connection->complete() && (connection->available() || connection->open()))
+    {
+        const size_t len = connection->read(buffer, sizeof(buffer));
+        wire.append(reinterpret_cast<char *>(buffer), len);
+        if (!len)
+            hostAdvanceMs(1);
+    }
+
+    if (!connection->chunked())
+        return String(wire);
+
+    std::string body;
+    size_t pos = 0;
+    while (pos < wire.size())
+    {
+        const size_t len = strtoul(wire.c_str() + pos, nullptr, 16);
+        pos = wire.find("\r\n", pos) + 2;
+        if (!len)
+            break;
+        body += wire.substr(pos, len);
+        pos += len + 2;
+    }
+    return String(body);
+}
+
+String HTTPClient::header(const char *name)
+{
+    const std::string wanted = _lower(name);
+    for (const auto &header : _headers)
+        if (header.first == wanted)
+            return String(header.second);
+    return String();
+}
+
+bool HTTPClient::hasHeader(const char *name)
+{
+    const std::string wanted = _lower(name);
+    for (const auto &header : _headers)
+        if (header.first == wanted)
+            return true;
+    return false;
+}
+
+String HTTPClient::errorToString(const int error)
+{
+    switch (error)
+    {
+    case HTTPC_ERROR_CONNECTION_REFUSED:
+        return "connection refused";
+    case HTTPC_ERROR_CONNECTION_LOST:
+        return "connection lost";
+    case HTTPC_ERROR_READ_TIMEOUT:
+        return "read Timeout";
+    default:
+        return String();
+    }
+}
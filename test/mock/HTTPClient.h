@@ -0,0 +1,64 @@
+#ifndef __HOST_HTTPClient__
+#define __HOST_HTTPClient__
+
+#include <WiFiClient.h>
+#include <vector>
+#include "HostServer.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+enum followRedirects_t
+{
+    HTTPC_DISABLE_FOLLOW_REDIRECTS,
+    HTTPC_STRICT_FOLLOW_REDIRECTS,
+    HTTPC_FORCE_FOLLOW_REDIRECTS
+};
+
+/* asks HostServer instead of the network, a kept connection is reused like the real client does */
+class HTTPClient
+{
+public:
+    bool begin(const String &url);
+    void end();
+    bool connected();
+
+    void setReuse(const bool reuse) { _reuse = reuse; }
+    void setConnectTimeout(const int32_t) {}
+    void setTimeout(const uint16_t) {}
+    void useHTTP10(const bool http10) { _http10 = http10; }
+    void setFollowRedirects(const followRedirects_t) {}
+    void addHeader(const String &name, const String &value);
+    void setAuthorization(const char *username, const char *password);
+    void collectHeaders(const char *names[], const size_t count);
+
+    int GET();
+    String getString();
+    String header(const char *name);
+    bool hasHeader(const char *name);
+    int getSize() { return _size; }
+    WiFiClient *getStreamPtr() { return &_client; }
+    WiFiClient &getStream() { return _client; }
+
+    static String errorToString(const int error);
+
+private:
+    HostRequest _request;
+    WiFiClient _client;
+    std::vector<std::string> _collect;
+    std::vector<std::pair<std::string, std::string>> _headers;
+    int _size = -1;
+    bool _reuse = true;
+    bool _http10 = false;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "HostServer.h"
+
+std::map<std::string, host_handler_t> HostServer::_routes;
+std::vector<HostRequest> HostServer::_requests;
+size_t HostServer::_connections = 0;
+
+static std::string _lower(std::string str)
+{
+    for (char &c : str)
+        c = tolower(c);
+    return str;
+}
+
+std::string HostRequest::header(const std::string &name) const
+{
+    const auto it = headers.find(_lower(name));
+    return it == headers.end() ? "" : it->second;
+}
+
+HostResponse &HostResponse::header(const std::string &name, const std::string &value)
+{
+    headers.emplace_back(name, value);
+    return *this;
+}
+
+HostConnection::HostConnection(const HostResponse &response, const HostRequest &request, const uint64_t openUs)
+    : _response(response)
+{
+    _chunked = response.chunkBytes && !request.http10;
+    if (!_chunked)
+        _wire = response.body;
+    else
+    {
+        char size[16];
+        for (size_t pos = 0; pos < response.body.size();)
+        {
+            if (pos == response.badChunkAfter)
+                _wire += "not a chunk size\r\n";
+
+            size_t len = min(response.chunkBytes, response.body.size() - pos);
+            if (pos < response.badChunkAfter)
+                len = min(len, response.badChunkAfter - pos);
+            snprintf(size, sizeof(size), "%zx\r\n", len);
+            _wire += size + response.body.substr(pos, len) + "\r\n";
+            pos += len;
+        }
+        _wire += "0\r\n\r\n";
+        _response.header("Transfer-Encoding", "chunked");
+    }
+
+    // a body without a length ends when the server closes, there is nothing left to keep alive
+    bool sized = _chunked;
+    for (const auto &header : _response.headers)
+        sized |= !strcasecmp(header.first.c_str(), "content-length");
+    _response.keepAlive &= sized;
+
+    _firstByteUs = openUs + (uint64_t)(response.responseMs + response.firstByteMs) * 1000;
+}
+
+size_t HostConnection::_arrivedAfter(const uint64_t us) const
+{
+    const size_t total = min(_wire.size(), _response.dropAfter);
+    const uint64_t rate = _response.bytesPerSecond;
+    if (!rate)
+        return total;
+
+    size_t pos = 0;
+    uint64_t clock = 0;
+    const auto reach = [&](const size_t target) -> bool
+    {
+        const uint64_t needed = (uint64_t)(target - pos) * 1000000 / rate;
+        if (clock + needed > us)
+        {
+            pos += (us - clock) * rate / 1000000;
+            return false;
+        }
+        clock += needed;
+        pos = target;
+        return true;
+    };
+
+    for (const auto &pause : _response.pauses)
+    {
+        if (pause.first >= total)
+            break;
+        if (!reach(pause.first))
+            return pos;
+        clock += (uint64_t)pause.second * 1000;
+        if (clock > us)
+            return pos;
+    }
+    reach(total);
+    return pos;
+}
+
+size_t HostConnection::arrived() const
+{
+    const uint64_t now = micros();
+    return now < _firstByteUs ? 0 : _arrivedAfter(now - _firstByteUs);
+}
+
+size_t HostConnection::read(uint8_t *data, const size_t len)
+{
+    const size_t count = min(len, available());
+    memcpy(data, _wire.data() + _read, count);
+    _read += count;
+    return count;
+}
+
+int HostConnection::peek() const
+{
+    return available() ? (uint8_t)_wire[_read] : -1;
+}
+
+bool HostConnection::open() const
+{
+    if (_closed)
+        return false;
+
+    const size_t received = arrived();
+    if (_response.dropAfter < _wire.size() && received >= _response.dropAfter)
+        return false;
+    return received < _wire.size() || _response.keepOpen || _response.keepAlive;
+}
+
+void HostServer::route(const std::string &url, const HostResponse &response)
+{
+    _routes[url] = [response](const HostRequest &)
+    { return response; };
+}
+
+void HostServer::route(const std::string &url, host_handler_t handler) { _routes[url] = handler; }
+
+void HostServer::file(const std::string &url, const std::string &body, const std::string &contentType,
+                      const uint32_t bytesPerSecond)
+{
+    route(url, [body, contentType, bytesPerSecond](const HostRequest &request)
+          {
+              HostResponse response;
+              response.bytesPerSecond = bytesPerSecond;
+              response.header("Content-Type", contentType).header("Accept-Ranges", "bytes");
+
+              const std::string range = request.header("range");
+              const size_t from = range.rfind("bytes=", 0) ? 0 : strtoul(range.c_str() + 6, nullptr, 10);
+              if (from >= body.size() && !range.empty())
+              {
+                  response.status = 416;
+                  response.header("Content-Length", "0");
+                  return response;
+              }
+
+              if (!range.empty())
+              {
+                  response.status = 206;
+                  response.header("Content-Range", "bytes " + std::to_string(from) + "-" +
+                                                       std::to_string(body.size() - 1) + "/" +
+                                                       std::to_string(body.size()));
+              }
+              response.body = body.substr(from);
+              response.header("Content-Length", std::to_string(response.body.size()));
+              return response; });
+}
+
+void HostServer::reset()
+{
+    _routes.clear();
+    _requests.clear();
+    _connections = 0;
+}
+
+std::shared_ptr<HostConnection> HostServer::connect(const HostRequest &request, int &status)
+{
+    _requests.push_back(request);
+
+    const auto it = _routes.find(request.url);
+    if (it == _routes.end())
+        return nullptr;
+
+    const HostResponse response = it->second(request);
+    status = response.status;
+    return std::make_shared<HostConnection>(response, request, micros());
+}
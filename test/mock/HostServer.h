@@ -0,0 +1,97 @@
+#ifndef __HOST_HostServer__
+#define __HOST_HostServer__
+
+/*  Scripted http server behind the HTTPClient and WiFiClient stand-ins.
+    A url is answered with a recorded or generated response, its body arrives at a scripted pace on the
+    virtual clock: after a first byte delay, at a fixed rate, with optional pauses and an optional drop. */
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct HostRequest
+{
+    std::string url;
+    std::map<std::string, std::string> headers; // names in lower case
+    bool http10 = false;
+    std::string username;
+    std::string password;
+
+    std::string header(const std::string &name) const;
+};
+
+struct HostResponse
+{
+    int status = 200;
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+
+    uint32_t responseMs = 0;     // GET() blocks this long before the status line arrives
+    uint32_t firstByteMs = 0;    // then the first body byte arrives after this long
+    uint32_t bytesPerSecond = 0; // 0 delivers the whole body at once
+    std::vector<std::pair<size_t, uint32_t>> pauses; // body byte, stall in ms
+    size_t dropAfter = SIZE_MAX; // the connection breaks after this many body bytes
+    size_t chunkBytes = 0;       // sends the body chunked in pieces of this size, unless http/1.0 was asked
+    size_t badChunkAfter = SIZE_MAX; // a chunked body has a malformed chunk size line after this many body bytes
+    bool keepOpen = false;       // a radio stream that has no end, the connection stays open after the body
+    bool keepAlive = true;       // a completely read body leaves the connection open for a next request
+
+    HostResponse &header(const std::string &name, const std::string &value);
+};
+
+typedef std::function<HostResponse(const HostRequest &request)> host_handler_t;
+
+/* the connection one response is sent over */
+class HostConnection
+{
+public:
+    HostConnection(const HostResponse &response, const HostRequest &request, const uint64_t openUs);
+
+    size_t arrived() const; // wire bytes received by now
+    size_t available() const { return arrived() - _read; }
+    size_t read(uint8_t *data, const size_t len);
+    int peek() const;
+    bool open() const;
+    bool complete() const { return _read == _wire.size(); }
+    bool chunked() const { return _chunked; }
+    const HostResponse &response() const { return _response; }
+    void close() { _closed = true; }
+
+private:
+    HostResponse _response;
+    std::string _wire;
+    bool _chunked = false;
+    uint64_t _firstByteUs;
+    size_t _read = 0;
+    bool _closed = false;
+
+    size_t _arrivedAfter(const uint64_t us) const;
+};
+
+class HostServer
+{
+public:
+    static void route(const std::string &url, const HostResponse &response);
+    static void route(const std::string &url, host_handler_t handler);
+
+    /* a file with accept-ranges, a range request gets the rest of the body with a 206 */
+    static void file(const std::string &url, const std::string &body, const std::string &contentType,
+                     const uint32_t bytesPerSecond = 0);
+
+    static void reset();
+
+    static std::shared_ptr<HostConnection> connect(const HostRequest &request, int &status);
+    static const std::vector<HostRequest> &requests() { return _requests; }
+    static size_t connections() { return _connections; } // new connections, reused ones not included
+    static void countConnection() { _connections++; }
+
+private:
+    static std::map<std::string, host_handler_t> _routes;
+    static std::vector<HostRequest> _requests;
+    static size_t _connections;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include <Preferences.h>
+
+std::map<std::string, std::map<std::string, std::vector<uint8_t>>> Preferences::_store;
+
+bool Preferences::begin(const char *name, const bool readOnly)
+{
+    if (readOnly && !_store.count(name))
+        return false;
+    _name = name;
+    _readOnly = readOnly;
+    _store[_name];
+    return true;
+}
+
+bool Preferences::clear()
+{
+    if (_name.empty() || _readOnly)
+        return false;
+    _store[_name].clear();
+    return true;
+}
+
+bool Preferences::remove(const char *key)
+{
+    return !_name.empty() && !_readOnly && _store[_name].erase(key);
+}
+
+bool Preferences::isKey(const char *key) { return !_name.empty() && _store[_name].count(key); }
+
+size_t Preferences::putBytes(const char *key, const void *value, const size_t len)
+{
+    if (_name.empty() || _readOnly)
+        return 0;
+    const uint8_t *bytes = static_cast<const uint8_t *>(value);
+    _store[_name][key].assign(bytes, bytes + len);
+    return len;
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, const size_t len)
+{
+    if (!isKey(key))
+        return 0;
+    const std::vector<uint8_t> &value = _store[_name][key];
+    if (value.size() > len)
+        return 0;
+    memcpy(buffer, value.data(), value.size());
+    return value.size();
+}
+
+size_t Preferences::getBytesLength(const char *key) { return isKey(key) ? _store[_name][key].size() : 0; }
+
+size_t Preferences::putString(const char *key, const char *value) { return putBytes(key, value, strlen(value)); }
+
+size_t Preferences::getString(const char *key, char *buffer, const size_t len)
+{
+    if (!isKey(key))
+        return 0;
+    const std::vector<uint8_t> &value = _store[_name][key];
+    if (value.size() >= len)
+        return 0;
+    memcpy(buffer, value.data(), value.size());
+    buffer[value.size()] = 0;
+    return value.size() + 1;
+}
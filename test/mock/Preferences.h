@@ -0,0 +1,30 @@
+#ifndef __HOST_Preferences__
+#define __HOST_Preferences__
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/* namespaces live in memory for the lifetime of the test */
+class Preferences
+{
+public:
+    bool begin(const char *name, const bool readOnly = false);
+    void end() { _name.clear(); }
+    bool clear();
+    bool remove(const char *key);
+    bool isKey(const char *key);
+    size_t putBytes(const char *key, const void *value, const size_t len);
+    size_t getBytes(const char *key, void *buffer, const size_t len);
+    size_t getBytesLength(const char *key);
+    size_t putString(const char *key, const char *value);
+    size_t getString(const char *key, char *buffer, const size_t len);
+
+private:
+    std::string _name;
+    bool _readOnly = false;
+    static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> _store;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef __HOST_SPI__
+#define __HOST_SPI__
+
+#include <Arduino.h>
+
+#define MSBFIRST 1
+#define SPI_MODE0 0
+
+class SPISettings
+{
+public:
+    SPISettings(uint32_t = 1000000, uint8_t = MSBFIRST, uint8_t = SPI_MODE0) {}
+};
+
+/* bytes written go to whatever chip selected itself with hostOnWrite() */
+class SPIClass
+{
+public:
+    void begin(int8_t = -1, int8_t = -1, int8_t = -1, int8_t = -1) {}
+    void beginTransaction(SPISettings) {}
+    void endTransaction() {}
+    void writeBytes(const uint8_t *data, uint32_t size);
+    uint8_t transfer(uint8_t data);
+
+    void hostOnWrite(std::function<void(const uint8_t *, uint32_t)> write) { _write = write; }
+
+private:
+    std::function<void(const uint8_t *, uint32_t)> _write;
+};
+extern SPIClass SPI;
+
+#endif
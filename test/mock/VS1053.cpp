@@ -0,0 +1,186 @@
+#include <VS1053.h>
+#include <vector>
+
+const unsigned short PATCHES_FLAC[] = {0x0007, 0x0001, 0x8050};
+const unsigned short PATCHES_FLAC_SIZE = sizeof(PATCHES_FLAC) / sizeof(PATCHES_FLAC[0]);
+
+static std::vector<VS1053 *> _chips;
+
+VS1053::VS1053(uint8_t, uint8_t dcsPin, uint8_t dreqPin) : _dcsPin(dcsPin), _dreqPin(dreqPin)
+{
+    _lastUs = micros();
+    _chips.push_back(this);
+    SPI.hostOnWrite(_spiWrite);
+    hostAttachPin(_dreqPin, [this]()
+                  { return data_request() ? HIGH : LOW; },
+                  nullptr);
+    hostAttachPin(_dcsPin, nullptr, [this](uint8_t level)
+                  { _dcs = level; });
+}
+
+VS1053::~VS1053()
+{
+    hostDetachPin(_dreqPin);
+    hostDetachPin(_dcsPin);
+    _chips.erase(std::find(_chips.begin(), _chips.end(), this));
+}
+
+VS1053 *VS1053::host(const uint8_t dreqPin)
+{
+    for (VS1053 *chip : _chips)
+        if (chip->_dreqPin == dreqPin)
+            return chip;
+    return nullptr;
+}
+
+void VS1053::_spiWrite(const uint8_t *data, uint32_t len)
+{
+    // sdi data goes to the chip that pulled its DCS low
+    for (VS1053 *chip : _chips)
+        if (chip->_dcs == LOW)
+            chip->_write(data, len);
+}
+
+bool VS1053::data_request()
+{
+    Guard guard(_mutex);
+    _update();
+    return FIFO_SIZE - _fifo >= DREQ_SPACE;
+}
+
+void VS1053::playChunk(uint8_t *data, size_t len)
+{
+    Guard guard(_mutex);
+    // the driver waits for DREQ before every 32 bytes, time stands still here so the chip takes it all
+    _update();
+    _received.append(reinterpret_cast<const char *>(data), len);
+    _fifo += len;
+    if (!_firstByteUs)
+        _firstByteUs = micros();
+    _setDreq();
+}
+
+void VS1053::_write(const uint8_t *data, const size_t len)
+{
+    Guard guard(_mutex);
+    _update();
+    if (FIFO_SIZE - _fifo < DREQ_SPACE)
+        _overruns += len;
+
+    // running dry only counts once more audio comes, the end of an item is not an underrun
+    if (_starving)
+    {
+        _underruns++;
+        _starvedUs += micros() - _starvedSinceUs;
+        _starving = false;
+    }
+
+    _received.append(reinterpret_cast<const char *>(data), len);
+    _fifo = min(FIFO_SIZE, _fifo + len);
+    if (!_firstByteUs)
+        _firstByteUs = micros();
+    _setDreq();
+}
+
+void VS1053::_update()
+{
+    const uint64_t now = micros();
+    const uint64_t elapsed = now - _lastUs;
+    _lastUs = now;
+
+    // kbps * 1000 / 8 bytes per second, counted in millionths of a byte per microsecond
+    _credit += elapsed * _kbps * 125;
+    const size_t drain = min((uint64_t)_fifo, _credit / 1000000);
+    _fifo -= drain;
+    _decoded += drain;
+    _credit = _fifo ? _credit - drain * 1000000 : 0;
+
+    if (_firstByteUs && !_fifo && !_starving)
+    {
+        _starving = true;
+        _starvedSinceUs = now;
+    }
+    _detect();
+    _setDreq();
+}
+
+void VS1053::_setDreq()
+{
+    const uint8_t level = (FIFO_SIZE - _fifo >= DREQ_SPACE) ? HIGH : LOW;
+    if (level == _dreq)
+        return;
+
+    _dreq = level;
+    hostPinLevel(_dreqPin, level);
+}
+
+void VS1053::_detect()
+{
+    // HDAT1 and HDAT0 follow the first header the decoder reaches
+    const size_t consumed = _received.size() - _fifo;
+    if (_hdat1)
+    {
+        _scanned = consumed;
+        return;
+    }
+
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(_received.data());
+    for (; _scanned + 4 <= consumed; _scanned++)
+    {
+        const uint8_t *p = data + _scanned;
+        if (!memcmp(p, "OggS", 4))
+            _hdat1 = 0x4F67;
+        else if (!memcmp(p, "fLaC", 4))
+            _hdat1 = 0x664C;
+        else if (!memcmp(p, "RIFF", 4))
+            _hdat1 = 0x7665;
+        else if (p[0] == 0xFF && (p[1] & 0xF6) == 0xF0)
+            _hdat1 = 0x4154;
+        else if (p[0] == 0xFF && (p[1] & 0xE0) == 0xE0 && (p[1] & 0x06) && (p[2] >> 4) != 0x0F && (p[2] >> 4))
+        {
+            _hdat1 = p[0] << 8 | p[1];
+            _hdat0 = p[2] << 8 | p[3];
+        }
+
+        if (_hdat1)
+            return;
+    }
+}
+
+void VS1053::stopSong()
+{
+    Guard guard(_mutex);
+    _update();
+    _stops++;
+    _fifo = 0;
+    _credit = 0;
+    _hdat0 = 0;
+    _hdat1 = 0;
+    _scanned = _received.size();
+    _starving = false;
+    _setDreq();
+}
+
+uint16_t VS1053::readRegister(uint8_t address)
+{
+    Guard guard(_mutex);
+    _update();
+    switch (address)
+    {
+    case 0x04: // SCI_DECODE_TIME
+        return _kbps ? (uint64_t)_decoded * 8 / (_kbps * 1000) : 0;
+    case 0x08: // SCI_HDAT0
+        return _hdat0 ? _hdat0 : _kbps * 1000 / 8;
+    case 0x09: // SCI_HDAT1
+        return _hdat1;
+    default:
+        return 0;
+    }
+}
+
+void VS1053::clearDecodedTime()
+{
+    Guard guard(_mutex);
+    _update();
+    _decoded = 0;
+}
@@ -0,0 +1,91 @@
+#ifndef __HOST_VS1053__
+#define __HOST_VS1053__
+
+/*  A vs1053 as far as the library can tell: a 2048 byte sdi fifo behind the DREQ line that the decoder
+    drains at a set bitrate on the virtual clock, HDAT0/HDAT1 once a known header was decoded and the
+    decode time. Everything written over sdi is kept so a test can compare it with the source audio. */
+
+#include <SPI.h>
+#include <mutex>
+#include <string>
+
+extern const unsigned short PATCHES_FLAC[];
+extern const unsigned short PATCHES_FLAC_SIZE;
+
+class VS1053
+{
+public:
+    static constexpr size_t FIFO_SIZE = 2048;
+    static constexpr size_t DREQ_SPACE = 32; // DREQ is high while this much fits
+
+    VS1053(uint8_t csPin, uint8_t dcsPin, uint8_t dreqPin);
+    ~VS1053();
+
+    void begin() {}
+    void switchToMp3Mode() {}
+    uint16_t getChipVersion() { return 4; }
+    bool isChipConnected() { return true; }
+    void loadUserCode(const unsigned short *, unsigned short) { _patched = true; }
+
+    bool data_request();
+    void playChunk(uint8_t *data, size_t len);
+    void startSong() {}
+    void stopSong();
+    void softReset() { stopSong(); }
+    void setVolume(uint8_t volume) { _volume = volume; }
+    void setTone(uint8_t *) {}
+    uint16_t readRegister(uint8_t address);
+    void writeRegister(uint8_t, uint16_t) {}
+    uint16_t getDecodedTime() { return readRegister(0x04); }
+    void clearDecodedTime();
+
+    /* the simulated chip */
+    static VS1053 *host(const uint8_t dreqPin); // the chip on that DREQ pin
+    void hostSetKbps(const uint32_t kbps) { Guard guard(_mutex); _update(); _kbps = kbps; }
+    const std::string &hostReceived() const { return _received; } // everything written over sdi
+    size_t hostFifo() { Guard guard(_mutex); _update(); return _fifo; }
+    size_t hostDecoded() { Guard guard(_mutex); _update(); return _decoded; }
+    uint32_t hostUnderruns() const { return _underruns; } // the fifo ran dry and more audio came later
+    uint64_t hostStarvedUs() const { return _starvedUs; }
+    uint32_t hostOverruns() const { return _overruns; } // bytes written while DREQ was low
+    uint32_t hostStops() const { return _stops; }       // stopSong() and softReset() calls, the decoder started over
+    uint64_t hostFirstByteUs() const { return _firstByteUs; } // first decoded byte, 0 before
+    uint8_t hostVolume() const { return _volume; }
+    bool hostPatched() const { return _patched; }
+
+private:
+    typedef std::lock_guard<std::recursive_mutex> Guard;
+    std::recursive_mutex _mutex; // a feeder task and the test thread both talk to the chip
+
+    uint8_t _dcsPin;
+    uint8_t _dreqPin;
+    uint8_t _dcs = HIGH;
+    uint8_t _dreq = HIGH;
+    uint8_t _volume = 0;
+    bool _patched = false;
+
+    uint32_t _kbps = 128;
+    size_t _fifo = 0;
+    size_t _decoded = 0;      // since the decode time was cleared
+    uint64_t _lastUs = 0;
+    uint64_t _credit = 0;     // drained bytes * 1e6 not yet taken from the fifo
+    uint64_t _firstByteUs = 0;
+    uint64_t _starvedUs = 0;
+    uint32_t _underruns = 0;
+    bool _starving = false;
+    uint64_t _starvedSinceUs = 0;
+    uint32_t _overruns = 0;
+    uint32_t _stops = 0;
+    std::string _received;
+    size_t _scanned = 0;     // received bytes the header detection looked at
+    uint16_t _hdat0 = 0;
+    uint16_t _hdat1 = 0;
+
+    void _update();
+    void _setDreq();
+    void _write(const uint8_t *data, const size_t len);
+    void _detect();
+    static void _spiWrite(const uint8_t *data, uint32_t len);
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include <WiFi.h>
+#include "HostServer.h"
+
+WiFiClass WiFi;
+
+void btStop() {}
+
+int WiFiClient::available() { return _connection ? _connection->available() : 0; }
+
+int WiFiClient::read()
+{
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size)
+{
+    if (!_connection || !_connection->available())
+        return -1;
+    return _connection->read(buffer, size);
+}
+
+int WiFiClient::peek() { return _connection ? _connection->peek() : -1; }
+
+uint8_t WiFiClient::connected()
+{
+    return _connection && (_connection->available() || _connection->open());
+}
+
+void WiFiClient::stop()
+{
+    if (_connection)
+        _connection->close();
+    _connection.reset();
+}
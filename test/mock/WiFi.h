@@ -0,0 +1,20 @@
+#ifndef __HOST_WiFi__
+#define __HOST_WiFi__
+
+#include <WiFiClient.h>
+
+class WiFiClass
+{
+public:
+    bool isConnected() { return _connected; }
+    void begin(const char *, const char *) { _connected = true; }
+    void setSleep(bool) {}
+
+    void hostSetConnected(const bool connected) { _connected = connected; }
+
+private:
+    bool _connected = true;
+};
+extern WiFiClass WiFi;
+
+#endif
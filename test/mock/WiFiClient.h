@@ -0,0 +1,31 @@
+#ifndef __HOST_WiFiClient__
+#define __HOST_WiFiClient__
+
+#include <Arduino.h>
+#include <memory>
+
+class HostConnection;
+
+/* reads the body of a scripted response as it arrives on the virtual clock */
+class WiFiClient : public Stream
+{
+public:
+    int available() override;
+    int read() override;
+    int read(uint8_t *buffer, size_t size);
+    int peek() override;
+    size_t write(uint8_t) override { return 1; }
+    using Print::write;
+    uint8_t connected();
+    void stop();
+
+    void attach(std::shared_ptr<HostConnection> connection) { _connection = connection; }
+    std::shared_ptr<HostConnection> connection() const { return _connection; }
+
+private:
+    std::shared_ptr<HostConnection> _connection;
+};
+
+using NetworkClient = WiFiClient;
+
+#endif
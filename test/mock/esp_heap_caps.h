@@ -0,0 +1,19 @@
+#ifndef __HOST_esp_heap_caps__
+#define __HOST_esp_heap_caps__
+
+#include <Arduino.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+/* psram is there when hostSetPsram(bytes) gave it a size */
+void hostSetPsram(const size_t bytes);
+
+void *heap_caps_malloc(const size_t size, const uint32_t caps);
+void heap_caps_free(void *ptr);
+size_t heap_caps_get_free_size(const uint32_t caps);
+size_t heap_caps_get_largest_free_block(const uint32_t caps);
+
+#endif
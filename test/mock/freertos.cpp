@@ -0,0 +1,209 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct HostTask
+{
+    std::mutex mutex;
+    std::condition_variable notified;
+    std::condition_variable idle; // waiting for a notification or done
+    uint32_t notifications = 0;
+    bool waiting = false;
+    bool done = false;
+};
+
+struct HostSemaphore
+{
+    std::recursive_timed_mutex mutex;
+};
+
+struct HostQueue
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t itemSize;
+};
+
+static thread_local HostTask *_currentTask = nullptr;
+
+static std::mutex _wokenMutex;
+static std::vector<HostTask *> _woken; // notified from an interrupt since the last settle
+
+static std::chrono::milliseconds _wait(const TickType_t ticks)
+{
+    return std::chrono::milliseconds(ticks == portMAX_DELAY ? 24 * 3600 * 1000 : ticks);
+}
+
+bool hostInTask() { return _currentTask; }
+
+void portYIELD_FROM_ISR(const BaseType_t) {}
+void taskYIELD() { std::this_thread::yield(); }
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *, const uint32_t, void *arg,
+                                   const UBaseType_t, TaskHandle_t *handle, const BaseType_t)
+{
+    HostTask *task = new HostTask;
+    if (handle)
+        *handle = task;
+
+    std::thread([function, arg, task]()
+                {
+                    _currentTask = task;
+                    // the handle is not freed, a late notification to a finished task must not crash
+                    function(arg);
+                    std::lock_guard<std::mutex> lock(task->mutex);
+                    task->done = true;
+                    task->idle.notify_all(); })
+        .detach();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t) {}
+
+void vTaskDelay(const TickType_t ticks) { delay(ticks); }
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return _currentTask; }
+
+uint32_t ulTaskNotifyTake(const BaseType_t clear, const TickType_t ticks)
+{
+    HostTask *task = _currentTask;
+    if (!task)
+        return 0;
+
+    std::unique_lock<std::mutex> lock(task->mutex);
+    task->waiting = true;
+    task->idle.notify_all();
+    task->notified.wait_for(lock, _wait(ticks), [task]
+                            { return task->notifications > 0; });
+    task->waiting = false;
+    const uint32_t count = task->notifications;
+    task->notifications = clear ? 0 : (count ? count - 1 : 0);
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    if (!task)
+        return pdFAIL;
+
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+    task->notified.notify_one();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+    if (xTaskNotifyGive(task) == pdPASS)
+    {
+        std::lock_guard<std::mutex> lock(_wokenMutex);
+        if (std::find(_woken.begin(), _woken.end(), task) == _woken.end())
+            _woken.push_back(task);
+    }
+    if (woken)
+        *woken = pdFALSE;
+}
+
+void hostSettleTasks()
+{
+    std::vector<HostTask *> woken;
+    {
+        std::lock_guard<std::mutex> lock(_wokenMutex);
+        woken.swap(_woken);
+    }
+
+    // bounded, a task that waits for a lock the caller holds catches up later
+    for (HostTask *task : woken)
+    {
+        std::unique_lock<std::mutex> lock(task->mutex);
+        task->idle.wait_for(lock, std::chrono::milliseconds(20), [task]
+                            { return task->done || (task->waiting && !task->notifications); });
+    }
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new HostSemaphore; }
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return new HostSemaphore; }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, const TickType_t ticks)
+{
+    // a plain lock when waiting forever, thread sanitizer does not see a timed lock
+    if (ticks == portMAX_DELAY)
+    {
+        semaphore->mutex.lock();
+        return pdTRUE;
+    }
+    return semaphore->mutex.try_lock_for(_wait(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    semaphore->mutex.unlock();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, const TickType_t ticks)
+{
+    return xSemaphoreTake(semaphore, ticks);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) { return xSemaphoreGive(semaphore); }
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) { delete semaphore; }
+
+QueueHandle_t xQueueCreate(const UBaseType_t length, const UBaseType_t itemSize)
+{
+    HostQueue *queue = new HostQueue;
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, const TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!queue->changed.wait_for(lock, _wait(ticks), [queue]
+                                 { return queue->items.size() < queue->length; }))
+        return pdFALSE;
+
+    const uint8_t *bytes = static_cast<const uint8_t *>(item);
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, const TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!queue->changed.wait_for(lock, _wait(ticks), [queue]
+                                 { return !queue->items.empty(); }))
+        return pdFALSE;
+
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->length - queue->items.size();
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete queue; }
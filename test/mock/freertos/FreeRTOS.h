@@ -0,0 +1,26 @@
+#ifndef __HOST_FreeRTOS__
+#define __HOST_FreeRTOS__
+
+/*  Host stand-in for the FreeRTOS calls the library makes. Tasks are threads, a tick is one millisecond.
+    The replay tests run everything from loop() so they stay deterministic, the tasks are here to build
+    and smoke test the task paths. */
+
+#include <Arduino.h>
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFF
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+typedef struct HostTask *TaskHandle_t;
+typedef struct HostSemaphore *SemaphoreHandle_t;
+typedef struct HostQueue *QueueHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+void portYIELD_FROM_ISR(const BaseType_t woken = pdFALSE);
+void taskYIELD();
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef __HOST_queue__
+#define __HOST_queue__
+
+#include <freertos/FreeRTOS.h>
+
+QueueHandle_t xQueueCreate(const UBaseType_t length, const UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, const TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, const TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+void vQueueDelete(QueueHandle_t queue);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef __HOST_task__
+#define __HOST_task__
+
+#include <freertos/FreeRTOS.h>
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, const uint32_t stackSize, void *arg,
+                                   const UBaseType_t priority, TaskHandle_t *handle, const BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(const TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+uint32_t ulTaskNotifyTake(const BaseType_t clear, const TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken);
+
+/* true on a thread started by xTaskCreatePinnedToCore() */
+bool hostInTask();
+
+/* waits until the tasks an interrupt woke are waiting for a notification again, so they keep up with the virtual clock */
+void hostSettleTasks();
+
+#endif
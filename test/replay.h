@@ -0,0 +1,344 @@
+#ifndef __HOST_REPLAY__
+#define __HOST_REPLAY__
+
+/*  Recorded server responses replayed with scripted timing: an icy radio that stalls, a chunked icy
+    stream that breaks its chunk framing and is joined again, a redirect chain, m3u and pls playlists, a dropped download resumed with a range request,
+    hls with transport stream segments and local mp3, flac and wav files. test_replay checks what each
+    one delivers to the decoder, replay_bench reports what it costs. The virtual clock makes every run
+    the same, only the cpu and loop() times are measured in real time. */
+
+#include "host_test.h"
+#include <chrono>
+#include <ctime>
+
+struct ReplayScenario
+{
+    const char *name;
+    std::string audio;     // what the decoder should get
+    uint32_t kbps;         // the rate the simulated decoder plays it at
+    std::string url;       // an http url, or a path in the file system
+    bool fromFile = false;
+    bool live = false;     // a radio has no end, it is stopped after runMs with a prefix of the audio delivered
+    std::string errors;    // what the error callback reports on the way
+    uint32_t runMs = 120000;
+    std::function<void(HostFS &fs)> setup;
+};
+
+struct ReplayResult
+{
+    bool connected = false;
+    bool finished = false;
+    std::string received;
+    std::vector<std::string> titles;
+    std::string station;
+    std::string errors;
+    std::string lastUrl;
+    VS1053_Stats stats{};
+    uint32_t virtualMs = 0;
+    uint32_t firstAudioMs = 0; // from the connect call to the first byte the decoder got
+    uint32_t chipUnderruns = 0;
+    uint32_t chipOverruns = 0;
+    double cpuMs = 0;
+    uint32_t worstLoopUs = 0;
+    uint32_t loops = 0;
+};
+
+inline HostResponse replayAudio(const std::string &body, const uint32_t bytesPerSecond)
+{
+    HostResponse response;
+    response.header("Content-Type", "audio/mpeg").header("Content-Length", std::to_string(body.size()));
+    response.body = body;
+    response.responseMs = 60;
+    response.firstByteMs = 40;
+    response.bytesPerSecond = bytesPerSecond;
+    return response;
+}
+
+inline std::vector<ReplayScenario> replayScenarios()
+{
+    std::vector<ReplayScenario> scenarios;
+
+    {
+        ReplayScenario radio;
+        radio.name = "icy radio";
+        radio.audio = hostMp3(1500);
+        radio.kbps = 128;
+        radio.url = "http://radio/live";
+        radio.live = true;
+        radio.runMs = 20000;
+        const std::string body = hostIcy(radio.audio, 8000, {"First Song", "Second Song", "Third Song"});
+        radio.setup = [body](HostFS &)
+        {
+            HostResponse response;
+            response.header("Content-Type", "audio/mpeg").header("icy-metaint", "8000");
+            response.header("icy-name", "Host Radio").header("icy-br", "128");
+            response.body = body;
+            response.responseMs = 120;
+            response.firstByteMs = 180;
+            response.bytesPerSecond = 16100; // the bitrate plus the metadata
+            response.pauses = {{120000, 1500}}; // longer than the buffer holds, shorter than the stream timeout
+            response.keepOpen = true;
+            HostServer::route("http://radio/live", response);
+        };
+        scenarios.push_back(radio);
+    }
+
+    {
+        // chunk borders fall inside metadata blocks and inside the chunk size lines of the next read,
+        // then a malformed chunk size line breaks the stream and the radio is joined again where it was
+        ReplayScenario chunked;
+        chunked.name = "chunked icy";
+        chunked.audio = hostMp3(300);
+        chunked.kbps = 128;
+        chunked.url = "http://radio/chunked";
+        chunked.errors = "Stream sync lost\n";
+        const size_t joined = 12 * 4000; // whole metadata blocks before the malformed chunk
+        const std::string before = hostIcy(chunked.audio.substr(0, joined), 4000, {"Chunked Title", "Next Title"});
+        const std::string after = hostIcy(chunked.audio.substr(joined), 4000, {"Joined Again"});
+        chunked.setup = [before, after](HostFS &)
+        {
+            auto requests = std::make_shared<size_t>(0);
+            HostServer::route("http://radio/chunked", [before, after, requests](const HostRequest &)
+                              {
+                                  HostResponse response;
+                                  response.header("Content-Type", "audio/mpeg").header("icy-metaint", "4000");
+                                  response.body = (*requests)++ ? after : before + after;
+                                  response.badChunkAfter = response.body.size() > after.size() ? before.size() : SIZE_MAX;
+                                  response.responseMs = 50;
+                                  response.bytesPerSecond = 40000;
+                                  response.chunkBytes = 777;
+                                  return response; });
+        };
+        scenarios.push_back(chunked);
+    }
+
+    {
+        ReplayScenario redirect;
+        redirect.name = "redirect chain";
+        redirect.audio = hostMp3(250);
+        redirect.kbps = 128;
+        redirect.url = "http://short/link";
+        const std::string audio = redirect.audio;
+        redirect.setup = [audio](HostFS &)
+        {
+            HostResponse found;
+            found.status = 302;
+            found.header("Location", "http://mirror/moved");
+            found.responseMs = 30;
+            HostServer::route("http://short/link", found);
+
+            HostResponse moved;
+            moved.status = 301;
+            moved.header("Location", "/files/song.mp3");
+            moved.responseMs = 30;
+            HostServer::route("http://mirror/moved", moved);
+
+            HostServer::file("http://mirror/files/song.mp3", audio, "audio/mpeg", 32000);
+        };
+        scenarios.push_back(redirect);
+    }
+
+    {
+        ReplayScenario m3u;
+        m3u.name = "m3u playlist";
+        m3u.audio = hostMp3(250);
+        m3u.kbps = 128;
+        m3u.url = "http://lists/radio.m3u";
+        const std::string audio = m3u.audio;
+        m3u.setup = [audio](HostFS &)
+        {
+            HostResponse list;
+            list.header("Content-Type", "audio/x-mpegurl");
+            list.body = "#EXTM3U\r\n#EXTINF:-1,Host Radio\r\nhttp://media/track.mp3\r\n";
+            list.header("Content-Length", std::to_string(list.body.size()));
+            list.responseMs = 40;
+            HostServer::route("http://lists/radio.m3u", list);
+            HostServer::route("http://media/track.mp3", replayAudio(audio, 32000));
+        };
+        scenarios.push_back(m3u);
+    }
+
+    {
+        ReplayScenario pls;
+        pls.name = "pls playlist";
+        pls.audio = hostMp3(250);
+        pls.kbps = 128;
+        pls.url = "http://lists/radio.pls";
+        const std::string audio = pls.audio;
+        pls.setup = [audio](HostFS &)
+        {
+            HostResponse list;
+            list.header("Content-Type", "audio/x-scpls");
+            list.body = "[playlist]\nNumberOfEntries=1\nFile1=http://media/track.mp3\nTitle1=Host Radio\nVersion=2\n";
+            list.header("Content-Length", std::to_string(list.body.size()));
+            list.responseMs = 40;
+            HostServer::route("http://lists/radio.pls", list);
+            HostServer::route("http://media/track.mp3", replayAudio(audio, 32000));
+        };
+        scenarios.push_back(pls);
+    }
+
+    {
+        // the first response breaks off, the rest comes as a 206 to a range request
+        ReplayScenario resume;
+        resume.name = "drop and resume";
+        resume.audio = hostMp3(300);
+        resume.kbps = 128;
+        resume.url = "http://media/download.mp3";
+        const std::string audio = resume.audio;
+        resume.setup = [audio](HostFS &)
+        {
+            HostServer::route("http://media/download.mp3", [audio](const HostRequest &request)
+                              {
+                                  const std::string range = request.header("range");
+                                  if (range.empty())
+                                  {
+                                      HostResponse response = replayAudio(audio, 32000);
+                                      response.header("Accept-Ranges", "bytes").header("ETag", "\"v1\"");
+                                      response.dropAfter = 60000;
+                                      return response;
+                                  }
+
+                                  const size_t from = strtoul(range.c_str() + 6, nullptr, 10);
+                                  HostResponse response = replayAudio(audio.substr(from), 32000);
+                                  response.status = 206;
+                                  response.header("Accept-Ranges", "bytes").header("ETag", "\"v1\"");
+                                  response.header("Content-Range", "bytes " + std::to_string(from) + "-" +
+                                                                       std::to_string(audio.size() - 1) + "/" +
+                                                                       std::to_string(audio.size()));
+                                  return response; });
+        };
+        scenarios.push_back(resume);
+    }
+
+    {
+        // three segments of aac in transport streams, each with its own tables
+        ReplayScenario hls;
+        hls.name = "hls transport stream";
+        hls.kbps = 128;
+        hls.url = "http://hls/radio/index.m3u8";
+        std::vector<std::string> segments;
+        for (size_t i = 0; i < 3; i++)
+        {
+            const std::string audio = hostAdts(90);
+            hls.audio += audio;
+            segments.push_back(hostTs(audio, i == 1));
+        }
+        hls.setup = [segments](HostFS &)
+        {
+            HostResponse playlist;
+            playlist.header("Content-Type", "application/vnd.apple.mpegurl");
+            playlist.body = "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:3\n#EXT-X-MEDIA-SEQUENCE:0\n";
+            for (size_t i = 0; i < segments.size(); i++)
+                playlist.body += "#EXTINF:2.090,\nsegment" + std::to_string(i) + ".ts\n";
+            playlist.body += "#EXT-X-ENDLIST\n";
+            playlist.header("Content-Length", std::to_string(playlist.body.size()));
+            playlist.responseMs = 40;
+            HostServer::route("http://hls/radio/index.m3u8", playlist);
+
+            for (size_t i = 0; i < segments.size(); i++)
+            {
+                HostResponse segment;
+                segment.header("Content-Type", "video/mp2t");
+                segment.header("Content-Length", std::to_string(segments[i].size()));
+                segment.body = segments[i];
+                segment.responseMs = 50;
+                segment.bytesPerSecond = 60000;
+                HostServer::route("http://hls/radio/segment" + std::to_string(i) + ".ts", segment);
+            }
+        };
+        scenarios.push_back(hls);
+    }
+
+    const struct
+    {
+        const char *name;
+        const char *path;
+        std::string audio;
+        uint32_t kbps;
+    } files[] = {
+        {"local mp3", "/music/track.mp3", hostMp3(400), 128},
+        {"local flac", "/music/track.flac", hostFlac(150), 172},
+        {"local wav", "/music/track.wav", hostWav(176400 * 4), 1411},
+    };
+    for (const auto &file : files)
+    {
+        ReplayScenario local;
+        local.name = file.name;
+        local.audio = file.audio;
+        local.kbps = file.kbps;
+        local.url = file.path;
+        local.fromFile = true;
+        const std::string path = file.path;
+        const std::string audio = file.audio;
+        local.setup = [path, audio](HostFS &fs)
+        { fs.put(path, audio); };
+        scenarios.push_back(local);
+    }
+
+    return scenarios;
+}
+
+/* plays a scenario by calling loop() every stepMs of virtual time, the way a sketch does */
+inline ReplayResult replay(const ReplayScenario &scenario, const uint32_t stepMs = 2)
+{
+    HostServer::reset();
+    HostFS fs;
+    scenario.setup(fs);
+
+    ReplayResult result;
+    ESP32_VS1053_Stream stream;
+    if (!stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ))
+        return result;
+
+    VS1053 *chip = VS1053::host(HOST_DREQ);
+    chip->hostSetKbps(scenario.kbps);
+
+    stream.setInfoCB([&](const char *info)
+                     { result.titles.push_back(info); });
+    stream.setStationCB([&](const char *name)
+                        { result.station = name; });
+    stream.setEofCB([&](const char *)
+                    { result.finished = true; });
+    stream.setErrorCB([&](const char *error)
+                      { result.errors += std::string(error) + "\n"; });
+
+    const unsigned long startMs = millis();
+    const uint64_t startUs = micros();
+    const std::clock_t cpuStart = std::clock();
+
+    result.connected = scenario.fromFile ? stream.connectToFile(fs, scenario.url.c_str())
+                                         : stream.connectToHost(scenario.url.c_str());
+
+    // the url redirects and playlists led to, it is gone once the item ended
+    char url[VS1053_MAX_URL_LENGTH];
+    if (result.connected && stream.lastUrl(url, sizeof(url)))
+        result.lastUrl = url;
+
+    if (result.connected)
+    {
+        while (millis() - startMs < scenario.runMs && !result.finished &&
+               (scenario.live || stream.isRunning()))
+        {
+            const auto before = std::chrono::steady_clock::now();
+            stream.loop();
+            const auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - before);
+            result.worstLoopUs = max(result.worstLoopUs, (uint32_t)us.count());
+            result.loops++;
+            hostAdvanceMs(stepMs);
+        }
+    }
+
+    result.cpuMs = (std::clock() - cpuStart) * 1000.0 / CLOCKS_PER_SEC;
+    result.virtualMs = (micros() - startUs) / 1000;
+
+    result.stats = stream.getStats();
+    result.received = chip->hostReceived();
+    result.firstAudioMs = chip->hostFirstByteUs() ? (chip->hostFirstByteUs() - startUs) / 1000 : 0;
+    result.chipUnderruns = chip->hostUnderruns();
+    result.chipOverruns = chip->hostOverruns();
+    stream.stopSong();
+    return result;
+}
+
+#endif
@@ -0,0 +1,32 @@
+/*  Replays every scenario and reports per item: cpu time per received megabyte, time to first audio,
+    underruns and the longest loop() call. Virtual times are the same on every run, cpu and loop() times
+    are real and depend on the machine, so they are compared between builds on the same host. */
+
+#include "replay.h"
+
+int main()
+{
+    printf("%-22s %9s %9s %10s %11s %10s %12s %11s\n", "item", "received", "cpu ms", "cpu ms/MB",
+           "first audio", "underruns", "underrun ms", "worst loop");
+
+    int failed = 0;
+    for (const auto &scenario : replayScenarios())
+    {
+        const ReplayResult result = replay(scenario);
+        const double megabytes = result.stats.bytesReceived / 1e6;
+
+        printf("%-22s %9llu %9.2f %10.2f %8u ms %4u / %-3u %9u ms %8u us\n", scenario.name,
+               (unsigned long long)result.stats.bytesReceived, result.cpuMs, megabytes ? result.cpuMs / megabytes : 0.0,
+               result.firstAudioMs, result.stats.underruns, result.chipUnderruns, result.stats.underrunMs,
+               result.worstLoopUs);
+
+        // a number for an item that did not play means nothing
+        if (!result.connected || result.received.empty())
+        {
+            fprintf(stderr, "%s did not play: %s\n", scenario.name, result.errors.c_str());
+            failed++;
+        }
+    }
+    printf("underruns are counted by the stream / by the simulated decoder\n");
+    return failed ? 1 : 0;
+}
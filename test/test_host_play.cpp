@@ -0,0 +1,544 @@
+/* the host build plays a file over http and from a file system through the real class */
+
+#include "host_test.h"
+#include <atomic>
+#include <thread>
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#include <malloc.h>
+#endif
+
+// bytes the allocator hands out now, 0 where that cannot be asked, the sanitizer checks leaks there
+static size_t heapInUse()
+{
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+static void playsOverHttp()
+{
+    HostServer::reset();
+    const std::string audio = hostMp3(300);
+    HostServer::file("http://host/file.mp3", audio, "audio/mpeg", 64000);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+    VS1053 *chip = VS1053::host(HOST_DREQ);
+    CHECK(chip && chip->hostPatched());
+
+    std::string finished;
+    stream.setEofCB([&](const char *url)
+                    { finished = url; });
+
+    CHECK(stream.connectToHost("http://host/file.mp3"));
+    CHECK(stream.isRunning());
+    CHECK_EQ(stream.size(), audio.size());
+
+    char url[64];
+    CHECK_EQ(stream.lastUrl(url, sizeof(url)), strlen("http://host/file.mp3"));
+    CHECK(!strcmp(url, "http://host/file.mp3"));
+    CHECK_EQ(stream.lastUrl(url, 8), strlen("http://host/file.mp3"));
+    CHECK(!strcmp(url, "http://"));
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+    CHECK(!strcmp(stream.lastUrl(), "http://host/file.mp3"));
+#pragma GCC diagnostic pop
+
+    hostRun(stream, 60000, [&]
+            { return !finished.empty(); });
+
+    CHECK(finished == "http://host/file.mp3");
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+    CHECK(!strcmp(stream.lastUrl(), ""));
+#pragma GCC diagnostic pop
+    CHECK(chip->hostReceived() == audio);
+    CHECK_EQ(chip->hostOverruns(), 0u);
+    CHECK_EQ(stream.getStats().bytesDecoded, audio.size());
+}
+
+static void playsFromFileSystem()
+{
+    HostFS fs;
+    const std::string audio = hostMp3(100);
+    fs.put("/music/track.mp3", audio);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+    VS1053 *chip = VS1053::host(HOST_DREQ);
+
+    CHECK(stream.connectToFile(fs, "/music/track.mp3"));
+    hostRun(stream, 60000, [&]
+            { return !stream.isRunning(); });
+
+    CHECK(!stream.isRunning());
+    CHECK(chip->hostReceived() == audio);
+}
+
+static void reusesKeptAliveConnections()
+{
+    // a completely received body leaves the connection open for the next request to the same host
+    const std::string audio = hostMp3(60);
+    const auto play = [&](ESP32_VS1053_Stream &stream, const char *url)
+    {
+        CHECK(stream.connectToHost(url));
+        hostRun(stream, 60000, [&]
+                { return !stream.isRunning(); });
+    };
+    const auto serve = [&]
+    {
+        HostServer::reset();
+        HostServer::file("http://host/first.mp3", audio, "audio/mpeg", 64000);
+        HostServer::file("http://host/second.mp3", audio, "audio/mpeg", 64000);
+        HostServer::file("http://other/third.mp3", audio, "audio/mpeg", 64000);
+    };
+
+    {
+        serve();
+        ESP32_VS1053_Stream stream;
+        CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+        play(stream, "http://host/first.mp3");
+        play(stream, "http://host/second.mp3");
+        CHECK_EQ(HostServer::requests().size(), 2u);
+        CHECK_EQ(HostServer::connections(), 1u);
+    }
+
+    {
+        // another host needs its own connection
+        serve();
+        ESP32_VS1053_Stream stream;
+        CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+        play(stream, "http://host/first.mp3");
+        play(stream, "http://other/third.mp3");
+        CHECK_EQ(HostServer::connections(), 2u);
+    }
+
+    {
+        // a connection that waited longer than the keep-alive timeout is closed
+        serve();
+        ESP32_VS1053_Stream stream;
+        CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+        play(stream, "http://host/first.mp3");
+        hostRun(stream, VS1053_KEEPALIVE_TIMEOUT_MS + 100, [&]
+                { return false; });
+        play(stream, "http://host/second.mp3");
+        CHECK_EQ(HostServer::connections(), 2u);
+    }
+}
+
+static void feedsFromTheFeederTask()
+{
+    // loop() only fills the buffer, the task sends it to the decoder when DREQ rises
+    HostServer::reset();
+    const std::string audio = hostMp3(300);
+    HostServer::file("http://host/file.mp3", audio, "audio/mpeg", 64000);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+    VS1053 *chip = VS1053::host(HOST_DREQ);
+    CHECK(stream.startFeederTask());
+    const size_t interrupts = hostInterrupts();
+
+    CHECK(stream.connectToHost("http://host/file.mp3"));
+    hostRun(stream, 60000, [&]
+            { return !stream.isRunning(); });
+
+    stream.stopFeederTask();
+    CHECK(hostInterrupts() - interrupts > 100);
+    CHECK(!stream.isRunning());
+    CHECK(chip->hostReceived() == audio);
+    CHECK_EQ(chip->hostUnderruns(), 0u);
+    CHECK_EQ(chip->hostOverruns(), 0u);
+    CHECK_EQ(stream.getStats().bytesDecoded, audio.size());
+}
+
+static void playsQueueGapless()
+{
+    // two mp3 files, the second follows the first in the same decoder session
+    HostServer::reset();
+    const std::string first = hostMp3(200);
+    const std::string second = hostMp3(150);
+    HostServer::file("http://host/first.mp3", first, "audio/mpeg", 64000);
+    HostServer::file("http://host/second.mp3", second, "audio/mpeg", 64000);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+    VS1053 *chip = VS1053::host(HOST_DREQ);
+
+    std::vector<std::string> finished;
+    stream.setEofCB([&](const char *url)
+                    { finished.push_back(url); });
+
+    CHECK(stream.connectToHost("http://host/first.mp3"));
+    CHECK(stream.enqueue("http://host/second.mp3"));
+    CHECK_EQ(stream.queueLength(), 1u);
+
+    // the first item starts the decoder afresh
+    hostRun(stream, 10000, [&]
+            { return !chip->hostReceived().empty(); });
+    const uint32_t stopsBefore = chip->hostStops();
+
+    hostRun(stream, 60000, [&]
+            { return finished.size() == 2; });
+
+    CHECK_EQ(finished.size(), 2u);
+    CHECK(finished.size() == 2 && finished[0] == "http://host/first.mp3" && finished[1] == "http://host/second.mp3");
+
+    // mp3 to mp3 resyncs on the next frame, the bytes of the second item follow the first
+    // without a decoder reset, nothing left out, nothing twice and no gap
+    CHECK_EQ(chip->hostStops(), stopsBefore);
+    CHECK(chip->hostReceived() == first + second);
+    CHECK_EQ(chip->hostUnderruns(), 0u);
+    CHECK_EQ(chip->hostOverruns(), 0u);
+    CHECK_EQ(stream.queueLength(), 0u);
+}
+
+static void sharesOneFeederTask()
+{
+    // two decoders on one bus, fed by one task, their buffers share a budget that is smaller than both ask for
+    HostServer::reset();
+    const std::string first = hostMp3(250);
+    const std::string second = hostMp3(200, 64);
+    HostServer::file("http://host/first.mp3", first, "audio/mpeg", 32000);
+    HostServer::file("http://host/second.mp3", second, "audio/mpeg", 16000);
+
+    ESP32_VS1053_Stream::setBufferBudget(24000);
+    {
+        ESP32_VS1053_Stream a;
+        ESP32_VS1053_Stream b;
+        CHECK(a.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ, 16000));
+        CHECK(b.startDecoder(17, 18, 19, 16000));
+        CHECK_EQ(ESP32_VS1053_Stream::bufferBudgetLeft(), 0u);
+
+        VS1053 *chipA = VS1053::host(HOST_DREQ);
+        VS1053 *chipB = VS1053::host(19);
+        chipB->hostSetKbps(64);
+        CHECK(a.startSharedFeederTask());
+        CHECK(b.startSharedFeederTask());
+        CHECK(!b.startFeederTask());
+
+        CHECK(a.connectToHost("http://host/first.mp3"));
+        CHECK(b.connectToHost("http://host/second.mp3"));
+        const unsigned long start = millis();
+        while (millis() - start < 60000 && (a.isRunning() || b.isRunning()))
+        {
+            a.loop();
+            b.loop();
+            hostAdvanceMs(2);
+        }
+
+        a.stopFeederTask();
+        b.stopFeederTask();
+        CHECK(chipA->hostReceived() == first);
+        CHECK(chipB->hostReceived() == second);
+        CHECK_EQ(chipA->hostUnderruns(), 0u);
+        CHECK_EQ(chipB->hostUnderruns(), 0u);
+        CHECK_EQ(chipA->hostOverruns(), 0u);
+        CHECK_EQ(chipB->hostOverruns(), 0u);
+    }
+    CHECK_EQ(ESP32_VS1053_Stream::bufferBudgetLeft(), 24000u);
+    ESP32_VS1053_Stream::setBufferBudget(0);
+}
+
+static void deliversEventsThroughTheQueue()
+{
+    // an icy stream with a long title every other metadata block
+    HostServer::reset();
+    const std::string audio = hostMp3(600);
+    std::vector<std::string> titles;
+    for (size_t i = 0; i < 20; i++)
+        titles.push_back(std::string(2000, 'a' + i));
+    HostResponse response;
+    response.header("Content-Type", "audio/mpeg").header("icy-metaint", "4000");
+    response.body = hostIcy(audio, 4000, titles);
+    response.header("Content-Length", std::to_string(response.body.size()));
+    response.bytesPerSecond = 20000; // the bitrate plus the metadata
+    HostServer::route("http://radio/titles", response);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+    VS1053 *chip = VS1053::host(HOST_DREQ);
+    CHECK(stream.setEventQueue(64));
+
+    // the callbacks do not allocate, so the heap only shows what the queue holds
+    size_t seen = 0;
+    size_t next = 0;
+    bool ordered = true;
+    bool finished = false;
+    stream.setInfoCB([&](const char *info)
+                     {
+                         // titles left in a replaced queue are skipped, the rest come in order
+                         size_t i = next;
+                         while (i < titles.size() && titles[i] != info)
+                             i++;
+                         ordered &= i < titles.size();
+                         next = i + 1;
+                         seen++; });
+    stream.setEofCB([&](const char *)
+                    { finished = true; });
+
+    CHECK(stream.connectToHost("http://radio/titles"));
+    hostRun(stream, 3000, [&]
+            { return false; });
+
+    // nothing is called back from the feeding path, the titles wait in the queue with a copy of their text
+    CHECK_EQ(seen, 0u);
+    const size_t before = heapInUse();
+    const size_t dispatched = stream.pollEvents();
+    CHECK(dispatched > 0);
+    CHECK(seen > 0);
+    CHECK(ordered);
+    if (before)
+        CHECK(before - heapInUse() >= seen * titles[0].size());
+
+    // a smaller queue while playing, the events in the old one are dropped with their text
+    hostRun(stream, 4000, [&]
+            { return false; });
+    const size_t polled = seen;
+    CHECK(stream.setEventQueue(8));
+    CHECK(stream.isRunning());
+    CHECK_EQ(stream.pollEvents(), 0u);
+    CHECK_EQ(seen, polled);
+
+    hostRun(stream, 60000, [&]
+            {
+                stream.pollEvents();
+                return finished; });
+
+    CHECK(finished);
+    CHECK(ordered);
+    CHECK(seen > polled);
+    CHECK(chip->hostReceived() == audio);
+    CHECK_EQ(chip->hostUnderruns(), 0u);
+    CHECK(stream.setEventQueue(0));
+}
+
+static void startsOneEventTask()
+{
+    HostServer::reset();
+    const std::string audio = hostMp3(100);
+    HostServer::file("http://host/file.mp3", audio, "audio/mpeg", 64000);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+    CHECK(!stream.startEventTask());
+    CHECK(stream.setEventQueue(8));
+
+    // callers on two cores race to start it, one of them wins
+    std::atomic<int> started{0};
+    std::thread other([&]
+                      { started += stream.startEventTask(); });
+    started += stream.startEventTask();
+    other.join();
+    CHECK_EQ(started.load(), 1);
+    CHECK(!stream.setEventQueue(4));
+
+    std::atomic<bool> finished{false};
+    stream.setEofCB([&](const char *)
+                    { finished = true; });
+    CHECK(stream.connectToHost("http://host/file.mp3"));
+    hostRun(stream, 60000, [&]
+            { return finished.load(); });
+
+    // the task delivers, pollEvents() leaves the queue to it
+    CHECK(finished);
+    CHECK_EQ(stream.pollEvents(), 0u);
+    stream.stopEventTask();
+    CHECK(stream.setEventQueue(0));
+}
+
+static void seeksByTime()
+{
+    // 400 frames of 4096 samples at 44.1 kHz, 37 seconds, the server answers range requests
+    HostServer::reset();
+    const size_t frameBytes = 2000;
+    const std::string audio = hostFlac(400, frameBytes);
+    const size_t dataStart = audio.size() - 400 * frameBytes;
+    HostServer::file("http://host/track.flac", audio, "audio/flac", 64000);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+    VS1053 *chip = VS1053::host(HOST_DREQ);
+    chip->hostSetKbps(frameBytes * 8 * 44100 / 4096 / 1000); // the decode time runs in real time
+
+    CHECK(stream.connectToHost("http://host/track.flac"));
+    hostRun(stream, 2000, [&]
+            { return false; });
+
+    // the seek point before 20 s is frame 208, the frame that holds 20 s is 215
+    const size_t before = chip->hostReceived().size();
+    CHECK(stream.seekMs(20000));
+    const size_t offset = dataStart + (uint64_t)20000 * 44100 / 1000 / 4096 * frameBytes;
+    CHECK(HostServer::requests().back().header("range") == "bytes=" + std::to_string(offset) + "-");
+    CHECK_EQ(stream.positionMs(), 20000u);
+    CHECK_EQ(stream.durationMs(), (uint32_t)((uint64_t)400 * 4096 * 1000 / 44100));
+
+    hostRun(stream, 3000, [&]
+            { return false; });
+    const std::string &received = chip->hostReceived();
+    CHECK(received.size() > before + 20000);
+    CHECK(received.compare(before, 20000, audio, offset, 20000) == 0);
+    const uint32_t played = stream.positionMs();
+    CHECK(played >= 21000 && played <= 23000);
+
+    // the position holds while paused and runs on from there
+    CHECK(stream.pause());
+    hostRun(stream, 3000, [&]
+            { return false; });
+    CHECK_EQ(stream.positionMs(), played);
+    CHECK(stream.resume());
+    hostRun(stream, 2000, [&]
+            { return false; });
+    CHECK(stream.positionMs() >= played + 1000 && stream.positionMs() <= played + 2000);
+    CHECK_EQ(chip->hostOverruns(), 0u);
+    stream.stopSong();
+}
+
+static void seeksFileByTime()
+{
+    // constant bitrate mp3, 16000 bytes a second
+    HostFS fs;
+    const std::string audio = hostMp3(1000);
+    fs.put("/music/track.mp3", audio);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+    VS1053 *chip = VS1053::host(HOST_DREQ);
+
+    CHECK(stream.connectToFile(fs, "/music/track.mp3"));
+    CHECK_EQ(stream.durationMs(), (uint32_t)(audio.size() * 1000 / 16000));
+    hostRun(stream, 1000, [&]
+            { return false; });
+
+    const size_t before = chip->hostReceived().size();
+    CHECK(stream.seekMs(10000));
+    CHECK_EQ(stream.positionMs(), 10000u);
+    hostRun(stream, 60000, [&]
+            { return !stream.isRunning(); });
+
+    // the rest of the file from 10 s on
+    CHECK(chip->hostReceived().substr(before) == audio.substr(160000));
+    CHECK(!stream.seekMs(10000));
+}
+
+static void skipsBack()
+{
+    // radio that arrives faster than it plays, a psram buffer keeps 1.5 s of played audio
+    hostSetPsram(4 * 1024 * 1024);
+    HostServer::reset();
+    const std::string audio = hostMp3(2000);
+    HostResponse response;
+    response.header("Content-Type", "audio/mpeg");
+    response.body = audio;
+    response.bytesPerSecond = 32000;
+    response.keepOpen = true;
+    HostServer::route("http://radio/live", response);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+    VS1053 *chip = VS1053::host(HOST_DREQ);
+
+    stream.setRewindTime(1500);
+    CHECK(stream.connectToHost("http://radio/live"));
+    hostRun(stream, 6000, [&]
+            { return false; });
+
+    // one second at 128 kbps is 16000 bytes, played again from where the decoder was
+    const size_t played = chip->hostReceived().size();
+    const size_t bytesPlayed = stream.bytesPlayed();
+    const uint32_t position = stream.positionMs();
+    CHECK(played > 32000);
+    CHECK(stream.skipBack(1000));
+    CHECK_EQ(stream.bytesPlayed(), bytesPlayed - 16000);
+    CHECK_EQ(stream.positionMs(), position - 1000);
+
+    hostRun(stream, 2000, [&]
+            { return false; });
+    const std::string &received = chip->hostReceived();
+    CHECK(received.size() > played + 20000);
+    CHECK(received.compare(played, 20000, audio, played - 16000, 20000) == 0);
+    CHECK(received.compare(0, played, audio, 0, played) == 0);
+
+    // no more than the 1.5 s that were kept comes back, the decoder is still 16000 bytes behind the source
+    const size_t sent = received.size();
+    const size_t before = stream.bytesPlayed();
+    CHECK(stream.skipBack(60000));
+    const size_t rewound = before - stream.bytesPlayed();
+    CHECK(rewound >= 24000 && rewound <= 24000 + 1024);
+    hostRun(stream, 500, [&]
+            { return false; });
+    CHECK(received.compare(sent, 4000, audio, sent - 16000 - rewound, 4000) == 0);
+    stream.stopSong();
+    hostSetPsram(0);
+}
+
+static void recordsSplitOnTitles()
+{
+    // a title after the first, third and fifth block of audio, each applies to the audio behind it
+    HostServer::reset();
+    const size_t metaint = 8000;
+    const std::string audio = hostMp3(150);
+    HostResponse response;
+    response.header("Content-Type", "audio/mpeg").header("icy-metaint", std::to_string(metaint));
+    response.body = hostIcy(audio, metaint, {"First", "Second", "Third"});
+    response.keepOpen = true;
+    HostServer::route("http://radio/live", response);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+    VS1053 *chip = VS1053::host(HOST_DREQ);
+
+    HostFS fs;
+    CHECK(stream.startRecording(fs, "/show.mp3", true));
+    CHECK(stream.connectToHost("http://radio/live"));
+
+    // the record task sleeps in real time, give it some between the steps of the virtual clock
+    hostRun(stream, 60000, [&]
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(300));
+                return chip->hostReceived().size() == audio.size(); },
+            20);
+    stream.stopRecording();
+    CHECK(!stream.isRecording());
+
+    CHECK(chip->hostReceived() == audio);
+    CHECK(fs.get("/show.mp3") == audio.substr(0, 3 * metaint));
+    CHECK(fs.get("/show-1.mp3") == audio.substr(3 * metaint, 2 * metaint));
+    CHECK(fs.get("/show-2.mp3") == audio.substr(5 * metaint));
+    CHECK(!fs.exists("/show-3.mp3"));
+}
+
+static void refusesUnknownHost()
+{
+    HostServer::reset();
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+
+    std::string error;
+    stream.setErrorCB([&](const char *text)
+                      { error = text; });
+    CHECK(!stream.connectToHost("http://nowhere/stream"));
+    CHECK(!stream.isRunning());
+    CHECK(!error.empty());
+}
+
+int main()
+{
+    playsOverHttp();
+    playsFromFileSystem();
+    playsQueueGapless();
+    reusesKeptAliveConnections();
+    feedsFromTheFeederTask();
+    sharesOneFeederTask();
+    deliversEventsThroughTheQueue();
+    startsOneEventTask();
+    seeksByTime();
+    seeksFileByTime();
+    skipsBack();
+    recordsSplitOnTitles();
+    refusesUnknownHost();
+    return hostTestResult("test_host_play");
+}
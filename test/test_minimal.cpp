@@ -0,0 +1,109 @@
+/* the library built with icy metadata, chunked responses and hls left out still plays plain streams */
+
+#include "host_test.h"
+
+#if VS1053_ICY_METADATA || VS1053_CHUNKED_ENABLED || VS1053_HLS_ENABLED
+#error test_minimal is built with all three features set to false
+#endif
+
+static void playsOverHttp()
+{
+    HostServer::reset();
+    const std::string audio = hostMp3(300);
+    HostServer::file("http://host/file.mp3", audio, "audio/mpeg", 64000);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+    VS1053 *chip = VS1053::host(HOST_DREQ);
+
+    CHECK(stream.connectToHost("http://host/file.mp3"));
+    hostRun(stream, 60000, [&]
+            { return !stream.isRunning(); });
+
+    CHECK(chip->hostReceived() == audio);
+    CHECK_EQ(chip->hostOverruns(), 0u);
+
+    // no metadata is asked for and http/1.0 is never chunked
+    CHECK_EQ(HostServer::requests().size(), 1u);
+    CHECK(HostServer::requests()[0].http10);
+    CHECK(HostServer::requests()[0].header("icy-metadata") == "0");
+}
+
+static void playsRadio()
+{
+    // a server that would chunk an http/1.1 response sends the plain body
+    HostServer::reset();
+    const std::string audio = hostMp3(1000);
+    HostResponse response;
+    response.header("Content-Type", "audio/mpeg").header("icy-br", "128");
+    response.body = audio;
+    response.bytesPerSecond = 16000;
+    response.chunkBytes = 777;
+    response.keepOpen = true;
+    HostServer::route("http://radio/live", response);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+    VS1053 *chip = VS1053::host(HOST_DREQ);
+
+    std::string errors;
+    stream.setErrorCB([&](const char *error)
+                      { errors += error; });
+
+    CHECK(stream.connectToHost("http://radio/live"));
+    hostRun(stream, 10000, [&]
+            { return false; });
+
+    CHECK(stream.isRunning());
+    CHECK(errors.empty());
+    const std::string &received = chip->hostReceived();
+    CHECK(received.size() > 100000);
+    CHECK(received == audio.substr(0, received.size()));
+    stream.stopSong();
+}
+
+static void playsFromFileSystem()
+{
+    HostFS fs;
+    const std::string audio = hostFlac(100);
+    fs.put("/music/track.flac", audio);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+    VS1053 *chip = VS1053::host(HOST_DREQ);
+
+    CHECK(stream.connectToFile(fs, "/music/track.flac"));
+    hostRun(stream, 60000, [&]
+            { return !stream.isRunning(); });
+
+    CHECK(chip->hostReceived() == audio);
+}
+
+static void refusesHls()
+{
+    HostServer::reset();
+    HostResponse playlist;
+    playlist.header("Content-Type", "application/vnd.apple.mpegurl");
+    playlist.body = "#EXTM3U\n#EXT-X-TARGETDURATION:3\n#EXTINF:2.0,\nsegment0.ts\n#EXT-X-ENDLIST\n";
+    playlist.header("Content-Length", std::to_string(playlist.body.size()));
+    HostServer::route("http://hls/index.m3u8", playlist);
+
+    ESP32_VS1053_Stream stream;
+    CHECK(stream.startDecoder(HOST_CS, HOST_DCS, HOST_DREQ));
+
+    std::string error;
+    stream.setErrorCB([&](const char *text)
+                      { error = text; });
+    CHECK(!stream.connectToHost("http://hls/index.m3u8"));
+    CHECK(!stream.isRunning());
+    CHECK(error == "HLS streams not supported");
+}
+
+int main()
+{
+    playsOverHttp();
+    playsRadio();
+    playsFromFileSystem();
+    refusesHls();
+    return hostTestResult("test_minimal");
+}
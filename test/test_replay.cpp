@@ -0,0 +1,124 @@
+/* every replayed scenario delivers its audio to the decoder unchanged and reports what it should */
+
+#include "replay.h"
+
+static const ReplayScenario *find(const std::vector<ReplayScenario> &scenarios, const char *name)
+{
+    for (const auto &scenario : scenarios)
+        if (!strcmp(scenario.name, name))
+            return &scenario;
+    return nullptr;
+}
+
+static void deliversTheAudio(const std::vector<ReplayScenario> &scenarios)
+{
+    for (const auto &scenario : scenarios)
+    {
+        if (scenario.live)
+            continue;
+
+        const ReplayResult result = replay(scenario);
+        if (result.received != scenario.audio)
+            fprintf(stderr, "%s: %zu of %zu bytes, errors: %s\n", scenario.name, result.received.size(),
+                    scenario.audio.size(), result.errors.c_str());
+        CHECK(result.connected);
+        CHECK(result.received == scenario.audio);
+        // an item without a size only ends when the buffer runs dry
+        CHECK(result.errors == scenario.errors || result.errors == scenario.errors + "Ringbuffer empty\n");
+        CHECK_EQ(result.chipOverruns, 0u);
+        CHECK_EQ(result.stats.bytesDecoded, scenario.audio.size());
+    }
+}
+
+static void playsAnIcyRadio(const std::vector<ReplayScenario> &scenarios)
+{
+    const ReplayScenario *radio = find(scenarios, "icy radio");
+    const ReplayResult result = replay(*radio);
+
+    CHECK(result.connected);
+    CHECK(result.received.size() > 200000);
+    CHECK(radio->audio.compare(0, result.received.size(), result.received) == 0);
+    CHECK(result.station == "Host Radio");
+    CHECK(result.titles.size() == 3);
+    CHECK(result.titles.size() > 1 && result.titles[0] == "First Song" && result.titles[1] == "Second Song");
+    CHECK_EQ(result.chipOverruns, 0u);
+
+    // the scripted stall empties the buffer once
+    CHECK_EQ(result.stats.underruns, 1u);
+    CHECK_EQ(result.chipUnderruns, 1u);
+    CHECK_EQ(result.stats.reconnects, 0u);
+    CHECK(result.firstAudioMs >= 300 && result.firstAudioMs < 2000);
+}
+
+static void stripsMetadataFromChunks(const std::vector<ReplayScenario> &scenarios)
+{
+    const ReplayResult result = replay(*find(scenarios, "chunked icy"));
+    CHECK(result.finished);
+    CHECK(result.titles.size() == 3 && result.titles[0] == "Chunked Title" && result.titles[1] == "Next Title" &&
+          result.titles[2] == "Joined Again");
+
+    // the malformed chunk is a lost sync that reconnects, not the end of the stream
+    CHECK(result.errors.compare(0, strlen("Stream sync lost\n"), "Stream sync lost\n") == 0);
+    CHECK_EQ(result.stats.reconnects, 1u);
+    CHECK_EQ(HostServer::requests().size(), 2u);
+    CHECK_EQ(result.chipUnderruns, 0u);
+}
+
+static void followsRedirects(const std::vector<ReplayScenario> &scenarios)
+{
+    const ReplayResult result = replay(*find(scenarios, "redirect chain"));
+    CHECK(result.lastUrl == "http://mirror/files/song.mp3");
+
+    const auto &requests = HostServer::requests();
+    CHECK(requests.size() >= 3);
+    CHECK(requests.size() >= 3 && requests[0].url == "http://short/link" && requests[1].url == "http://mirror/moved" &&
+          requests[2].url == "http://mirror/files/song.mp3");
+}
+
+static void followsPlaylists(const std::vector<ReplayScenario> &scenarios)
+{
+    for (const char *name : {"m3u playlist", "pls playlist"})
+    {
+        const ReplayResult result = replay(*find(scenarios, name));
+        CHECK(result.lastUrl == "http://media/track.mp3");
+    }
+}
+
+static void resumesADroppedDownload(const std::vector<ReplayScenario> &scenarios)
+{
+    const ReplayResult result = replay(*find(scenarios, "drop and resume"));
+    CHECK_EQ(result.stats.reconnects, 1u);
+
+    const auto &requests = HostServer::requests();
+    CHECK(requests.size() == 2);
+    CHECK(requests.size() == 2 && requests[1].header("range") == "bytes=60000-");
+    CHECK(requests.size() == 2 && requests[1].header("if-range") == "\"v1\"");
+}
+
+static void isTheSameEveryRun(const std::vector<ReplayScenario> &scenarios)
+{
+    // only real time measurements may differ between runs
+    for (const char *name : {"icy radio", "hls transport stream"})
+    {
+        const ReplayResult first = replay(*find(scenarios, name));
+        const ReplayResult second = replay(*find(scenarios, name));
+        CHECK(first.received == second.received);
+        CHECK_EQ(first.virtualMs, second.virtualMs);
+        CHECK_EQ(first.firstAudioMs, second.firstAudioMs);
+        CHECK_EQ(first.stats.underruns, second.stats.underruns);
+        CHECK_EQ(first.loops, second.loops);
+    }
+}
+
+int main()
+{
+    const std::vector<ReplayScenario> scenarios = replayScenarios();
+    deliversTheAudio(scenarios);
+    playsAnIcyRadio(scenarios);
+    stripsMetadataFromChunks(scenarios);
+    followsRedirects(scenarios);
+    followsPlaylists(scenarios);
+    resumesADroppedDownload(scenarios);
+    isTheSameEveryRun(scenarios);
+    return hostTestResult("test_replay");
+}
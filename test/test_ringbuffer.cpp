@@ -0,0 +1,113 @@
+/* VS1053_Ringbuffer hands out contiguous spans and gives read bytes back while nothing wrote over them */
+
+#include "host_test.h"
+
+// writes the next len bytes of a counting sequence
+static void produce(VS1053_Ringbuffer &buffer, size_t len, uint8_t &next)
+{
+    size_t space = 0;
+    uint8_t *dest;
+    while (len && (dest = buffer.acquireWrite(space)))
+    {
+        space = min(space, len);
+        for (size_t i = 0; i < space; i++)
+            dest[i] = next++;
+        buffer.commitWrite(space);
+        len -= space;
+    }
+    CHECK_EQ(len, 0u);
+}
+
+static std::string consume(VS1053_Ringbuffer &buffer, size_t len)
+{
+    std::string data;
+    size_t size = 0;
+    const uint8_t *src;
+    while (len && (src = buffer.acquireRead(size)))
+    {
+        size = min(size, len);
+        data.append(reinterpret_cast<const char *>(src), size);
+        buffer.commitRead(size);
+        len -= size;
+    }
+    return data;
+}
+
+static std::string sequence(const uint8_t first, const size_t len)
+{
+    std::string data;
+    for (size_t i = 0; i < len; i++)
+        data += char(uint8_t(first + i));
+    return data;
+}
+
+static void wrapsAround()
+{
+    VS1053_Ringbuffer buffer;
+    CHECK(buffer.allocate(64, MALLOC_CAP_8BIT));
+    uint8_t next = 0;
+
+    produce(buffer, 48, next);
+    CHECK(consume(buffer, 48) == sequence(0, 48));
+
+    // a span never crosses the end of the storage
+    size_t space = 0;
+    CHECK(buffer.acquireWrite(space));
+    CHECK_EQ(space, 16u);
+    produce(buffer, 32, next);
+    CHECK_EQ(buffer.used(), 32u);
+    CHECK(consume(buffer, 32) == sequence(48, 32));
+    CHECK_EQ(buffer.totalWritten(), 80u);
+    CHECK_EQ(buffer.totalRead(), 80u);
+}
+
+static void rewindsAcrossTheWrapPoint()
+{
+    VS1053_Ringbuffer buffer;
+    CHECK(buffer.allocate(64, MALLOC_CAP_8BIT));
+    uint8_t next = 0;
+
+    // the read position ends up 8 bytes past the wrap point with bytes 72..79 unread
+    produce(buffer, 48, next);
+    CHECK(consume(buffer, 48) == sequence(0, 48));
+    produce(buffer, 32, next);
+    CHECK(consume(buffer, 24) == sequence(48, 24));
+
+    // back over the wrap point to byte 52, which still sits in the free space
+    CHECK_EQ(buffer.rewind(20), 20u);
+    CHECK_EQ(buffer.used(), 28u);
+    CHECK_EQ(buffer.totalRead(), 52u);
+
+    size_t size = 0;
+    CHECK(buffer.acquireRead(size));
+    CHECK_EQ(size, 12u); // up to the end of the storage
+    CHECK(consume(buffer, 28) == sequence(52, 28));
+
+    // only the free space can be given back, the rest was written over
+    produce(buffer, 60, next);
+    CHECK_EQ(buffer.rewind(20), 4u);
+    CHECK(consume(buffer, 64) == sequence(76, 64));
+}
+
+static void rewindsNoFurtherThanWasRead()
+{
+    VS1053_Ringbuffer buffer;
+    CHECK(buffer.allocate(64, MALLOC_CAP_8BIT));
+    uint8_t next = 0;
+
+    produce(buffer, 10, next);
+    CHECK(consume(buffer, 4) == sequence(0, 4));
+    CHECK_EQ(buffer.rewind(10), 4u);
+    CHECK(consume(buffer, 10) == sequence(0, 10));
+
+    buffer.clear();
+    CHECK_EQ(buffer.rewind(10), 0u);
+}
+
+int main()
+{
+    wrapsAround();
+    rewindsAcrossTheWrapPoint();
+    rewindsNoFurtherThanWasRead();
+    return hostTestResult("test_ringbuffer");
+}
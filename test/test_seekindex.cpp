@@ -0,0 +1,152 @@
+/* VS1053_SeekIndex maps play time to file offsets for the formats it can index */
+
+#include "host_test.h"
+
+static VS1053_SeekIndex::reader_t reader(const std::string &file, size_t *reads = nullptr)
+{
+    return [&file, reads](size_t offset, uint8_t *data, size_t len) -> size_t
+    {
+        if (reads)
+            (*reads)++;
+        if (offset >= file.size())
+            return 0;
+        len = min(len, file.size() - offset);
+        memcpy(data, file.data() + offset, len);
+        return len;
+    };
+}
+
+static void indexesConstantBitrateMp3()
+{
+    const std::string file = hostMp3(1000, 128); // 417 byte frames, 16000 bytes per second
+    uint8_t scratch[1024];
+    VS1053_SeekIndex index;
+    CHECK(index.build(reader(file), file.size(), scratch, sizeof(scratch)));
+    CHECK_EQ(index.dataStart(), 0u);
+    CHECK_EQ(index.durationMs(), file.size() * 1000 / 16000);
+
+    size_t offset;
+    CHECK(index.offsetFor(reader(file), 10000, scratch, sizeof(scratch), offset));
+    CHECK_EQ(offset, 160000u);
+    CHECK_EQ(index.msAt(offset), 10000u);
+    CHECK(!index.offsetFor(reader(file), index.durationMs(), scratch, sizeof(scratch), offset));
+}
+
+static void skipsId3Tags()
+{
+    // a tag larger than the scratch buffer
+    std::string tag = "ID3";
+    tag += std::string("\x04\x00\x00\x00\x00\x10\x00", 7); // 2048 bytes of frames
+    tag += std::string(2048, '\x02');
+    const std::string file = tag + hostMp3(200, 128);
+
+    uint8_t scratch[1024];
+    VS1053_SeekIndex index;
+    CHECK(index.build(reader(file), file.size(), scratch, sizeof(scratch)));
+    CHECK_EQ(index.dataStart(), tag.size());
+
+    size_t offset;
+    CHECK(index.offsetFor(reader(file), 1000, scratch, sizeof(scratch), offset));
+    CHECK_EQ(offset, tag.size() + 16000);
+}
+
+static void followsAXingTable()
+{
+    // the first half of the play time takes a quarter of the bytes
+    std::string file = hostMp3(1001, 128);
+    const uint32_t frames = 1000;
+    const uint32_t bytes = file.size() - 417;
+
+    std::string xing = "Xing";
+    hostBe(xing, 0x07, 4);
+    hostBe(xing, frames, 4);
+    hostBe(xing, bytes, 4);
+    for (size_t i = 0; i < 100; i++)
+        xing += char(i < 50 ? i * 64 / 50 : 64 + (i - 50) * 192 / 50);
+    file.replace(4 + 32, xing.size(), xing);
+
+    uint8_t scratch[1024];
+    VS1053_SeekIndex index;
+    CHECK(index.build(reader(file), file.size(), scratch, sizeof(scratch)));
+    CHECK_EQ(index.durationMs(), (uint64_t)frames * 1152 * 1000 / 44100);
+
+    size_t offset;
+    const uint32_t half = index.durationMs() / 2;
+    CHECK(index.offsetFor(reader(file), half, scratch, sizeof(scratch), offset));
+    CHECK(offset >= (size_t)64 * bytes / 256 - 417 && offset <= (size_t)64 * bytes / 256 + 417);
+    CHECK(index.msAt(offset) + 100 >= half && index.msAt(offset) <= half + 100);
+}
+
+static void alignsWavOffsets()
+{
+    const std::string file = hostWav(176400 * 4);
+    uint8_t scratch[1024];
+    VS1053_SeekIndex index;
+    CHECK(index.build(reader(file), file.size(), scratch, sizeof(scratch)));
+    CHECK_EQ(index.dataStart(), 44u);
+    CHECK_EQ(index.dataEnd(), file.size());
+    CHECK_EQ(index.durationMs(), 4000u);
+
+    size_t offset;
+    CHECK(index.offsetFor(reader(file), 1001, scratch, sizeof(scratch), offset));
+    CHECK_EQ((offset - index.dataStart()) % 4, 0u);
+    CHECK(offset <= 44 + 176400 * 1001 / 1000);
+    CHECK(offset + 4 > 44 + 176400 * 1001 / 1000);
+}
+
+static void estimatesAdtsFromItsFrames()
+{
+    const std::string file = hostAdts(1000, 372); // 1024 samples per frame
+    uint8_t scratch[2048];
+    VS1053_SeekIndex index;
+    CHECK(index.build(reader(file), file.size(), scratch, sizeof(scratch)));
+    const uint32_t expected = (uint64_t)1000 * 1024 * 1000 / 44100;
+    CHECK(index.durationMs() + 10 >= expected && index.durationMs() <= expected + 10);
+}
+
+static void bisectsFlacFrames()
+{
+    for (const bool seekTable : {true, false})
+    {
+        const size_t frameBytes = 2000;
+        const std::string file = hostFlac(100, frameBytes, seekTable);
+        uint8_t scratch[512];
+        VS1053_SeekIndex index;
+        CHECK(index.build(reader(file), file.size(), scratch, sizeof(scratch)));
+        CHECK_EQ(index.durationMs(), (uint64_t)100 * 4096 * 1000 / 44100);
+
+        for (const uint32_t ms : {0u, 93u, 5000u, 9000u})
+        {
+            size_t reads = 0;
+            size_t offset;
+            CHECK(index.offsetFor(reader(file, &reads), ms, scratch, sizeof(scratch), offset));
+            const size_t frame = (uint64_t)ms * 44100 / 1000 / 4096;
+            CHECK_EQ(offset, index.dataStart() + frame * frameBytes);
+            CHECK(reads < 40); // bisected, not scanned
+        }
+    }
+}
+
+static void refusesWhatItCannotIndex()
+{
+    const std::string ogg = "OggS" + std::string(4000, '\x01');
+    uint8_t scratch[1024];
+    VS1053_SeekIndex index;
+    CHECK(!index.build(reader(ogg), ogg.size(), scratch, sizeof(scratch)));
+    CHECK(!index.valid());
+
+    size_t offset;
+    CHECK(!index.offsetFor(reader(ogg), 0, scratch, sizeof(scratch), offset));
+}
+
+int main()
+{
+    indexesConstantBitrateMp3();
+    skipsId3Tags();
+    followsAXingTable();
+    alignsWavOffsets();
+    estimatesAdtsFromItsFrames();
+    bisectsFlacFrames();
+    refusesWhatItCannotIndex();
+    return hostTestResult("test_seekindex");
+}
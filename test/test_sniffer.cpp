@@ -0,0 +1,159 @@
+/* VS1053_Sniffer tells the format from the first bytes and drops what comes before the first frame */
+
+#include "host_test.h"
+
+static size_t sniffAll(VS1053_Sniffer &sniffer, std::string &data, const size_t block, std::string &kept)
+{
+    kept.clear();
+    for (size_t pos = 0; pos < data.size(); pos += block)
+    {
+        const size_t len = min(block, data.size() - pos);
+        uint8_t *bytes = reinterpret_cast<uint8_t *>(&data[pos]);
+        kept.append(reinterpret_cast<char *>(bytes), sniffer.sniff(bytes, len));
+    }
+    return kept.size();
+}
+
+static void recognizesFormats()
+{
+    const struct
+    {
+        std::string data;
+        VS1053_Sniffer::Format format;
+    } cases[] = {
+        {hostMp3(8), VS1053_Sniffer::FORMAT_MP3},
+        {hostAdts(8), VS1053_Sniffer::FORMAT_AAC_ADTS},
+        {hostWav(4096), VS1053_Sniffer::FORMAT_WAV},
+        {hostFlac(4, 500, false), VS1053_Sniffer::FORMAT_FLAC},
+        {"OggS" + std::string(60, '\x01'), VS1053_Sniffer::FORMAT_OGG},
+        {std::string("\0\0\0\x20" "ftypM4A ", 12) + std::string(60, '\x01'), VS1053_Sniffer::FORMAT_AAC_MP4},
+    };
+
+    for (const auto &test : cases)
+    {
+        VS1053_Sniffer sniffer;
+        sniffer.reset(true);
+        std::string data = test.data;
+        std::string kept;
+        sniffAll(sniffer, data, 512, kept);
+        CHECK(!sniffer.active());
+        CHECK(!sniffer.rejected());
+        CHECK_EQ(sniffer.format(), test.format);
+        CHECK(kept == test.data);
+    }
+}
+
+static void dropsBytesInFrontOfTheFirstFrame()
+{
+    const std::string audio = hostMp3(8);
+    std::string data = std::string(100, '\x01') + audio;
+
+    VS1053_Sniffer sniffer;
+    sniffer.reset(true);
+    std::string kept;
+    sniffAll(sniffer, data, 1000, kept);
+    CHECK_EQ(sniffer.format(), VS1053_Sniffer::FORMAT_MP3);
+    CHECK(kept == audio);
+}
+
+static void passesAnId3Tag()
+{
+    std::string tag = "ID3";
+    tag += std::string("\x04\x00\x00\x00\x00\x01\x00", 7); // 128 bytes of frames
+    tag += std::string(128, '\x02');
+    const std::string audio = hostMp3(8);
+    std::string data = tag + audio;
+
+    VS1053_Sniffer sniffer;
+    sniffer.reset(true);
+    std::string kept;
+    sniffAll(sniffer, data, 64, kept);
+    CHECK_EQ(sniffer.format(), VS1053_Sniffer::FORMAT_MP3);
+    CHECK(kept == tag + audio);
+}
+
+static void findsAHeaderSplitOverBlocks()
+{
+    // every split from one byte before the header to one byte after it
+    const std::string audio = hostMp3(8);
+    const size_t junk = 301;
+    for (size_t split = junk - 1; split <= junk + 8; split++)
+    {
+        std::string data = std::string(junk, '\x01') + audio;
+        VS1053_Sniffer sniffer;
+        sniffer.reset(true);
+
+        std::string kept;
+        uint8_t *bytes = reinterpret_cast<uint8_t *>(&data[0]);
+        kept.append(reinterpret_cast<char *>(bytes), sniffer.sniff(bytes, split));
+        const size_t rest = data.size() - split;
+        kept.append(reinterpret_cast<char *>(bytes + split), sniffer.sniff(bytes + split, rest));
+
+        CHECK_EQ(sniffer.format(), VS1053_Sniffer::FORMAT_MP3);
+        CHECK(!sniffer.rejected());
+        // the frame that started in the first block goes on from its remainder
+        CHECK(kept.size() <= audio.size() && audio.compare(audio.size() - kept.size(), kept.size(), kept) == 0);
+        CHECK(kept.size() + 8 >= audio.size());
+    }
+}
+
+static void rejectsTextAndNoise()
+{
+    std::string page = "<html><head><title>404 Not Found</title></head><body>Not found</body></html>";
+    VS1053_Sniffer sniffer;
+    sniffer.reset(true);
+    std::string kept;
+    sniffAll(sniffer, page, 512, kept);
+    CHECK(sniffer.rejected());
+    CHECK(kept.empty());
+
+    std::string noise(VS1053_Sniffer::MAX_SNIFF_BYTES + 1024, '\x01');
+    noise[0] = '\x80'; // not text
+    sniffer.reset(true);
+    sniffAll(sniffer, noise, 700, kept);
+    CHECK(sniffer.rejected());
+}
+
+static void leavesResumedDataAlone()
+{
+    std::string data = std::string(100, '\x01') + hostMp3(4);
+    VS1053_Sniffer sniffer;
+    sniffer.reset(false);
+    std::string kept;
+    sniffAll(sniffer, data, 512, kept);
+    CHECK(!sniffer.active());
+    CHECK(kept == data);
+}
+
+static void parsesFrameHeaders()
+{
+    const std::string mp3 = hostMp3(1, 320);
+    size_t frameLength;
+    uint32_t kbps, rate;
+    uint16_t samples;
+    uint8_t sideInfo;
+    CHECK(VS1053_Sniffer::mp3Header(reinterpret_cast<const uint8_t *>(mp3.data()), frameLength, kbps, rate, samples,
+                                    sideInfo));
+    CHECK_EQ(kbps, 320u);
+    CHECK_EQ(rate, 44100u);
+    CHECK_EQ(samples, 1152);
+    CHECK_EQ(frameLength, mp3.size());
+
+    const std::string adts = hostAdts(1, 400);
+    CHECK(VS1053_Sniffer::adtsHeader(reinterpret_cast<const uint8_t *>(adts.data()), frameLength, rate, samples));
+    CHECK_EQ(frameLength, 400u);
+    CHECK_EQ(rate, 44100u);
+    CHECK_EQ(samples, 1024);
+}
+
+int main()
+{
+    recognizesFormats();
+    dropsBytesInFrontOfTheFirstFrame();
+    passesAnId3Tag();
+    findsAHeaderSplitOverBlocks();
+    rejectsTextAndNoise();
+    leavesResumedDataAlone();
+    parsesFrameHeaders();
+    return hostTestResult("test_sniffer");
+}
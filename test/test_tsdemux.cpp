@@ -0,0 +1,87 @@
+/* VS1053_TsDemux pulls the audio elementary stream out of an mpeg transport stream */
+
+#include "host_test.h"
+
+static std::string demuxSliced(VS1053_TsDemux &demux, const std::string &ts, const size_t block)
+{
+    // the way the stream feeds it, completing a cut off packet before demuxing the rest
+    std::string out;
+    for (size_t pos = 0; pos < ts.size();)
+    {
+        const size_t missing = demux.missing();
+        if (missing)
+        {
+            const size_t len = min(missing, ts.size() - pos);
+            memcpy(demux.carry(), ts.data() + pos, len);
+            pos += len;
+            const size_t payload = demux.complete(len);
+            out.append(reinterpret_cast<const char *>(demux.payload()), payload);
+            continue;
+        }
+
+        std::string data = ts.substr(pos, min(block, ts.size() - pos));
+        pos += data.size();
+        const size_t len = demux.demux(reinterpret_cast<uint8_t *>(&data[0]), data.size());
+        out.append(data.data(), len);
+    }
+    return out;
+}
+
+static void extractsTheAudioStream()
+{
+    const std::string audio = hostAdts(40);
+    for (const bool withVideo : {false, true})
+    {
+        std::string ts = hostTs(audio, withVideo);
+        CHECK_EQ(ts.size() % VS1053_TsDemux::PACKET_SIZE, 0u);
+
+        VS1053_TsDemux demux;
+        demux.reset();
+        const size_t len = demux.demux(reinterpret_cast<uint8_t *>(&ts[0]), ts.size());
+        CHECK_EQ(demux.missing(), 0u);
+        CHECK(ts.substr(0, len) == audio);
+    }
+}
+
+static void completesPacketsCutOffAtTheEnd()
+{
+    const std::string audio = hostAdts(40);
+    const std::string ts = hostTs(audio, true);
+    for (const size_t block : {1, 100, 187, 189, 500, 1460})
+    {
+        VS1053_TsDemux demux;
+        demux.reset();
+        CHECK(demuxSliced(demux, ts, block) == audio);
+    }
+}
+
+static void resyncsAfterGarbage()
+{
+    const std::string audio = hostAdts(20);
+    std::string ts = hostTs(audio, false);
+    ts = std::string(55, '\x01') + ts;
+
+    VS1053_TsDemux demux;
+    demux.reset();
+    CHECK(demuxSliced(demux, ts, 1024) == audio);
+}
+
+static void ignoresDataBeforeTheTables()
+{
+    // without a pat there is no audio pid to pick
+    const std::string audio = hostAdts(10);
+    std::string ts = hostTs(audio, false).substr(2 * VS1053_TsDemux::PACKET_SIZE);
+
+    VS1053_TsDemux demux;
+    demux.reset();
+    CHECK_EQ(demux.demux(reinterpret_cast<uint8_t *>(&ts[0]), ts.size()), 0u);
+}
+
+int main()
+{
+    extractsTheAudioStream();
+    completesPacketsCutOffAtTheEnd();
+    resyncsAfterGarbage();
+    ignoresDataBeforeTheTables();
+    return hostTestResult("test_tsdemux");
+}